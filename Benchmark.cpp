@@ -0,0 +1,288 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <variant>
+#include <libavoid/libavoid.h>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <pugixml.hpp>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+#include "Loading.h"
+#include "Placing.h"
+#include "Layouting.h"
+#include "Drawing.h"
+#include "Plotting.h"
+#include "Generating.h"
+
+enum BenchmarkPhase
+{
+    LoadPhase,
+    LayoutPhase,
+    ObstaclePhase,
+    ConnEndPhase,
+    RouterPhase,
+    DrawPhase,
+    WritePhase,
+    NumPhases
+};
+
+const char* BenchmarkPhaseNames[NumPhases] =
+{
+    "load_us", "layout_us", "obstacles_us", "connends_us", "router_us", "draw_us", "write_us"
+};
+
+struct BenchmarkSample
+{
+    IDEF::SyntheticDiagramSpec Spec;
+    IDEF::PlotJob Job;
+    uint64_t XMLByteCount;
+    uint64_t PhaseMicroseconds[NumPhases];
+    uint64_t PeakRSSKilobytes;
+    std::string Status;
+};
+
+// Peak resident set size of the whole process so far, the sweep runs from the smallest
+// diagram upwards so each sample's value is the peak of the largest diagram plotted yet.
+uint64_t ReadPeakRSSKilobytes()
+{
+#if defined(__unix__) || defined(__APPLE__)
+    struct rusage Usage;
+
+    getrusage(RUSAGE_SELF, &Usage);
+#if defined(__APPLE__)
+    return Usage.ru_maxrss / 1024u;
+#else
+    return Usage.ru_maxrss;
+#endif
+#else
+    return 0u;
+#endif
+}
+
+uint64_t MicrosecondsSince(std::chrono::steady_clock::time_point& PhaseStartTime)
+{
+    std::chrono::steady_clock::time_point PhaseEndTime;
+    uint64_t Microseconds;
+
+    PhaseEndTime = std::chrono::steady_clock::now();
+    Microseconds = std::chrono::duration_cast<std::chrono::microseconds>(PhaseEndTime - PhaseStartTime).count();
+    PhaseStartTime = PhaseEndTime;
+
+    return Microseconds;
+}
+
+// Sizes the diagram so the diagonal or grid of boxes, their stub labels and the boundary stubs fit.
+IDEF::PlotJob SyntheticPlotJob(const IDEF::SyntheticDiagramSpec& Spec, IDEF::BoxLayout Layout, const std::string& ScratchPath)
+{
+    IDEF::PlotJob Job;
+    uint32_t NumArrows;
+    uint32_t BoxSectionWidth;
+    uint32_t BoxSectionHeight;
+
+    NumArrows = std::max(Spec.ArrowsPerInterface, Spec.NumBoundaryStubs);
+    Job.InputFilePath = ScratchPath + ".xml";
+    Job.OutputFilePath = ScratchPath + ".txt";
+    Job.BoxWidth = 32u;
+    Job.BoxHeight = std::max(8u, (2u * NumArrows) + 2u);
+    Job.BoxXGap = 10u + (2u * NumArrows);
+    Job.BoxYGap = 6u + (2u * NumArrows);
+    Job.UseCache = false;
+    Job.AutoFit = false;
+    Job.Layout = Layout;
+    IDEF::MeasureBoxSection(Spec.NumActivities, Layout, Job.BoxWidth, Job.BoxHeight, Job.BoxXGap, Job.BoxYGap, BoxSectionWidth, BoxSectionHeight);
+    Job.DiagramWidth = BoxSectionWidth + Job.BoxXGap + 120u;
+    Job.DiagramHeight = BoxSectionHeight + Job.BoxYGap + 40u + (4u * NumArrows);
+
+    return Job;
+}
+
+// Runs the same phases as a single plot, timing each one on its own.
+void RunBenchmarkSample(BenchmarkSample& Sample)
+{
+    IDEF::ActivityDiagram LoadedDiagram;
+    std::vector<Avoid::ConnEnd> StubConnEnds;
+    std::vector<Avoid::Rectangle> Obstacles;
+    Avoid::Router *Router;
+    IDEF::DiagramRaster Diagram;
+    std::chrono::steady_clock::time_point PhaseStartTime;
+    const IDEF::PlotJob& Job = Sample.Job;
+
+    PhaseStartTime = std::chrono::steady_clock::now();
+    LoadedDiagram = IDEF::LoadActivityDiagram(Job.InputFilePath, std::max(std::thread::hardware_concurrency(), 1u));
+    Sample.PhaseMicroseconds[LoadPhase] = MicrosecondsSince(PhaseStartTime);
+    IDEF::LayoutActivityDiagram(LoadedDiagram, Job.DiagramWidth, Job.DiagramHeight, Job.BoxWidth, Job.BoxHeight, Job.BoxXGap, Job.BoxYGap, Job.Layout);
+    Sample.PhaseMicroseconds[LayoutPhase] = MicrosecondsSince(PhaseStartTime);
+    IDEF::PlaceObstacles(LoadedDiagram, Obstacles);
+    Sample.PhaseMicroseconds[ObstaclePhase] = MicrosecondsSince(PhaseStartTime);
+    IDEF::PlaceBoxStubConnEnds(LoadedDiagram, StubConnEnds);
+    IDEF::PlaceBoundaryStubConnEnds(LoadedDiagram, StubConnEnds);
+    Sample.PhaseMicroseconds[ConnEndPhase] = MicrosecondsSince(PhaseStartTime);
+    Router = IDEF::ConstructRouter(LoadedDiagram, StubConnEnds, Obstacles);
+    Sample.PhaseMicroseconds[RouterPhase] = MicrosecondsSince(PhaseStartTime);
+    try
+    {
+        Diagram = IDEF::DrawDiagram(LoadedDiagram, Router);
+    }
+    catch (...)
+    {
+        delete Router;
+        throw;
+    }
+    delete Router;
+    Sample.PhaseMicroseconds[DrawPhase] = MicrosecondsSince(PhaseStartTime);
+    IDEF::WriteDiagram(Diagram, Job.OutputFilePath);
+    Sample.PhaseMicroseconds[WritePhase] = MicrosecondsSince(PhaseStartTime);
+}
+
+// Keeps the fastest time of each phase over the repetitions.
+void MeasureBenchmarkSample(BenchmarkSample& Sample, uint32_t NumRepetitions)
+{
+    std::string DiagramXML;
+    std::ofstream DiagramXMLStream;
+    uint64_t FastestMicroseconds[NumPhases];
+
+    DiagramXML = IDEF::GenerateDiagramXML(Sample.Spec);
+    Sample.XMLByteCount = DiagramXML.size();
+    DiagramXMLStream.open(Sample.Job.InputFilePath, std::ios_base::out | std::ios_base::binary);
+    if (DiagramXMLStream.is_open() == false)
+    {
+        throw std::runtime_error("Could not open the scratch file: " + Sample.Job.InputFilePath);
+    }
+    DiagramXMLStream << DiagramXML;
+    DiagramXMLStream.close();
+    std::fill(FastestMicroseconds, FastestMicroseconds + NumPhases, UINT64_MAX);
+    for (uint32_t Repetition = 0u; Repetition < NumRepetitions; Repetition++)
+    {
+        RunBenchmarkSample(Sample);
+        for (uint32_t Phase = 0u; Phase < NumPhases; Phase++)
+        {
+            FastestMicroseconds[Phase] = std::min(FastestMicroseconds[Phase], Sample.PhaseMicroseconds[Phase]);
+        }
+    }
+    std::copy(FastestMicroseconds, FastestMicroseconds + NumPhases, Sample.PhaseMicroseconds);
+}
+
+void WriteBenchmarkHeader(std::ostream& ResultsStream)
+{
+    ResultsStream << "activities,arrows_per_interface,fan_out,boundary_stubs,xml_bytes,diagram_width,diagram_height";
+    for (uint32_t Phase = 0u; Phase < NumPhases; Phase++)
+    {
+        ResultsStream << ',' << BenchmarkPhaseNames[Phase];
+    }
+    ResultsStream << ",total_us,peak_rss_kb,status\n";
+}
+
+void WriteBenchmarkSample(std::ostream& ResultsStream, const BenchmarkSample& Sample)
+{
+    uint64_t TotalMicroseconds;
+    std::string Status;
+
+    ResultsStream << Sample.Spec.NumActivities << ',' << Sample.Spec.ArrowsPerInterface << ',';
+    ResultsStream << Sample.Spec.FanOut << ',' << Sample.Spec.NumBoundaryStubs << ',' << Sample.XMLByteCount << ',';
+    ResultsStream << Sample.Job.DiagramWidth << ',' << Sample.Job.DiagramHeight;
+    TotalMicroseconds = 0u;
+    for (uint32_t Phase = 0u; Phase < NumPhases; Phase++)
+    {
+        ResultsStream << ',' << Sample.PhaseMicroseconds[Phase];
+        TotalMicroseconds += Sample.PhaseMicroseconds[Phase];
+    }
+    Status = Sample.Status;
+    std::replace(Status.begin(), Status.end(), ',', ';');
+    std::replace(Status.begin(), Status.end(), '\n', ' ');
+    ResultsStream << ',' << TotalMicroseconds << ',' << Sample.PeakRSSKilobytes << ',' << Status << '\n';
+}
+
+uint32_t ParseBenchmarkArgument(int argc, char **argv, int ArgumentIndex, uint32_t DefaultValue)
+{
+    if (argc > ArgumentIndex)
+    {
+        return std::atoi(argv[ArgumentIndex]);
+    }
+
+    return DefaultValue;
+}
+
+int main(int argc, char **argv)
+{
+    IDEF::SyntheticDiagramSpec BaseSpec;
+    std::ofstream ResultsStream;
+    std::string ScratchPath;
+    uint32_t MaxActivities;
+    uint32_t NumRepetitions;
+    uint32_t NumFailed;
+    IDEF::BoxLayout Layout;
+
+    if ((argc < 2) || (strcmp(argv[1u], "-h") == 0))
+    {
+        std::cout << "Parameter 1: Results file's path, written as comma separated values." << std::endl;
+        std::cout << "Parameter 2: Largest number of activities, the sweep doubles from 1 up to it (default 32)." << std::endl;
+        std::cout << "Parameter 3: Arrows per activity interface (default 2)." << std::endl;
+        std::cout << "Parameter 4: Number of later activities reading each output (default 2)." << std::endl;
+        std::cout << "Parameter 5: Boundary stubs per diagram side (default 2)." << std::endl;
+        std::cout << "Parameter 6: Repetitions per size, the fastest time of each phase is kept (default 3)." << std::endl;
+        std::cout << "Parameter 7: Box layout, 0 for the diagonal or 1 for the grid (default 0)." << std::endl;
+        return (argc < 2) ? 1 : 0;
+    }
+    MaxActivities = ParseBenchmarkArgument(argc, argv, 2, 32u);
+    BaseSpec.ArrowsPerInterface = ParseBenchmarkArgument(argc, argv, 3, 2u);
+    BaseSpec.FanOut = ParseBenchmarkArgument(argc, argv, 4, 2u);
+    BaseSpec.NumBoundaryStubs = ParseBenchmarkArgument(argc, argv, 5, 2u);
+    NumRepetitions = std::max(ParseBenchmarkArgument(argc, argv, 6, 3u), 1u);
+    Layout = (ParseBenchmarkArgument(argc, argv, 7, 0u) == 1u) ? IDEF::GridBoxLayout : IDEF::DiagonalBoxLayout;
+    BaseSpec.Seed = 1u;
+    ResultsStream.open(argv[1u], std::ios_base::out);
+    if (ResultsStream.is_open() == false)
+    {
+        std::cerr << "Could not open the results file '" << argv[1u] << "'." << std::endl;
+        return 1;
+    }
+    ScratchPath = (std::filesystem::temp_directory_path() / "IDEFBenchmark").string();
+    WriteBenchmarkHeader(ResultsStream);
+    WriteBenchmarkHeader(std::cout);
+    NumFailed = 0u;
+    for (uint32_t NumActivities = 1u; NumActivities <= MaxActivities; NumActivities *= 2u)
+    {
+        BenchmarkSample Sample;
+
+        Sample.Spec = BaseSpec;
+        Sample.Spec.NumActivities = NumActivities;
+        Sample.Job = SyntheticPlotJob(Sample.Spec, Layout, ScratchPath);
+        Sample.XMLByteCount = 0u;
+        std::fill(Sample.PhaseMicroseconds, Sample.PhaseMicroseconds + NumPhases, 0u);
+        try
+        {
+            MeasureBenchmarkSample(Sample, NumRepetitions);
+            Sample.Status = "OK";
+        }
+        catch (const std::exception& Exception)
+        {
+            std::fill(Sample.PhaseMicroseconds, Sample.PhaseMicroseconds + NumPhases, 0u);
+            Sample.Status = std::string("ERROR ") + Exception.what();
+            NumFailed++;
+        }
+        Sample.PeakRSSKilobytes = ReadPeakRSSKilobytes();
+        WriteBenchmarkSample(ResultsStream, Sample);
+        WriteBenchmarkSample(std::cout, Sample);
+        ResultsStream.flush();
+    }
+    std::remove((ScratchPath + ".xml").c_str());
+    std::remove((ScratchPath + ".txt").c_str());
+
+    return (NumFailed == 0u) ? 0 : 1;
+}
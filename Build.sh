@@ -35,4 +35,14 @@ $compiler -g -std=c++20 -c Placing.cpp -Ipugixml/src/ -Iadaptagrams/cola/
 $compiler -g -std=c++20 -c Drawing.cpp -Ipugixml/src/ -Iadaptagrams/cola/
 $compiler -g -std=c++20 -c Layouting.cpp -Ipugixml/src/ -Iadaptagrams/cola/
 $compiler -g -std=c++20 -c Loading.cpp -Ipugixml/src/ -Iadaptagrams/cola/
-$compiler -g -std=c++20 main.o Placing.o Drawing.o Layouting.o Loading.o pugixml.o actioninfo.o connectionpin.o connector.o connend.o geometry.o geomtypes.o graph.o hyperedge.o hyperedgeimprover.o hyperedgetree.o junction.o makepath.o mtst.o obstacle.o orthogonal.o router.o scanline.o shape.o timer.o vertices.o viscluster.o visibility.o vpsc.o
+$compiler -g -std=c++20 -c Plotting.cpp -Ipugixml/src/ -Iadaptagrams/cola/
+$compiler -g -std=c++20 -c Serving.cpp -Ipugixml/src/ -Iadaptagrams/cola/
+$compiler -g -std=c++20 -c Editing.cpp -Ipugixml/src/ -Iadaptagrams/cola/
+$compiler -g -std=c++20 -c Generating.cpp -Ipugixml/src/ -Iadaptagrams/cola/
+$compiler -g -std=c++20 -c Caching.cpp -Ipugixml/src/ -Iadaptagrams/cola/
+$compiler -g -std=c++20 -c Fitting.cpp -Ipugixml/src/ -Iadaptagrams/cola/
+$compiler -g -std=c++20 -c Benchmark.cpp -Ipugixml/src/ -Iadaptagrams/cola/
+$compiler -g -std=c++20 -pthread main.o Placing.o Drawing.o Layouting.o Loading.o Plotting.o Caching.o Fitting.o Serving.o Editing.o pugixml.o actioninfo.o connectionpin.o connector.o connend.o geometry.o geomtypes.o graph.o hyperedge.o hyperedgeimprover.o hyperedgetree.o junction.o makepath.o mtst.o obstacle.o orthogonal.o router.o scanline.o shape.o timer.o vertices.o viscluster.o visibility.o vpsc.o
+
+# Benchmark
+$compiler -g -std=c++20 -pthread Benchmark.o Placing.o Drawing.o Layouting.o Loading.o Plotting.o Caching.o Fitting.o Generating.o pugixml.o actioninfo.o connectionpin.o connector.o connend.o geometry.o geomtypes.o graph.o hyperedge.o hyperedgeimprover.o hyperedgetree.o junction.o makepath.o mtst.o obstacle.o orthogonal.o router.o scanline.o shape.o timer.o vertices.o viscluster.o visibility.o vpsc.o -o IDEFBenchmark
@@ -0,0 +1,541 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <variant>
+#include <libavoid/libavoid.h>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <pugixml.hpp>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "Loading.h"
+#include "Layouting.h"
+#include "Drawing.h"
+#include "Plotting.h"
+#include "Caching.h"
+
+namespace IDEF
+{
+
+// A cache file is a CacheHeader, then the diagram's fixed size fields and counts as records,
+// then a pool holding every piece of text once. Records refer to text by its offset and length
+// in the pool, so a cached diagram's names are views into the cache file's bytes. Values are
+// stored in the host's byte order, the version changes whenever the record layout does.
+const char CacheMagic[8u] = {'I', 'D', 'E', 'F', 'C', 'A', 'C', 'H'};
+const uint32_t CacheVersion = 5u;
+
+struct CacheWriter
+{
+    std::string Records;
+    std::string TextPool;
+    std::unordered_map<std::string_view, uint32_t> TextOffsets;
+};
+
+struct CacheReader
+{
+    const char* Records;
+    size_t RecordsSize;
+    size_t Cursor;
+    const char* TextPool;
+    size_t TextPoolSize;
+};
+
+uint64_t HashSourceText(const char* SourceText, size_t TextSize)
+{
+    uint64_t Hash;
+
+    Hash = 14695981039346656037u;
+    for (size_t CharIndex = 0u; CharIndex < TextSize; CharIndex++)
+    {
+        Hash ^= (uint8_t)SourceText[CharIndex];
+        Hash *= 1099511628211u;
+    }
+
+    return Hash;
+}
+
+// The loaded stage only depends on the XML, the laid out stage also on the plot's sizes and box layout.
+std::string CacheFilePath(const PlotJob& Job, CacheStage Stage)
+{
+    std::string FilePath;
+
+    FilePath = Job.InputFilePath;
+    if (Stage == LayedOutStage)
+    {
+        FilePath += "." + std::to_string(Job.DiagramWidth) + "x" + std::to_string(Job.DiagramHeight);
+        FilePath += "." + std::to_string(Job.BoxWidth) + "x" + std::to_string(Job.BoxHeight);
+        FilePath += "." + std::to_string(Job.BoxXGap) + "x" + std::to_string(Job.BoxYGap);
+        if (Job.Layout == GridBoxLayout)
+        {
+            FilePath += ".grid";
+        }
+    }
+    FilePath += ".idefcache";
+
+    return FilePath;
+}
+
+void WriteCacheValue(CacheWriter& Writer, uint32_t Value)
+{
+    Writer.Records.append((const char*)&Value, sizeof(Value));
+}
+
+void WriteCacheText(CacheWriter& Writer, std::string_view Text)
+{
+    std::unordered_map<std::string_view, uint32_t>::iterator FoundText;
+    uint32_t TextOffset;
+
+    FoundText = Writer.TextOffsets.find(Text);
+    if (FoundText == Writer.TextOffsets.end())
+    {
+        TextOffset = Writer.TextPool.size();
+        Writer.TextPool.append(Text.data(), Text.size());
+        Writer.TextOffsets.insert({Text, TextOffset});
+    }
+    else
+    {
+        TextOffset = FoundText->second;
+    }
+    WriteCacheValue(Writer, TextOffset);
+    WriteCacheValue(Writer, Text.size());
+}
+
+void WriteCachePosition(CacheWriter& Writer, const FilePosition& Position)
+{
+    WriteCacheValue(Writer, Position.Row);
+    WriteCacheValue(Writer, Position.Column);
+}
+
+void WriteCacheRange(CacheWriter& Writer, const StubRange& Range)
+{
+    WriteCacheValue(Writer, Range.First);
+    WriteCacheValue(Writer, Range.End);
+}
+
+void WriteCacheStubTable(CacheWriter& Writer, const StubTable& Stubs)
+{
+    uint32_t NumStubs;
+    uint32_t NumSources;
+
+    NumStubs = Stubs.Kinds.size();
+    NumSources = Stubs.SourceNameIDs.size();
+    WriteCacheValue(Writer, NumStubs);
+    WriteCacheValue(Writer, NumSources);
+    for (uint32_t StubID = 0u; StubID < NumStubs; StubID++)
+    {
+        WriteCacheValue(Writer, Stubs.Kinds[StubID]);
+        WriteCacheValue(Writer, Stubs.OwnerBoxes[StubID]);
+        WriteCachePosition(Writer, Stubs.Positions[StubID]);
+        WriteCacheValue(Writer, Stubs.Lengths[StubID]);
+        WriteCacheValue(Writer, Stubs.Headed[StubID]);
+        WriteCacheText(Writer, Stubs.Names[StubID]);
+        WriteCacheValue(Writer, Stubs.NameIDs[StubID]);
+        WriteCacheValue(Writer, Stubs.FirstSources[StubID + 1u]);
+    }
+    for (uint32_t SourceIndex = 0u; SourceIndex < NumSources; SourceIndex++)
+    {
+        WriteCacheText(Writer, Stubs.SourceNames[SourceIndex]);
+        WriteCacheValue(Writer, Stubs.SourceNameIDs[SourceIndex]);
+    }
+}
+
+template <typename SectionType>
+void WriteCacheSection(CacheWriter& Writer, const DiagramSection& Section)
+{
+    const SectionType& TypedSection = std::get<SectionType>(Section);
+
+    WriteCachePosition(Writer, TypedSection.TopLeft);
+    WriteCacheText(Writer, TypedSection.Content);
+    WriteCacheValue(Writer, TypedSection.Width);
+    WriteCacheValue(Writer, TypedSection.Height);
+}
+
+// Writes to a uniquely named file first and renames it into place, so processes sharing a
+// cache never read a half written file. The temporary file is removed whenever either step fails.
+void WriteDiagramCache(const ActivityDiagram& Diagram, const PlotJob& Job, CacheStage Stage, uint64_t SourceHash)
+{
+    CacheWriter Writer;
+    CacheHeader Header;
+    std::string FilePath;
+    std::string TemporaryFilePath;
+    std::ofstream CacheFileStream;
+    std::random_device RandomDevice;
+    std::error_code RenameError;
+
+    WriteCacheText(Writer, Diagram.Title);
+    WriteCacheValue(Writer, Diagram.Width);
+    WriteCacheValue(Writer, Diagram.Height);
+    WriteCacheValue(Writer, Diagram.NumStubs);
+    WriteCacheValue(Writer, Diagram.NumNames);
+    WriteCachePosition(Writer, Diagram.Frame.BottomBar.TopLeft);
+    WriteCacheValue(Writer, Diagram.Frame.BottomBar.Height);
+    WriteCacheSection<NodeNumberSection>(Writer, Diagram.Frame.BottomBar.NodeNumberSection);
+    WriteCacheSection<TitleSection>(Writer, Diagram.Frame.BottomBar.TitleSection);
+    WriteCacheSection<CNumberSection>(Writer, Diagram.Frame.BottomBar.CNumberSection);
+    WriteCacheValue(Writer, Diagram.Boxes.size());
+    for (const ActivityBox& SelectedBox : Diagram.Boxes)
+    {
+        WriteCacheText(Writer, SelectedBox.Name);
+        WriteCacheText(Writer, SelectedBox.NodeNumber);
+        WriteCacheText(Writer, SelectedBox.DRE);
+        WriteCachePosition(Writer, SelectedBox.Center);
+        WriteCacheValue(Writer, SelectedBox.Width);
+        WriteCacheValue(Writer, SelectedBox.Height);
+        WriteCacheValue(Writer, SelectedBox.Padding);
+        WriteCacheRange(Writer, SelectedBox.InputStubs);
+        WriteCacheRange(Writer, SelectedBox.OutputStubs);
+        WriteCacheRange(Writer, SelectedBox.ControlStubs);
+        WriteCacheRange(Writer, SelectedBox.MechanismStubs);
+        WriteCacheRange(Writer, SelectedBox.CallStubs);
+    }
+    WriteCacheRange(Writer, Diagram.InputBoundaryStubs);
+    WriteCacheRange(Writer, Diagram.OutputBoundaryStubs);
+    WriteCacheRange(Writer, Diagram.ControlBoundaryStubs);
+    WriteCacheRange(Writer, Diagram.MechanismBoundaryStubs);
+    WriteCacheStubTable(Writer, Diagram.Stubs);
+
+    memset(&Header, 0, sizeof(Header));
+    memcpy(Header.Magic, CacheMagic, sizeof(CacheMagic));
+    Header.Version = CacheVersion;
+    Header.Stage = Stage;
+    Header.SourceHash = SourceHash;
+    if (Stage == LayedOutStage)
+    {
+        Header.DiagramWidth = Job.DiagramWidth;
+        Header.DiagramHeight = Job.DiagramHeight;
+        Header.BoxWidth = Job.BoxWidth;
+        Header.BoxHeight = Job.BoxHeight;
+        Header.BoxXGap = Job.BoxXGap;
+        Header.BoxYGap = Job.BoxYGap;
+        Header.Layout = Job.Layout;
+    }
+    Header.RecordsSize = Writer.Records.size();
+    Header.TextPoolSize = Writer.TextPool.size();
+    FilePath = CacheFilePath(Job, Stage);
+    TemporaryFilePath = FilePath + "." + std::to_string(RandomDevice()) + ".tmp";
+    CacheFileStream.open(TemporaryFilePath, std::ios_base::out | std::ios_base::binary);
+    if (CacheFileStream.is_open() == false)
+    {
+        throw std::runtime_error("Could not open the cache file: " + TemporaryFilePath);
+    }
+    CacheFileStream.write((const char*)&Header, sizeof(Header));
+    CacheFileStream.write(Writer.Records.data(), Writer.Records.size());
+    CacheFileStream.write(Writer.TextPool.data(), Writer.TextPool.size());
+    CacheFileStream.close();
+    if (CacheFileStream.fail())
+    {
+        std::remove(TemporaryFilePath.c_str());
+        throw std::runtime_error("Could not write the cache file: " + TemporaryFilePath);
+    }
+    std::filesystem::rename(TemporaryFilePath, FilePath, RenameError);
+    if (RenameError)
+    {
+        std::remove(TemporaryFilePath.c_str());
+        throw std::runtime_error("Could not move the cache file into place: " + FilePath);
+    }
+}
+
+uint32_t ReadCacheValue(CacheReader& Reader)
+{
+    uint32_t Value;
+
+    if ((Reader.RecordsSize - Reader.Cursor) < sizeof(Value))
+    {
+        throw std::runtime_error("The cache file is truncated.");
+    }
+    memcpy(&Value, Reader.Records + Reader.Cursor, sizeof(Value));
+    Reader.Cursor += sizeof(Value);
+
+    return Value;
+}
+
+std::string_view ReadCacheText(CacheReader& Reader)
+{
+    uint32_t TextOffset;
+    uint32_t TextLength;
+
+    TextOffset = ReadCacheValue(Reader);
+    TextLength = ReadCacheValue(Reader);
+    if ((TextOffset > Reader.TextPoolSize) || (TextLength > (Reader.TextPoolSize - TextOffset)))
+    {
+        throw std::runtime_error("The cache file's text pool is truncated.");
+    }
+
+    return std::string_view(Reader.TextPool + TextOffset, TextLength);
+}
+
+FilePosition ReadCachePosition(CacheReader& Reader)
+{
+    FilePosition Position;
+
+    Position.Row = ReadCacheValue(Reader);
+    Position.Column = ReadCacheValue(Reader);
+
+    return Position;
+}
+
+StubRange ReadCacheRange(CacheReader& Reader)
+{
+    StubRange Range;
+
+    Range.First = ReadCacheValue(Reader);
+    Range.End = ReadCacheValue(Reader);
+
+    return Range;
+}
+
+// Every ID and index in the table is checked, the rest of the plotter indexes with them freely.
+void ReadCacheStubTable(CacheReader& Reader, uint32_t NumNames, StubTable& Stubs)
+{
+    uint32_t NumStubs;
+    uint32_t NumSources;
+
+    NumStubs = ReadCacheValue(Reader);
+    NumSources = ReadCacheValue(Reader);
+    if ((NumStubs > (Reader.RecordsSize / sizeof(uint32_t))) || (NumSources > (Reader.RecordsSize / sizeof(uint32_t))))
+    {
+        throw std::runtime_error("The cache file's stub table is truncated.");
+    }
+    ReserveStubTable(Stubs, NumStubs, NumSources);
+    Stubs.FirstSources.push_back(0u);
+    for (uint32_t StubID = 0u; StubID < NumStubs; StubID++)
+    {
+        uint32_t Kind;
+
+        Kind = ReadCacheValue(Reader);
+        if (Kind > CallInterface)
+        {
+            throw std::runtime_error("The cache file holds an unknown stub kind.");
+        }
+        Stubs.Kinds.push_back((Interface)Kind);
+        Stubs.OwnerBoxes.push_back(ReadCacheValue(Reader));
+        Stubs.Positions.push_back(ReadCachePosition(Reader));
+        Stubs.Lengths.push_back(ReadCacheValue(Reader));
+        Stubs.Headed.push_back(ReadCacheValue(Reader) != 0u);
+        Stubs.Names.push_back(ReadCacheText(Reader));
+        Stubs.NameIDs.push_back(ReadCacheValue(Reader));
+        Stubs.FirstSources.push_back(ReadCacheValue(Reader));
+        if ((Stubs.NameIDs.back() >= NumNames) || (Stubs.FirstSources[StubID + 1u] < Stubs.FirstSources[StubID]) ||
+            (Stubs.FirstSources[StubID + 1u] > NumSources))
+        {
+            throw std::runtime_error("The cache file's stub table is inconsistent.");
+        }
+    }
+    for (uint32_t SourceIndex = 0u; SourceIndex < NumSources; SourceIndex++)
+    {
+        Stubs.SourceNames.push_back(ReadCacheText(Reader));
+        Stubs.SourceNameIDs.push_back(ReadCacheValue(Reader));
+        if (Stubs.SourceNameIDs.back() >= NumNames)
+        {
+            throw std::runtime_error("The cache file's stub table is inconsistent.");
+        }
+    }
+}
+
+void CheckCacheRange(const StubRange& Range, uint32_t NumStubs)
+{
+    if ((Range.First > Range.End) || (Range.End > NumStubs))
+    {
+        throw std::runtime_error("The cache file holds a stub range outside of its table.");
+    }
+}
+
+template <typename SectionType>
+void ReadCacheSection(CacheReader& Reader, DiagramSection& Section)
+{
+    SectionType NewSection;
+
+    NewSection.TopLeft = ReadCachePosition(Reader);
+    NewSection.Content = ReadCacheText(Reader);
+    NewSection.Width = ReadCacheValue(Reader);
+    NewSection.Height = ReadCacheValue(Reader);
+    Section = NewSection;
+}
+
+void ReadCacheRecords(CacheReader& Reader, ActivityDiagram& CachedDiagram)
+{
+    uint32_t NumBoxes;
+
+    CachedDiagram.Title = ReadCacheText(Reader);
+    CachedDiagram.Width = ReadCacheValue(Reader);
+    CachedDiagram.Height = ReadCacheValue(Reader);
+    CachedDiagram.NumStubs = ReadCacheValue(Reader);
+    CachedDiagram.NumNames = ReadCacheValue(Reader);
+    CachedDiagram.Frame.BottomBar.TopLeft = ReadCachePosition(Reader);
+    CachedDiagram.Frame.BottomBar.Height = ReadCacheValue(Reader);
+    ReadCacheSection<NodeNumberSection>(Reader, CachedDiagram.Frame.BottomBar.NodeNumberSection);
+    ReadCacheSection<TitleSection>(Reader, CachedDiagram.Frame.BottomBar.TitleSection);
+    ReadCacheSection<CNumberSection>(Reader, CachedDiagram.Frame.BottomBar.CNumberSection);
+    NumBoxes = ReadCacheValue(Reader);
+    CachedDiagram.Boxes.resize(NumBoxes);
+    for (ActivityBox& SelectedBox : CachedDiagram.Boxes)
+    {
+        SelectedBox.Name = ReadCacheText(Reader);
+        SelectedBox.NodeNumber = ReadCacheText(Reader);
+        SelectedBox.DRE = ReadCacheText(Reader);
+        SelectedBox.Center = ReadCachePosition(Reader);
+        SelectedBox.Width = ReadCacheValue(Reader);
+        SelectedBox.Height = ReadCacheValue(Reader);
+        SelectedBox.Padding = ReadCacheValue(Reader);
+        SelectedBox.InputStubs = ReadCacheRange(Reader);
+        SelectedBox.OutputStubs = ReadCacheRange(Reader);
+        SelectedBox.ControlStubs = ReadCacheRange(Reader);
+        SelectedBox.MechanismStubs = ReadCacheRange(Reader);
+        SelectedBox.CallStubs = ReadCacheRange(Reader);
+    }
+    CachedDiagram.InputBoundaryStubs = ReadCacheRange(Reader);
+    CachedDiagram.OutputBoundaryStubs = ReadCacheRange(Reader);
+    CachedDiagram.ControlBoundaryStubs = ReadCacheRange(Reader);
+    CachedDiagram.MechanismBoundaryStubs = ReadCacheRange(Reader);
+    ReadCacheStubTable(Reader, CachedDiagram.NumNames, CachedDiagram.Stubs);
+    if (CachedDiagram.NumStubs != CachedDiagram.Stubs.Kinds.size())
+    {
+        throw std::runtime_error("The cache file's stub count does not match its table.");
+    }
+    // Cached diagrams come from single diagram files, so every name is one of their stubs' names.
+    if (CachedDiagram.NumNames > (CachedDiagram.Stubs.Kinds.size() + CachedDiagram.Stubs.SourceNameIDs.size()))
+    {
+        throw std::runtime_error("The cache file holds more names than its stubs use.");
+    }
+    for (const ActivityBox& SelectedBox : CachedDiagram.Boxes)
+    {
+        CheckCacheRange(SelectedBox.InputStubs, CachedDiagram.NumStubs);
+        CheckCacheRange(SelectedBox.OutputStubs, CachedDiagram.NumStubs);
+        CheckCacheRange(SelectedBox.ControlStubs, CachedDiagram.NumStubs);
+        CheckCacheRange(SelectedBox.MechanismStubs, CachedDiagram.NumStubs);
+        CheckCacheRange(SelectedBox.CallStubs, CachedDiagram.NumStubs);
+    }
+    CheckCacheRange(CachedDiagram.InputBoundaryStubs, CachedDiagram.NumStubs);
+    CheckCacheRange(CachedDiagram.OutputBoundaryStubs, CachedDiagram.NumStubs);
+    CheckCacheRange(CachedDiagram.ControlBoundaryStubs, CachedDiagram.NumStubs);
+    CheckCacheRange(CachedDiagram.MechanismBoundaryStubs, CachedDiagram.NumStubs);
+    IndexStubReferences(CachedDiagram);
+}
+
+// Returns false when there is no usable cache: a missing or damaged file, another version,
+// stage or source, a laid out cache made for other sizes or whose geometry leaves the diagram. The rebuilt diagram's text refers
+// into the cache file's bytes, which it keeps alive through its SourceText.
+bool ReadDiagramCache(const PlotJob& Job, CacheStage Stage, uint64_t SourceHash, ActivityDiagram& CachedDiagram)
+{
+    std::string FilePath;
+    std::shared_ptr<char> CacheText;
+    size_t CacheSize;
+    CacheHeader Header;
+    CacheReader Reader;
+    ActivityDiagram NewDiagram;
+    std::error_code ExistsError;
+
+    FilePath = CacheFilePath(Job, Stage);
+    if (std::filesystem::exists(FilePath, ExistsError) == false)
+    {
+        return false;
+    }
+    try
+    {
+        CacheText = LoadSourceText(FilePath, CacheSize);
+    }
+    catch (const std::exception&)
+    {
+        return false;
+    }
+    if (CacheSize < sizeof(Header))
+    {
+        return false;
+    }
+    memcpy(&Header, CacheText.get(), sizeof(Header));
+    if ((memcmp(Header.Magic, CacheMagic, sizeof(CacheMagic)) != 0) || (Header.Version != CacheVersion) ||
+        (Header.Stage != (uint32_t)Stage) || (Header.SourceHash != SourceHash))
+    {
+        return false;
+    }
+    if ((Stage == LayedOutStage) && ((Header.DiagramWidth != Job.DiagramWidth) || (Header.DiagramHeight != Job.DiagramHeight) ||
+        (Header.BoxWidth != Job.BoxWidth) || (Header.BoxHeight != Job.BoxHeight) ||
+        (Header.BoxXGap != Job.BoxXGap) || (Header.BoxYGap != Job.BoxYGap) || (Header.Layout != (uint32_t)Job.Layout)))
+    {
+        return false;
+    }
+    if ((Header.RecordsSize > (CacheSize - sizeof(Header))) || (Header.TextPoolSize != ((CacheSize - sizeof(Header)) - Header.RecordsSize)))
+    {
+        return false;
+    }
+    Reader.Records = CacheText.get() + sizeof(Header);
+    Reader.RecordsSize = Header.RecordsSize;
+    Reader.Cursor = 0u;
+    Reader.TextPool = Reader.Records + Header.RecordsSize;
+    Reader.TextPoolSize = Header.TextPoolSize;
+
+    // A laid out diagram goes straight to routing and drawing, so its geometry is checked as if it
+    // had just been laid out.
+    try
+    {
+        ReadCacheRecords(Reader, NewDiagram);
+        if (Stage == LayedOutStage)
+        {
+            if ((NewDiagram.Width != Job.DiagramWidth) || (NewDiagram.Height != Job.DiagramHeight))
+            {
+                return false;
+            }
+            CheckLayoutBounds(NewDiagram);
+        }
+    }
+    catch (const std::exception&)
+    {
+        return false;
+    }
+    NewDiagram.SourceText = CacheText;
+    CachedDiagram = NewDiagram;
+
+    return true;
+}
+
+// The cache only saves work, a directory that cannot be written to leaves the plot uncached.
+void TryWriteDiagramCache(const ActivityDiagram& Diagram, const PlotJob& Job, CacheStage Stage, uint64_t SourceHash)
+{
+    try
+    {
+        WriteDiagramCache(Diagram, Job, Stage, SourceHash);
+    }
+    catch (const std::exception&)
+    {
+    }
+}
+
+// Hashes the XML and takes the laid out diagram from the cache when it matches. Otherwise the
+// loaded diagram comes from its own cache or the XML, is laid out and both caches are refreshed
+// where they can be written.
+ActivityDiagram LoadLayedOutDiagramCached(const PlotJob& Job, uint32_t MaxThreads)
+{
+    std::shared_ptr<char> SourceText;
+    size_t TextSize;
+    uint64_t SourceHash;
+    ActivityDiagram CachedDiagram;
+
+    SourceText = LoadSourceText(Job.InputFilePath, TextSize);
+    SourceHash = HashSourceText(SourceText.get(), TextSize);
+    if (ReadDiagramCache(Job, LayedOutStage, SourceHash, CachedDiagram) == true)
+    {
+        return CachedDiagram;
+    }
+    if (ReadDiagramCache(Job, LoadedStage, SourceHash, CachedDiagram) == false)
+    {
+        CachedDiagram = LoadActivityDiagramFileSource(Job.InputFilePath, SourceText, TextSize, MaxThreads);
+        TryWriteDiagramCache(CachedDiagram, Job, LoadedStage, SourceHash);
+    }
+    LayoutActivityDiagram(CachedDiagram, Job.DiagramWidth, Job.DiagramHeight, Job.BoxWidth, Job.BoxHeight, Job.BoxXGap, Job.BoxYGap, Job.Layout);
+    TryWriteDiagramCache(CachedDiagram, Job, LayedOutStage, SourceHash);
+
+    return CachedDiagram;
+}
+
+}
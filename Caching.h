@@ -0,0 +1,39 @@
+#ifndef CACHING_H
+#define CACHING_H
+
+namespace IDEF
+{
+
+enum CacheStage
+{
+    LoadedStage,
+    LayedOutStage
+};
+
+struct CacheHeader
+{
+    char Magic[8u];
+    uint32_t Version;
+    uint32_t Stage;
+    uint64_t SourceHash;
+    uint32_t DiagramWidth;
+    uint32_t DiagramHeight;
+    uint32_t BoxWidth;
+    uint32_t BoxHeight;
+    uint32_t BoxXGap;
+    uint32_t BoxYGap;
+    uint32_t Layout;
+    uint64_t RecordsSize;
+    uint64_t TextPoolSize;
+};
+
+uint64_t HashSourceText(const char* SourceText, size_t TextSize);
+std::string CacheFilePath(const PlotJob& Job, CacheStage Stage);
+void WriteDiagramCache(const ActivityDiagram& Diagram, const PlotJob& Job, CacheStage Stage, uint64_t SourceHash);
+void TryWriteDiagramCache(const ActivityDiagram& Diagram, const PlotJob& Job, CacheStage Stage, uint64_t SourceHash);
+bool ReadDiagramCache(const PlotJob& Job, CacheStage Stage, uint64_t SourceHash, ActivityDiagram& CachedDiagram);
+ActivityDiagram LoadLayedOutDiagramCached(const PlotJob& Job, uint32_t MaxThreads);
+
+}
+
+#endif
@@ -6,9 +6,13 @@
 #include <variant>
 #include <libavoid/libavoid.h>
 #include <map>
+#include <memory>
+#include <memory_resource>
 #include <pugixml.hpp>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 #include "Loading.h"
@@ -19,171 +23,201 @@
 namespace IDEF
 {
 
-void DrawRoutes(Avoid::Router* ConnectedRouter, std::vector<std::string>& Diagram, const ActivityDiagram& TargetDiagram)
+// Every row is followed by its newline so the raster can be written out as it is, which makes
+// the row stride one more than the width.
+DiagramRaster ConstructRaster(uint32_t Width, uint32_t Height)
 {
-    for (Avoid::ConnRef *ConnRef : ConnectedRouter->connRefs)
+    DiagramRaster Raster;
+
+    Raster.Width = Width;
+    Raster.Height = Height;
+    Raster.Stride = Width + 1u;
+    Raster.Cells.assign((size_t)Raster.Stride * Height, ' ');
+    Raster.TextWordsPerRow = (Width + 63u) / 64u;
+    Raster.TextMask.assign((size_t)Raster.TextWordsPerRow * Height, 0u);
+    for (uint32_t Row = 0u; Row < Height; Row++)
+    {
+        Raster.Cells[((size_t)Row * Raster.Stride) + Width] = '\n';
+    }
+
+    return Raster;
+}
+
+// Alongside the characters the raster keeps one bit per cell that is set while the cell holds a
+// letter or digit, so label placement can test a whole run of cells a word at a time.
+void SetRasterCell(DiagramRaster& Raster, uint32_t Row, uint32_t Column, char Glyph)
+{
+    uint64_t TextBit;
+
+#ifndef NDEBUG
+    if ((Row >= Raster.Height) || (Column >= Raster.Width))
+    {
+        throw std::out_of_range("Drawing outside of the diagram at row " + std::to_string(Row) +
+            ", column " + std::to_string(Column) + ".");
+    }
+#endif
+    Raster.Cells[((size_t)Row * Raster.Stride) + Column] = Glyph;
+    uint64_t& TextWord = Raster.TextMask[((size_t)Row * Raster.TextWordsPerRow) + (Column / 64u)];
+    TextBit = (uint64_t)1u << (Column % 64u);
+    if (std::isalnum((unsigned char)Glyph))
     {
-        const Avoid::PolyLine &Route = ConnRef->displayRoute();
-        uint32_t NumVertices;
-        uint32_t VertexIndex;
-        std::string TravelDir;
+        TextWord |= TextBit;
+    }
+    else
+    {
+        TextWord &= ~TextBit;
+    }
+}
+
+LineMask ConstructLineMask(uint32_t Width, uint32_t Height)
+{
+    LineMask Lines;
+
+    Lines.Width = Width;
+    Lines.Height = Height;
+    Lines.Cells.assign((size_t)Width * Height, 0u);
 
-        NumVertices = Route.size();
-        for (uint32_t VertexIndex = 0u; VertexIndex < (NumVertices - 1u); VertexIndex++)
+    return Lines;
+}
+
+// Marks a straight run from its start cell to its end cell, the interior cells are filled
+// with both directions of the run in one pass over the mask.
+void MarkLineRun(LineMask& Lines, FilePosition RunStart, FilePosition RunEnd, LineDirection Direction)
+{
+    uint8_t StartBits;
+    uint8_t EndBits;
+    uint8_t ThroughBits;
+    uint32_t RunLength;
+    size_t CellIndex;
+    ptrdiff_t CellStep;
+
+#ifndef NDEBUG
+    if ((RunStart.Row >= Lines.Height) || (RunStart.Column >= Lines.Width) ||
+        (RunEnd.Row >= Lines.Height) || (RunEnd.Column >= Lines.Width))
+    {
+        throw std::out_of_range("Route runs outside of the diagram from row " + std::to_string(RunStart.Row) +
+            ", column " + std::to_string(RunStart.Column) + ".");
+    }
+#endif
+    if (Direction == NorthLine)
+    {
+        StartBits = NorthLine;
+        EndBits = SouthLine;
+        RunLength = RunStart.Row - RunEnd.Row;
+        CellStep = -(ptrdiff_t)Lines.Width;
+    }
+    else if (Direction == SouthLine)
+    {
+        StartBits = SouthLine;
+        EndBits = NorthLine;
+        RunLength = RunEnd.Row - RunStart.Row;
+        CellStep = (ptrdiff_t)Lines.Width;
+    }
+    else if (Direction == EastLine)
+    {
+        StartBits = EastLine;
+        EndBits = WestLine;
+        RunLength = RunEnd.Column - RunStart.Column;
+        CellStep = 1;
+    }
+    else
+    {
+        StartBits = WestLine;
+        EndBits = EastLine;
+        RunLength = RunStart.Column - RunEnd.Column;
+        CellStep = -1;
+    }
+    ThroughBits = StartBits | EndBits;
+    CellIndex = ((size_t)RunStart.Row * Lines.Width) + RunStart.Column;
+    Lines.Cells[CellIndex] |= StartBits;
+    for (uint32_t RunIndex = 1u; RunIndex < RunLength; RunIndex++)
+    {
+        CellIndex += CellStep;
+        Lines.Cells[CellIndex] |= ThroughBits;
+    }
+    CellIndex += CellStep;
+    Lines.Cells[CellIndex] |= EndBits;
+}
+
+void DrawRoute(Avoid::ConnRef* ConnRef, LineMask& Lines, const ActivityDiagram& TargetDiagram)
+{
+    const Avoid::PolyLine &Route = ConnRef->displayRoute();
+    uint32_t NumVertices;
+
+    NumVertices = Route.size();
+    for (uint32_t VertexIndex = 0u; (VertexIndex + 1u) < NumVertices; VertexIndex++)
+    {
+        FilePosition LineStartPoint;
+        FilePosition LineEndPoint;
+        LineDirection TravelDir;
+
+        const Avoid::Point &FirstPoint = Route.at(VertexIndex);
+        const Avoid::Point &SecondPoint = Route.at(VertexIndex + 1u);
+        LineStartPoint.Column = (uint32_t)(round(FirstPoint.x));
+        LineStartPoint.Row = TargetDiagram.Height - (uint32_t)(round(FirstPoint.y));
+        LineEndPoint.Column = (uint32_t)(round(SecondPoint.x));
+        LineEndPoint.Row = TargetDiagram.Height - (uint32_t)(round(SecondPoint.y));
+        if ((LineStartPoint.Row != LineEndPoint.Row) && (LineStartPoint.Column != LineEndPoint.Column))
         {
-            uint32_t NextVertexIndex;
-            FilePosition LineStartPoint;
-            FilePosition LineEndPoint;
-
-            NextVertexIndex = VertexIndex + 1u;
-            const Avoid::Point &FirstPoint = Route.at(VertexIndex);
-            const Avoid::Point &SecondPoint = Route.at(NextVertexIndex);
-            LineStartPoint.Column = (uint32_t)(round(FirstPoint.x));
-            LineStartPoint.Row = TargetDiagram.Height - (uint32_t)(round(FirstPoint.y));
-            LineEndPoint.Column = (uint32_t)(round(SecondPoint.x));
-            LineEndPoint.Row = TargetDiagram.Height - (uint32_t)(round(SecondPoint.y));
-            if (LineEndPoint.Row > LineStartPoint.Row)
-            {
-                TravelDir = "Down";
-            }
-            if (LineEndPoint.Row < LineStartPoint.Row)
-            {
-                TravelDir = "Up";
-            }
-            if (LineEndPoint.Column > LineStartPoint.Column)
-            {
-                TravelDir = "Right";
-            }
-            if (LineEndPoint.Column < LineStartPoint.Column)
-            {
-                TravelDir = "Left";
-            }
-            if (TravelDir == "Down")
-            {
-                uint32_t CursorRow;
-                uint32_t CursorColumn;
+            throw std::runtime_error("Route segment is not orthogonal");
+        }
+        if (LineEndPoint.Row > LineStartPoint.Row)
+        {
+            TravelDir = SouthLine;
+        }
+        else if (LineEndPoint.Row < LineStartPoint.Row)
+        {
+            TravelDir = NorthLine;
+        }
+        else if (LineEndPoint.Column > LineStartPoint.Column)
+        {
+            TravelDir = EastLine;
+        }
+        else if (LineEndPoint.Column < LineStartPoint.Column)
+        {
+            TravelDir = WestLine;
+        }
+        else
+        {
+            continue;
+        }
+        MarkLineRun(Lines, LineStartPoint, LineEndPoint, TravelDir);
+    }
+}
 
-                CursorColumn = LineStartPoint.Column;
-                for (CursorRow = LineStartPoint.Row; CursorRow <= LineEndPoint.Row; CursorRow++)
-                {
-                    if (Diagram[CursorRow][CursorColumn] == '+')
-                    {
-                        continue;
-                    } 
-                    else
-                    {
-                        if (CursorRow == LineEndPoint.Row)
-                        {
-                            Diagram[CursorRow][CursorColumn] = '+';
-                        }
-                        else if ( (CursorRow == LineStartPoint.Row) && (CursorRow == LineStartPoint.Column) )
-                        {
-                            Diagram[CursorRow][CursorColumn] = '+';
-                        }
-                        else
-                        {
-                            Diagram[CursorRow][CursorColumn] = '|';
-                        }
-                       
-                    }
-                }
-            }
-            else if (TravelDir == "Up")
-            {
-                uint32_t CursorRow;
-                uint32_t CursorColumn;
+void DrawRoutes(Avoid::Router* ConnectedRouter, LineMask& Lines, const ActivityDiagram& TargetDiagram)
+{
+    for (Avoid::ConnRef *ConnRef : ConnectedRouter->connRefs)
+    {
+        DrawRoute(ConnRef, Lines, TargetDiagram);
+    }
+}
 
-                CursorColumn = LineStartPoint.Column;
-                for (CursorRow = LineStartPoint.Row; CursorRow >= LineEndPoint.Row; CursorRow--)
-                {
-                    if (Diagram[CursorRow][CursorColumn] == '+')
-                    {
-                        continue;
-                    } 
-                    else
-                    {
-                        if (CursorRow == LineEndPoint.Row)
-                        {
-                            Diagram[CursorRow][CursorColumn] = '+';
-                        }
-                        else if ( CursorRow == LineStartPoint.Row)
-                        {
-                            Diagram[CursorRow][CursorColumn] = '+';
-                        }
-                        else
-                        {
-                            Diagram[CursorRow][CursorColumn] = '|';
-                        }
-                    }
-                }
-            }
-            else if (TravelDir == "Right")
-            {
-                uint32_t CursorRow;
-                uint32_t CursorColumn;
+// A cell joined both horizontally and vertically is a corner, junction or crossing and is drawn
+// as '+', the end of a route carries on the line it ends so it joins the stub drawn over it.
+void ResolveLineGlyphs(const LineMask& Lines, DiagramRaster& Diagram)
+{
+    static const char LineGlyphs[16u] =
+    {
+        ' ', '|', '-', '+', '|', '|', '+', '+',
+        '-', '+', '-', '+', '+', '+', '+', '+'
+    };
 
-                CursorRow = LineStartPoint.Row;
-                for (CursorColumn = LineStartPoint.Column; CursorColumn <= LineEndPoint.Column; CursorColumn++)
-                {
-                    if (Diagram[CursorRow][CursorColumn] == '+')
-                    {
-                        continue;
-                    } 
-                    else
-                    {
-                        if (CursorColumn == LineEndPoint.Column)
-                        {
-                            Diagram[CursorRow][CursorColumn] = '+';
-                        }
-                        else if (CursorColumn == LineStartPoint.Column)
-                        {
-                            Diagram[CursorRow][CursorColumn] = '+';
-                        }
-                        else
-                        {
-                            Diagram[CursorRow][CursorColumn] = '-';
-                        }
-                    }
-                }
-            }
-            else if (TravelDir == "Left")
-            {
-                uint32_t CursorRow;
-                uint32_t CursorColumn;
+    for (uint32_t Row = 0u; Row < Lines.Height; Row++)
+    {
+        const uint8_t* MaskRow = Lines.Cells.data() + ((size_t)Row * Lines.Width);
 
-                CursorRow = LineStartPoint.Row;
-                for (CursorColumn = LineStartPoint.Column; CursorColumn >= LineEndPoint.Column; CursorColumn--)
-                {
-                    if (Diagram[CursorRow][CursorColumn] == '+')
-                    {
-                        continue;
-                    } 
-                    else
-                    {
-                        if (CursorColumn == LineEndPoint.Column)
-                        {
-                            Diagram[CursorRow][CursorColumn] = '+';
-                        }
-                        else if ( (CursorRow == LineStartPoint.Row) && (CursorColumn == LineStartPoint.Column))
-                        {
-                            Diagram[CursorRow][CursorColumn] = '+';
-                        }
-                        else
-                        {
-                            Diagram[CursorRow][CursorColumn] = '-';
-                        }
-                    }
-                }
-            }
-            else
+        for (uint32_t Column = 0u; Column < Lines.Width; Column++)
+        {
+            if (MaskRow[Column] != 0u)
             {
-                throw std::runtime_error("Unknown travel direction");
+                SetRasterCell(Diagram, Row, Column, LineGlyphs[MaskRow[Column]]);
             }
         }
     }
 }
 
-void DrawBoxOutline(std::vector<std::string>& Diagram, const ActivityBox& SelectedBox)
+void DrawBoxOutline(DiagramRaster& Diagram, const ActivityBox& SelectedBox)
 {
     FilePosition BoxTopLeft;
     FilePosition BoxBottomRight;
@@ -200,48 +234,48 @@ void DrawBoxOutline(std::vector<std::string>& Diagram, const ActivityBox& Select
                 {
                     if (CursorY == BoxTopLeft.Row)
                     {
-                        Diagram[CursorY][CursorX] = '+';
+                        SetRasterCell(Diagram, CursorY, CursorX, '+');
                     }
                     else if (CursorY == BoxBottomRight.Row)
                     {
-                        Diagram[CursorY][CursorX] = '+';
+                        SetRasterCell(Diagram, CursorY, CursorX, '+');
                     }
                     else
                     {
-                        Diagram[CursorY][CursorX] = '|';
+                        SetRasterCell(Diagram, CursorY, CursorX, '|');
                     }
                 }
                 else if (CursorX == BoxBottomRight.Column)
                 {
                     if (CursorY == BoxTopLeft.Row)
                     {
-                        Diagram[CursorY][CursorX] = '+';
+                        SetRasterCell(Diagram, CursorY, CursorX, '+');
                     }
                     else if (CursorY == BoxBottomRight.Row)
                     {
-                        Diagram[CursorY][CursorX] = '+';
+                        SetRasterCell(Diagram, CursorY, CursorX, '+');
                     }
                     else
                     {
-                        Diagram[CursorY][CursorX] = '|';
+                        SetRasterCell(Diagram, CursorY, CursorX, '|');
                     }
                 }
                 else
                 {
                     if (CursorY == BoxTopLeft.Row)
                     {
-                        Diagram[CursorY][CursorX] = '-';
+                        SetRasterCell(Diagram, CursorY, CursorX, '-');
                     }
                     else if (CursorY == BoxBottomRight.Row)
                     {
-                        Diagram[CursorY][CursorX] = '-';
+                        SetRasterCell(Diagram, CursorY, CursorX, '-');
                     }
                 }
             }
         }
 }
 
-void DrawBoxDRE(std::vector<std::string>& Diagram, const ActivityBox& SelectedBox)
+void DrawBoxDRE(DiagramRaster& Diagram, const ActivityBox& SelectedBox)
 {
     FilePosition Cursor;
     uint32_t DRELabelsLength;
@@ -255,16 +289,16 @@ void DrawBoxDRE(std::vector<std::string>& Diagram, const ActivityBox& SelectedBo
     Cursor.Column -= DRELabelsLength;
     for (uint32_t CharIndex = 0u; CharIndex < DRELabelsLength; CharIndex++)
     {
-        Diagram[Cursor.Row][Cursor.Column] = SelectedBox.DRE[CharIndex];
+        SetRasterCell(Diagram, Cursor.Row, Cursor.Column, SelectedBox.DRE[CharIndex]);
         Cursor.Column++;
     }
 }
 
-void DrawBoxLabel(std::vector<std::string>& Diagram, const ActivityBox& SelectedBox)
+void DrawBoxLabel(DiagramRaster& Diagram, const ActivityBox& SelectedBox)
 {
     FilePosition BoxTopLeft;
     FilePosition BoxBottomRight;
-    uint8_t NumLines;
+    uint32_t NumLines;
     uint32_t NumChars;
     FilePosition BoxLabelStartPosition;
     bool WrapFlag;
@@ -289,7 +323,7 @@ void DrawBoxLabel(std::vector<std::string>& Diagram, const ActivityBox& Selected
         Cursor.Row = BoxLabelStartPosition.Row;
         for (CharIndex = 0u; CharIndex < NumChars; CharIndex++)
         {
-            Diagram[Cursor.Row][Cursor.Column] = SelectedBox.Name[CharIndex];
+            SetRasterCell(Diagram, Cursor.Row, Cursor.Column, SelectedBox.Name[CharIndex]);
             Cursor.Column++;
             if (Cursor.Column > (BoxBottomRight.Column - SelectedBox.Padding))
             {
@@ -321,7 +355,7 @@ void DrawBoxLabel(std::vector<std::string>& Diagram, const ActivityBox& Selected
         Cursor.Row = BoxLabelStartPosition.Row;
         for (CharIndex = 0u; CharIndex < NumChars; CharIndex++)
         {
-            Diagram[Cursor.Row][Cursor.Column] = SelectedBox.Name[CharIndex];
+            SetRasterCell(Diagram, Cursor.Row, Cursor.Column, SelectedBox.Name[CharIndex]);
             Cursor.Column++;
         }
     }
@@ -330,158 +364,163 @@ void DrawBoxLabel(std::vector<std::string>& Diagram, const ActivityBox& Selected
     NumChars = SelectedBox.NodeNumber.length();
     for (uint32_t CharIndex = 0u; CharIndex < NumChars; CharIndex++)
     {
-        Diagram[Cursor.Row][Cursor.Column] = SelectedBox.NodeNumber[(NumChars-1u) - CharIndex];
+        SetRasterCell(Diagram, Cursor.Row, Cursor.Column, SelectedBox.NodeNumber[(NumChars-1u) - CharIndex]);
         Cursor.Column--;
     }
-    Diagram[Cursor.Row][Cursor.Column] = 'A';
+    SetRasterCell(Diagram, Cursor.Row, Cursor.Column, 'A');
 }
 
-void DrawBoxStubArrows(std::vector<std::string>& Diagram,
+void DrawBoxStubArrows(DiagramRaster& Diagram,
+    const StubTable& Stubs,
     const ActivityBox& SelectedBox)
 {
-    uint32_t ControlStubCount;
-    uint32_t MechanismStubCount;
-    uint32_t CallStubCount;
-
-    for (const Stub &SelectedStub : SelectedBox.InputStubs)
+    for (uint32_t StubID = SelectedBox.InputStubs.First; StubID < SelectedBox.InputStubs.End; StubID++)
     {
-        const InputStub& SelectedInputStub = std::get<InputStub>(SelectedStub);
-
-        for (uint32_t StubCharIndex = 0u; StubCharIndex < SelectedInputStub.Length; StubCharIndex++)
+        for (uint32_t StubCharIndex = 0u; StubCharIndex < Stubs.Lengths[StubID]; StubCharIndex++)
         {
             if (StubCharIndex == 0u)
             {
-                Diagram[SelectedInputStub.Position.Row][SelectedInputStub.Position.Column - 1u] = '>';
+                SetRasterCell(Diagram, Stubs.Positions[StubID].Row, Stubs.Positions[StubID].Column - 1u, '>');
             }
-            else if (StubCharIndex == (SelectedInputStub.Length-1u))
+            else if (StubCharIndex == (Stubs.Lengths[StubID]-1u))
             {   
-                Diagram[SelectedInputStub.Position.Row][SelectedInputStub.Position.Column - 1u - StubCharIndex] = '+';
+                SetRasterCell(Diagram, Stubs.Positions[StubID].Row, Stubs.Positions[StubID].Column - 1u - StubCharIndex, '+');
             }
             else
             {
-                Diagram[SelectedInputStub.Position.Row][SelectedInputStub.Position.Column - 1u - StubCharIndex] = '-';
+                SetRasterCell(Diagram, Stubs.Positions[StubID].Row, Stubs.Positions[StubID].Column - 1u - StubCharIndex, '-');
             }
         }
     }
-    for (const Stub &SelectedStub : SelectedBox.OutputStubs)
+    for (uint32_t StubID = SelectedBox.OutputStubs.First; StubID < SelectedBox.OutputStubs.End; StubID++)
     {
-        const OutputStub& SelectedOutputStub = std::get<OutputStub>(SelectedStub);
-
-        for (uint32_t StubCharIndex = 0u; StubCharIndex < SelectedOutputStub.Length; StubCharIndex++)
+        for (uint32_t StubCharIndex = 0u; StubCharIndex < Stubs.Lengths[StubID]; StubCharIndex++)
         {
-            if (StubCharIndex == (SelectedOutputStub.Length-1u))
+            if (StubCharIndex == (Stubs.Lengths[StubID]-1u))
             {   
-                Diagram[SelectedOutputStub.Position.Row][SelectedOutputStub.Position.Column + 1u + StubCharIndex] = '+';
+                SetRasterCell(Diagram, Stubs.Positions[StubID].Row, Stubs.Positions[StubID].Column + 1u + StubCharIndex, '+');
             }
             else
             {
-                Diagram[SelectedOutputStub.Position.Row][SelectedOutputStub.Position.Column + 1u + StubCharIndex] = '-';
+                SetRasterCell(Diagram, Stubs.Positions[StubID].Row, Stubs.Positions[StubID].Column + 1u + StubCharIndex, '-');
             }
         }
     }
-    ControlStubCount = SelectedBox.ControlStubs.size();
-    for (uint32_t ControlStubIndex = 0u; ControlStubIndex < ControlStubCount; ControlStubIndex++)
+    for (uint32_t StubID = SelectedBox.ControlStubs.First; StubID < SelectedBox.ControlStubs.End; StubID++)
     {
-        const ControlStub &SelectedControlStub = std::get<ControlStub>(SelectedBox.ControlStubs[ControlStubIndex]);
-        for (uint32_t StubCharIndex = 0u; StubCharIndex < SelectedControlStub.Length; StubCharIndex++)
+        for (uint32_t StubCharIndex = 0u; StubCharIndex < Stubs.Lengths[StubID]; StubCharIndex++)
         {
             if (StubCharIndex == 0u)
             {
-                Diagram[SelectedControlStub.Position.Row - 1u - StubCharIndex][SelectedControlStub.Position.Column] = 'V';
+                SetRasterCell(Diagram, Stubs.Positions[StubID].Row - 1u - StubCharIndex, Stubs.Positions[StubID].Column, 'V');
             }
-            else if (StubCharIndex == (SelectedControlStub.Length-1u))
+            else if (StubCharIndex == (Stubs.Lengths[StubID]-1u))
             {   
-                Diagram[SelectedControlStub.Position.Row - 1u - StubCharIndex][SelectedControlStub.Position.Column] = '+';
+                SetRasterCell(Diagram, Stubs.Positions[StubID].Row - 1u - StubCharIndex, Stubs.Positions[StubID].Column, '+');
             }
             else
             {
-                Diagram[SelectedControlStub.Position.Row - 1u - StubCharIndex][SelectedControlStub.Position.Column] = '|';
+                SetRasterCell(Diagram, Stubs.Positions[StubID].Row - 1u - StubCharIndex, Stubs.Positions[StubID].Column, '|');
             }
         }
     }
-    MechanismStubCount = SelectedBox.MechanismStubs.size();
-    for (uint32_t MechanismStubIndex = 0u; MechanismStubIndex < MechanismStubCount; MechanismStubIndex++)
+    for (uint32_t StubID = SelectedBox.MechanismStubs.First; StubID < SelectedBox.MechanismStubs.End; StubID++)
     {
-        const MechanismStub &SelectedMechanismStub = std::get<MechanismStub>(SelectedBox.MechanismStubs[MechanismStubIndex]);
-
-        for (uint32_t StubCharIndex = 0u; StubCharIndex < SelectedMechanismStub.Length; StubCharIndex++)
+        for (uint32_t StubCharIndex = 0u; StubCharIndex < Stubs.Lengths[StubID]; StubCharIndex++)
         {
             if (StubCharIndex == 0u)
             {
-                Diagram[SelectedMechanismStub.Position.Row + 1u + StubCharIndex][SelectedMechanismStub.Position.Column] = '^';
+                SetRasterCell(Diagram, Stubs.Positions[StubID].Row + 1u + StubCharIndex, Stubs.Positions[StubID].Column, '^');
             }
-            else if (StubCharIndex == (SelectedMechanismStub.Length-1u))
+            else if (StubCharIndex == (Stubs.Lengths[StubID]-1u))
             {   
-                Diagram[SelectedMechanismStub.Position.Row + 1u + StubCharIndex][SelectedMechanismStub.Position.Column] = '+';
+                SetRasterCell(Diagram, Stubs.Positions[StubID].Row + 1u + StubCharIndex, Stubs.Positions[StubID].Column, '+');
             }
             else
             {
-                Diagram[SelectedMechanismStub.Position.Row + 1u + StubCharIndex][SelectedMechanismStub.Position.Column] = '|';
+                SetRasterCell(Diagram, Stubs.Positions[StubID].Row + 1u + StubCharIndex, Stubs.Positions[StubID].Column, '|');
             }
         }
     }
-    CallStubCount = SelectedBox.CallStubs.size();
-    for (uint32_t CallStubIndex = 0u; CallStubIndex < CallStubCount; CallStubIndex++)
+    for (uint32_t StubID = SelectedBox.CallStubs.First; StubID < SelectedBox.CallStubs.End; StubID++)
     {
-        const CallStub &SelectedCallStub = std::get<CallStub>(SelectedBox.CallStubs[CallStubIndex]);
-        for (uint32_t StubCharIndex = 0u; StubCharIndex < SelectedCallStub.Length; StubCharIndex++)
+        for (uint32_t StubCharIndex = 0u; StubCharIndex < Stubs.Lengths[StubID]; StubCharIndex++)
         {
             if (StubCharIndex == 0u)
             {
-                Diagram[SelectedCallStub.Position.Row + 1u + StubCharIndex][SelectedCallStub.Position.Column] = '|';
+                SetRasterCell(Diagram, Stubs.Positions[StubID].Row + 1u + StubCharIndex, Stubs.Positions[StubID].Column, '|');
             }
-            else if (StubCharIndex == (SelectedCallStub.Length-1u))
+            else if (StubCharIndex == (Stubs.Lengths[StubID]-1u))
             {   
-                Diagram[SelectedCallStub.Position.Row + 1u + StubCharIndex][SelectedCallStub.Position.Column] = 'V';
+                SetRasterCell(Diagram, Stubs.Positions[StubID].Row + 1u + StubCharIndex, Stubs.Positions[StubID].Column, 'V');
             }
             else
             {
-                Diagram[SelectedCallStub.Position.Row + 1u + StubCharIndex][SelectedCallStub.Position.Column] = '|';
+                SetRasterCell(Diagram, Stubs.Positions[StubID].Row + 1u + StubCharIndex, Stubs.Positions[StubID].Column, '|');
             }
         }
     }  
 }
 
-bool CheckForCharacters(std::vector<std::string>& Diagram, FilePosition WriteStartPosition, uint32_t CheckLength, uint32_t ColumnOffset)
+bool CheckForCharacters(const DiagramRaster& Diagram, FilePosition WriteStartPosition, uint32_t CheckLength, uint32_t ColumnOffset)
 {
-    FilePosition Cursor;
-    bool HitCharacterFlag;
+    uint32_t FirstColumn;
+    uint32_t LastColumn;
+    uint32_t FirstWordIndex;
+    uint32_t LastWordIndex;
+    const uint64_t* TextRow;
 
-    HitCharacterFlag = false;
-    Cursor.Column = WriteStartPosition.Column + ColumnOffset;
-    Cursor.Row = WriteStartPosition.Row;
-    for (uint32_t CharIndex = 0u; CharIndex < CheckLength; CharIndex++)
+    if (CheckLength == 0u)
+    {
+        return false;
+    }
+    FirstColumn = WriteStartPosition.Column + ColumnOffset;
+    LastColumn = FirstColumn + (CheckLength - 1u);
+#ifndef NDEBUG
+    if ((WriteStartPosition.Row >= Diagram.Height) || (FirstColumn >= Diagram.Width) || (LastColumn >= Diagram.Width))
+    {
+        throw std::out_of_range("Checking outside of the diagram at row " + std::to_string(WriteStartPosition.Row) +
+            ", column " + std::to_string(FirstColumn) + ".");
+    }
+#endif
+    TextRow = Diagram.TextMask.data() + ((size_t)WriteStartPosition.Row * Diagram.TextWordsPerRow);
+    FirstWordIndex = FirstColumn / 64u;
+    LastWordIndex = LastColumn / 64u;
+    for (uint32_t WordIndex = FirstWordIndex; WordIndex <= LastWordIndex; WordIndex++)
     {
-        char CharUnderCursor;
+        uint64_t TextWord;
 
-        CharUnderCursor = Diagram[Cursor.Row][Cursor.Column + CharIndex];
-        if (std::isalnum(CharUnderCursor))
+        TextWord = TextRow[WordIndex];
+        if (WordIndex == FirstWordIndex)
         {
-            HitCharacterFlag = true;
-            break;
+            TextWord &= ~(uint64_t)0u << (FirstColumn % 64u);
+        }
+        if (WordIndex == LastWordIndex)
+        {
+            TextWord &= ~(uint64_t)0u >> (63u - (LastColumn % 64u));
+        }
+        if (TextWord != 0u)
+        {
+            return true;
         }
     }
 
-    return HitCharacterFlag;
+    return false;
 }
 
-void DrawBoxStubLabels(std::vector<std::string>& Diagram, const ActivityBox& SelectedBox)
+void DrawBoxStubLabels(DiagramRaster& Diagram, const StubTable& Stubs, const ActivityBox& SelectedBox)
 {
     uint32_t DiagramHeight;
-    uint32_t ControlStubCount;
-    uint32_t MechanismStubCount;
-    uint32_t CallStubCount;
 
-    DiagramHeight = Diagram.size();
-    for (const Stub &SelectedStub : SelectedBox.InputStubs)
+    DiagramHeight = Diagram.Height;
+    for (uint32_t StubID = SelectedBox.InputStubs.First; StubID < SelectedBox.InputStubs.End; StubID++)
     {
-        const InputStub& SelectedInputStub = std::get<InputStub>(SelectedStub);
         FilePosition WriteStartPosition;
         uint32_t StubNameLength;
 
-        StubNameLength = SelectedInputStub.Name.length();
-        WriteStartPosition.Column = SelectedInputStub.Position.Column - StubNameLength;
-        WriteStartPosition.Row = SelectedInputStub.Position.Row - 1u;
+        StubNameLength = Stubs.Names[StubID].length();
+        WriteStartPosition.Column = Stubs.Positions[StubID].Column - StubNameLength;
+        WriteStartPosition.Row = Stubs.Positions[StubID].Row - 1u;
         for (uint32_t RowIndex = WriteStartPosition.Row; RowIndex > 0u; RowIndex--)
         {
             bool HitCharacterFlag;
@@ -508,24 +547,23 @@ void DrawBoxStubLabels(std::vector<std::string>& Diagram, const ActivityBox& Sel
             Cursor.Row = WriteStartPosition.Row;
             for (uint32_t ColumnOffset = 0u; ColumnOffset < StubNameLength; ColumnOffset++)
             {
-                Diagram[Cursor.Row][Cursor.Column + ColumnOffset] = SelectedInputStub.Name[ColumnOffset];
+                SetRasterCell(Diagram, Cursor.Row, Cursor.Column + ColumnOffset, Stubs.Names[StubID][ColumnOffset]);
             }
         }
     }
-    for (const Stub &SelectedStub : SelectedBox.OutputStubs)
+    for (uint32_t StubID = SelectedBox.OutputStubs.First; StubID < SelectedBox.OutputStubs.End; StubID++)
     {
-        const OutputStub& SelectedOutputStub = std::get<OutputStub>(SelectedStub);
         FilePosition WriteStartPosition;     
         uint32_t StubNameLength;   
 
-        StubNameLength = SelectedOutputStub.Name.length();
-        WriteStartPosition.Column = SelectedOutputStub.Position.Column + 1u;
-        WriteStartPosition.Row = SelectedOutputStub.Position.Row - 1u;
+        StubNameLength = Stubs.Names[StubID].length();
+        WriteStartPosition.Column = Stubs.Positions[StubID].Column + 1u;
+        WriteStartPosition.Row = Stubs.Positions[StubID].Row - 1u;
         for (uint32_t RowIndex = WriteStartPosition.Row; RowIndex > 0u; RowIndex--)
         {
             bool HitCharacterFlag;
 
-            HitCharacterFlag = CheckForCharacters(Diagram, WriteStartPosition, SelectedOutputStub.Name.length(), -2u);
+            HitCharacterFlag = CheckForCharacters(Diagram, WriteStartPosition, Stubs.Names[StubID].length(), -2u);
             if (HitCharacterFlag == true)
             {
                 WriteStartPosition.Row--;
@@ -547,25 +585,23 @@ void DrawBoxStubLabels(std::vector<std::string>& Diagram, const ActivityBox& Sel
             Cursor.Row = WriteStartPosition.Row;
             for (uint32_t ColumnOffset = 0u; ColumnOffset < StubNameLength; ColumnOffset++)
             {
-                Diagram[Cursor.Row][Cursor.Column + ColumnOffset] = SelectedOutputStub.Name[ColumnOffset];
+                SetRasterCell(Diagram, Cursor.Row, Cursor.Column + ColumnOffset, Stubs.Names[StubID][ColumnOffset]);
             }
         }
     }
-    ControlStubCount = SelectedBox.ControlStubs.size();
-    for (uint32_t ControlStubIndex = 0u; ControlStubIndex < ControlStubCount; ControlStubIndex++)
+    for (uint32_t StubID = SelectedBox.ControlStubs.First; StubID < SelectedBox.ControlStubs.End; StubID++)
     {
-        const ControlStub &SelectedControlStub = std::get<ControlStub>(SelectedBox.ControlStubs[ControlStubIndex]);
         FilePosition WriteStartPosition;    
         uint32_t StubNameLength;    
 
-        StubNameLength = SelectedControlStub.Name.length();
-        WriteStartPosition.Column = SelectedControlStub.Position.Column + 1u;
-        WriteStartPosition.Row = SelectedControlStub.Position.Row - 2u;
+        StubNameLength = Stubs.Names[StubID].length();
+        WriteStartPosition.Column = Stubs.Positions[StubID].Column + 1u;
+        WriteStartPosition.Row = Stubs.Positions[StubID].Row - 2u;
         for (uint32_t RowIndex = WriteStartPosition.Row; RowIndex > 0u; RowIndex--)
         {
             bool HitCharacterFlag;
 
-            HitCharacterFlag = CheckForCharacters(Diagram, WriteStartPosition, SelectedControlStub.Name.length(), -2u);
+            HitCharacterFlag = CheckForCharacters(Diagram, WriteStartPosition, Stubs.Names[StubID].length(), -2u);
             if (HitCharacterFlag == true)
             {
                 WriteStartPosition.Row--;
@@ -587,25 +623,23 @@ void DrawBoxStubLabels(std::vector<std::string>& Diagram, const ActivityBox& Sel
             Cursor.Row = WriteStartPosition.Row;
             for (uint32_t ColumnOffset = 0u; ColumnOffset < StubNameLength; ColumnOffset++)
             {
-                Diagram[Cursor.Row][Cursor.Column + ColumnOffset] = SelectedControlStub.Name[ColumnOffset];
+                SetRasterCell(Diagram, Cursor.Row, Cursor.Column + ColumnOffset, Stubs.Names[StubID][ColumnOffset]);
             }
         }
     }
-    MechanismStubCount = SelectedBox.MechanismStubs.size();
-    for (uint32_t MechanismStubIndex = 0u; MechanismStubIndex < MechanismStubCount; MechanismStubIndex++)
+    for (uint32_t StubID = SelectedBox.MechanismStubs.First; StubID < SelectedBox.MechanismStubs.End; StubID++)
     {
-        const MechanismStub &SelectedMechanismStub = std::get<MechanismStub>(SelectedBox.MechanismStubs[MechanismStubIndex]);
         FilePosition WriteStartPosition;  
         uint32_t StubNameLength;      
 
-        StubNameLength = SelectedMechanismStub.Name.length();
-        WriteStartPosition.Column = SelectedMechanismStub.Position.Column + 1u;
-        WriteStartPosition.Row = SelectedMechanismStub.Position.Row + 2u;
+        StubNameLength = Stubs.Names[StubID].length();
+        WriteStartPosition.Column = Stubs.Positions[StubID].Column + 1u;
+        WriteStartPosition.Row = Stubs.Positions[StubID].Row + 2u;
         for (uint32_t RowIndex = WriteStartPosition.Row; RowIndex < DiagramHeight; RowIndex++)
         {
             bool HitCharacterFlag;
 
-            HitCharacterFlag = CheckForCharacters(Diagram, WriteStartPosition, SelectedMechanismStub.Name.length(), -2u);
+            HitCharacterFlag = CheckForCharacters(Diagram, WriteStartPosition, Stubs.Names[StubID].length(), -2u);
             if (HitCharacterFlag == true)
             {
                 WriteStartPosition.Row++;
@@ -615,7 +649,7 @@ void DrawBoxStubLabels(std::vector<std::string>& Diagram, const ActivityBox& Sel
                 break;
             }
         }
-        if (WriteStartPosition.Row == 0u)
+        if (WriteStartPosition.Row >= DiagramHeight)
         {
             throw std::runtime_error("Could not find space to draw the box mechanism label.");            
         }
@@ -627,25 +661,23 @@ void DrawBoxStubLabels(std::vector<std::string>& Diagram, const ActivityBox& Sel
             Cursor.Row = WriteStartPosition.Row;
             for (uint32_t ColumnOffset = 0u; ColumnOffset < StubNameLength; ColumnOffset++)
             {
-                Diagram[Cursor.Row][Cursor.Column + ColumnOffset] = SelectedMechanismStub.Name[ColumnOffset];
+                SetRasterCell(Diagram, Cursor.Row, Cursor.Column + ColumnOffset, Stubs.Names[StubID][ColumnOffset]);
             }
         }
     }
-    CallStubCount = SelectedBox.CallStubs.size();
-    for (uint32_t CallStubIndex = 0u; CallStubIndex < CallStubCount; CallStubIndex++)
+    for (uint32_t StubID = SelectedBox.CallStubs.First; StubID < SelectedBox.CallStubs.End; StubID++)
     {
-        const CallStub &SelectedCallStub = std::get<CallStub>(SelectedBox.CallStubs[CallStubIndex]);
         FilePosition WriteStartPosition;    
         uint32_t StubNameLength;    
 
-        StubNameLength = SelectedCallStub.Name.length();
-        WriteStartPosition.Column = SelectedCallStub.Position.Column + 1u;
-        WriteStartPosition.Row = SelectedCallStub.Position.Row + 2u;
+        StubNameLength = Stubs.Names[StubID].length();
+        WriteStartPosition.Column = Stubs.Positions[StubID].Column + 1u;
+        WriteStartPosition.Row = Stubs.Positions[StubID].Row + 2u;
         for (uint32_t RowIndex = WriteStartPosition.Row; RowIndex < DiagramHeight; RowIndex++)
         {
             bool HitCharacterFlag;
 
-            HitCharacterFlag = CheckForCharacters(Diagram, WriteStartPosition, SelectedCallStub.Name.length(), -2u);
+            HitCharacterFlag = CheckForCharacters(Diagram, WriteStartPosition, Stubs.Names[StubID].length(), -2u);
             if (HitCharacterFlag == true)
             {
                 WriteStartPosition.Row++;
@@ -655,7 +687,7 @@ void DrawBoxStubLabels(std::vector<std::string>& Diagram, const ActivityBox& Sel
                 break;
             }
         }
-        if (WriteStartPosition.Row == 0u)
+        if (WriteStartPosition.Row >= DiagramHeight)
         {
             throw std::runtime_error("Could not find space to draw the box call label.");            
         }
@@ -667,133 +699,104 @@ void DrawBoxStubLabels(std::vector<std::string>& Diagram, const ActivityBox& Sel
             Cursor.Row = WriteStartPosition.Row;
             for (uint32_t ColumnOffset = 0u; ColumnOffset < StubNameLength; ColumnOffset++)
             {
-                Diagram[Cursor.Row][Cursor.Column + ColumnOffset] = SelectedCallStub.Name[ColumnOffset];
+                SetRasterCell(Diagram, Cursor.Row, Cursor.Column + ColumnOffset, Stubs.Names[StubID][ColumnOffset]);
             }
         }
     }
 }
 
-void DrawBoxStubs(std::vector<std::string>& Diagram, const ActivityBox& SelectedBox)
+void DrawBoxStubs(DiagramRaster& Diagram, const StubTable& Stubs, const ActivityBox& SelectedBox)
 {
-    DrawBoxStubArrows(Diagram, SelectedBox);
-    DrawBoxStubLabels(Diagram, SelectedBox);
+    DrawBoxStubArrows(Diagram, Stubs, SelectedBox);
+    DrawBoxStubLabels(Diagram, Stubs, SelectedBox);
 }
 
 
-void DrawBoundaryStubs(std::vector<std::string>& Diagram, const ActivityDiagram& TargetDiagram)
+void DrawBoundaryStubs(DiagramRaster& Diagram, const ActivityDiagram& TargetDiagram)
 {
-    uint32_t NumInputBoundaryStubs;
-    uint32_t NumOutputBoundaryStubs;
-    uint32_t NumMechanismBoundaryStubs;
-    uint32_t NumControlBoundaryStubs;
-
-    NumInputBoundaryStubs = TargetDiagram.InputBoundaryStubs.size();
-    NumOutputBoundaryStubs = TargetDiagram.OutputBoundaryStubs.size();
-    NumMechanismBoundaryStubs = TargetDiagram.MechanismBoundaryStubs.size();
-    NumControlBoundaryStubs = TargetDiagram.ControlBoundaryStubs.size();
-    for (uint32_t StubIndex = 0u; StubIndex < NumInputBoundaryStubs; StubIndex++)
-    {
-        const Stub& IteratedStub = TargetDiagram.InputBoundaryStubs[StubIndex];
-        const InputStub& BoundaryInputStub = std::get<InputStub>(IteratedStub);
+    const StubTable& Stubs = TargetDiagram.Stubs;
 
-        for (uint32_t StubCharIndex = 0u; StubCharIndex < BoundaryInputStub.Length; StubCharIndex++)
+    for (uint32_t StubID = TargetDiagram.InputBoundaryStubs.First; StubID < TargetDiagram.InputBoundaryStubs.End; StubID++)
+    {
+        for (uint32_t StubCharIndex = 0u; StubCharIndex < Stubs.Lengths[StubID]; StubCharIndex++)
         {
-            Diagram[BoundaryInputStub.Position.Row][BoundaryInputStub.Position.Column + StubCharIndex] = '-';
+            SetRasterCell(Diagram, Stubs.Positions[StubID].Row, Stubs.Positions[StubID].Column + StubCharIndex, '-');
         }
     }
-    for (uint32_t StubIndex = 0u; StubIndex < NumControlBoundaryStubs; StubIndex++)
+    for (uint32_t StubID = TargetDiagram.ControlBoundaryStubs.First; StubID < TargetDiagram.ControlBoundaryStubs.End; StubID++)
     {
-        const Stub& IteratedStub = TargetDiagram.ControlBoundaryStubs[StubIndex];
-        const ControlStub& BoundaryControlStub = std::get<ControlStub>(IteratedStub);
-
-        for (uint32_t StubCharIndex = 0u; StubCharIndex < BoundaryControlStub.Length; StubCharIndex++)
+        for (uint32_t StubCharIndex = 0u; StubCharIndex < Stubs.Lengths[StubID]; StubCharIndex++)
         {
-            Diagram[BoundaryControlStub.Position.Row + StubCharIndex][BoundaryControlStub.Position.Column] = '|';
+            SetRasterCell(Diagram, Stubs.Positions[StubID].Row + StubCharIndex, Stubs.Positions[StubID].Column, '|');
         }
     }
-    for (uint32_t StubIndex = 0u; StubIndex < NumOutputBoundaryStubs; StubIndex++)
+    for (uint32_t StubID = TargetDiagram.OutputBoundaryStubs.First; StubID < TargetDiagram.OutputBoundaryStubs.End; StubID++)
     {
-        const Stub& IteratedStub = TargetDiagram.OutputBoundaryStubs[StubIndex];
-        const OutputStub& BoundaryOutputStub = std::get<OutputStub>(IteratedStub);
-        
-        for (uint32_t StubCharIndex = 0u; StubCharIndex < BoundaryOutputStub.Length; StubCharIndex++)
+        for (uint32_t StubCharIndex = 0u; StubCharIndex < Stubs.Lengths[StubID]; StubCharIndex++)
         {
             if (StubCharIndex == 0u || StubCharIndex == 1u)
             {
-                Diagram[BoundaryOutputStub.Position.Row][BoundaryOutputStub.Position.Column - 1u] = '>';
+                SetRasterCell(Diagram, Stubs.Positions[StubID].Row, Stubs.Positions[StubID].Column - 1u, '>');
             }
             else
             {
-                Diagram[BoundaryOutputStub.Position.Row][BoundaryOutputStub.Position.Column - StubCharIndex] = '-';
+                SetRasterCell(Diagram, Stubs.Positions[StubID].Row, Stubs.Positions[StubID].Column - StubCharIndex, '-');
             }
         }
     }
-    for (uint32_t StubIndex = 0u; StubIndex < NumMechanismBoundaryStubs; StubIndex++)
+    for (uint32_t StubID = TargetDiagram.MechanismBoundaryStubs.First; StubID < TargetDiagram.MechanismBoundaryStubs.End; StubID++)
     {
-        const Stub& IteratedStub = TargetDiagram.MechanismBoundaryStubs[StubIndex];
-        const MechanismStub& BoundaryMechanismStub = std::get<MechanismStub>(IteratedStub);
-        
-        Diagram[BoundaryMechanismStub.Position.Row][BoundaryMechanismStub.Position.Column] = 'V';
-        for (uint32_t StubCharIndex = 0u; StubCharIndex < BoundaryMechanismStub.Length; StubCharIndex++)
+        SetRasterCell(Diagram, Stubs.Positions[StubID].Row, Stubs.Positions[StubID].Column, 'V');
+        for (uint32_t StubCharIndex = 0u; StubCharIndex < Stubs.Lengths[StubID]; StubCharIndex++)
         {
-            Diagram[BoundaryMechanismStub.Position.Row - StubCharIndex][BoundaryMechanismStub.Position.Column] = '|';
+            SetRasterCell(Diagram, Stubs.Positions[StubID].Row - StubCharIndex, Stubs.Positions[StubID].Column, '|');
         }
     }
 }
 
-void DrawBoundaryStubLabels(std::vector<std::string>& Diagram, const ActivityDiagram& TargetDiagram)
+void DrawBoundaryStubLabels(DiagramRaster& Diagram, const ActivityDiagram& TargetDiagram)
 {
-    uint32_t InputBoundaryStubCount;
-    uint32_t OutputBoundaryStubCount;
-    uint32_t ControlBoundaryStubCount;
-    uint32_t MechanismBoundaryStubCount;
-
-    InputBoundaryStubCount = TargetDiagram.InputBoundaryStubs.size();
-    OutputBoundaryStubCount = TargetDiagram.OutputBoundaryStubs.size();
-    ControlBoundaryStubCount = TargetDiagram.ControlBoundaryStubs.size();
-    MechanismBoundaryStubCount = TargetDiagram.MechanismBoundaryStubs.size();
-    for (uint32_t InputBoundaryStubIndex = 0u; InputBoundaryStubIndex < InputBoundaryStubCount; InputBoundaryStubIndex++)
+    const StubTable& Stubs = TargetDiagram.Stubs;
+
+    for (uint32_t StubID = TargetDiagram.InputBoundaryStubs.First; StubID < TargetDiagram.InputBoundaryStubs.End; StubID++)
     {
-        const InputStub& InputBoundaryStub = std::get<InputStub>(TargetDiagram.InputBoundaryStubs[InputBoundaryStubIndex]);
         FilePosition Cursor;
         uint32_t NameLength;
 
-        NameLength = InputBoundaryStub.Name.length();
-        Cursor.Column = InputBoundaryStub.Position.Column;
+        NameLength = Stubs.Names[StubID].length();
+        Cursor.Column = Stubs.Positions[StubID].Column;
         Cursor.Column++;
-        Cursor.Row = InputBoundaryStub.Position.Row;
+        Cursor.Row = Stubs.Positions[StubID].Row;
         Cursor.Row--;
         for (uint32_t CharIndex = 0u; CharIndex < NameLength; CharIndex++)
         {
-            Diagram[Cursor.Row][Cursor.Column] = InputBoundaryStub.Name[CharIndex];
+            SetRasterCell(Diagram, Cursor.Row, Cursor.Column, Stubs.Names[StubID][CharIndex]);
             Cursor.Column++;
         }
     }
-    for (uint32_t OutputBoundaryStubIndex = 0u; OutputBoundaryStubIndex < OutputBoundaryStubCount; OutputBoundaryStubIndex++)
+    for (uint32_t StubID = TargetDiagram.OutputBoundaryStubs.First; StubID < TargetDiagram.OutputBoundaryStubs.End; StubID++)
     {
-        const OutputStub& OutputBoundaryStub = std::get<OutputStub>(TargetDiagram.OutputBoundaryStubs[OutputBoundaryStubIndex]);
         FilePosition Cursor;
         uint32_t NameLength;
 
-        NameLength = OutputBoundaryStub.Name.length();
-        Cursor.Column = OutputBoundaryStub.Position.Column - NameLength;
-        Cursor.Row = OutputBoundaryStub.Position.Row;
+        NameLength = Stubs.Names[StubID].length();
+        Cursor.Column = Stubs.Positions[StubID].Column - NameLength;
+        Cursor.Row = Stubs.Positions[StubID].Row;
         Cursor.Row--;
         for (uint32_t CharIndex = 0u; CharIndex < NameLength; CharIndex++)
         {
-            Diagram[Cursor.Row][Cursor.Column] = OutputBoundaryStub.Name[CharIndex];
+            SetRasterCell(Diagram, Cursor.Row, Cursor.Column, Stubs.Names[StubID][CharIndex]);
             Cursor.Column++;
         } 
     }
-    for (uint32_t ControlBoundaryStubIndex = 0u; ControlBoundaryStubIndex < ControlBoundaryStubCount; ControlBoundaryStubIndex++)
+    for (uint32_t StubID = TargetDiagram.ControlBoundaryStubs.First; StubID < TargetDiagram.ControlBoundaryStubs.End; StubID++)
     {
-        const ControlStub& ControlBoundaryStub = std::get<ControlStub>(TargetDiagram.ControlBoundaryStubs[ControlBoundaryStubIndex]);
         uint32_t StubNameLength;
         FilePosition WriteStartPosition;
 
-        StubNameLength = ControlBoundaryStub.Name.length();
-        WriteStartPosition.Column = ControlBoundaryStub.Position.Column + 1u;
-        WriteStartPosition.Row = ControlBoundaryStub.Position.Row + 1u;
+        StubNameLength = Stubs.Names[StubID].length();
+        WriteStartPosition.Column = Stubs.Positions[StubID].Column + 1u;
+        WriteStartPosition.Row = Stubs.Positions[StubID].Row + 1u;
         for (uint32_t RowIndex = WriteStartPosition.Row; RowIndex < TargetDiagram.Height; RowIndex++)
         {
             bool HitCharacterFlag;
@@ -808,7 +811,7 @@ void DrawBoundaryStubLabels(std::vector<std::string>& Diagram, const ActivityDia
                 break;
             }
         }
-        if (WriteStartPosition.Row == (TargetDiagram.Height - 1u))
+        if (WriteStartPosition.Row >= (TargetDiagram.Height - 1u))
         {
             throw std::runtime_error("Could not locate space for boundary control label");
         }
@@ -820,21 +823,20 @@ void DrawBoundaryStubLabels(std::vector<std::string>& Diagram, const ActivityDia
             Cursor.Row = WriteStartPosition.Row;        
             for (uint32_t CharIndex = 0u; CharIndex < StubNameLength; CharIndex++)
             {
-                Diagram[Cursor.Row][Cursor.Column] = ControlBoundaryStub.Name[CharIndex];
+                SetRasterCell(Diagram, Cursor.Row, Cursor.Column, Stubs.Names[StubID][CharIndex]);
                 Cursor.Column++;
             }
         }
     }
-    for (uint32_t MechanismBoundaryStubIndex = 0u; MechanismBoundaryStubIndex < MechanismBoundaryStubCount; MechanismBoundaryStubIndex++)
+    for (uint32_t StubID = TargetDiagram.MechanismBoundaryStubs.First; StubID < TargetDiagram.MechanismBoundaryStubs.End; StubID++)
     {
-        const MechanismStub& MechanismBoundaryStub = std::get<MechanismStub>(TargetDiagram.MechanismBoundaryStubs[MechanismBoundaryStubIndex]);
         uint32_t StubNameLength;
         FilePosition WriteStartPosition;
 
-        StubNameLength = MechanismBoundaryStub.Name.length();
-        WriteStartPosition.Column = MechanismBoundaryStub.Position.Column + 1u;
-        WriteStartPosition.Row = MechanismBoundaryStub.Position.Row - 1u;
-        for (uint32_t RowIndex = WriteStartPosition.Row; RowIndex > 0u; RowIndex--)
+        StubNameLength = Stubs.Names[StubID].length();
+        WriteStartPosition.Column = Stubs.Positions[StubID].Column + 1u;
+        WriteStartPosition.Row = Stubs.Positions[StubID].Row - 1u;
+        for (uint32_t RowIndex = WriteStartPosition.Row; RowIndex < TargetDiagram.Height; RowIndex++)
         {
             bool HitCharacterFlag;
 
@@ -848,7 +850,7 @@ void DrawBoundaryStubLabels(std::vector<std::string>& Diagram, const ActivityDia
                 break;
             }
         }
-        if (WriteStartPosition.Row == 0u)
+        if (WriteStartPosition.Row >= TargetDiagram.Height)
         {
             throw std::runtime_error("Could not locate space for boundary mechanism label");
         }
@@ -860,14 +862,14 @@ void DrawBoundaryStubLabels(std::vector<std::string>& Diagram, const ActivityDia
             Cursor.Row = WriteStartPosition.Row;        
             for (uint32_t CharIndex = 0u; CharIndex < StubNameLength; CharIndex++)
             {
-                Diagram[Cursor.Row][Cursor.Column] = MechanismBoundaryStub.Name[CharIndex];
+                SetRasterCell(Diagram, Cursor.Row, Cursor.Column, Stubs.Names[StubID][CharIndex]);
                 Cursor.Column++;
             }
         }
     }
 }
 
-void DrawBoxes(std::vector<std::string>& Diagram, const ActivityDiagram& TargetDiagram)
+void DrawBoxes(DiagramRaster& Diagram, const ActivityDiagram& TargetDiagram)
 {
     uint32_t ActivityBoxNum;
 
@@ -878,7 +880,7 @@ void DrawBoxes(std::vector<std::string>& Diagram, const ActivityDiagram& TargetD
 
         DrawBoxOutline(Diagram, SelectedBox);
         DrawBoxLabel(Diagram, SelectedBox);
-        DrawBoxStubs(Diagram, SelectedBox);
+        DrawBoxStubs(Diagram, TargetDiagram.Stubs, SelectedBox);
         if (SelectedBox.DRE != "")
         {
             DrawBoxDRE(Diagram, SelectedBox);
@@ -886,7 +888,7 @@ void DrawBoxes(std::vector<std::string>& Diagram, const ActivityDiagram& TargetD
     }
 }
 
-void DrawNodeNumberSection(std::vector<std::string>& Diagram, 
+void DrawNodeNumberSection(DiagramRaster& Diagram, 
     const ActivityDiagram& TargetDiagram)
 {
     const NodeNumberSection& NumberBarSection = std::get<NodeNumberSection>(TargetDiagram.Frame.BottomBar.NodeNumberSection);
@@ -895,35 +897,35 @@ void DrawNodeNumberSection(std::vector<std::string>& Diagram,
 
     for (uint32_t Row = NumberBarSection.TopLeft.Row; Row < NumberBarSection.TopLeft.Row + NumberBarSection.Height; Row++)
     {
-        Diagram[Row][NumberBarSection.TopLeft.Column + NumberBarSection.Width] = '|'; 
+        SetRasterCell(Diagram, Row, NumberBarSection.TopLeft.Column + NumberBarSection.Width, '|'); 
     }
-    Diagram[NumberBarSection.TopLeft.Row][NumberBarSection.TopLeft.Column] = '+';
-    Diagram[NumberBarSection.TopLeft.Row][NumberBarSection.TopLeft.Column + NumberBarSection.Width] = '+';
-    Diagram[NumberBarSection.TopLeft.Row + (NumberBarSection.Height-1u)][0u] = '+';
-    Diagram[NumberBarSection.TopLeft.Row + (NumberBarSection.Height-1u)][NumberBarSection.TopLeft.Column + NumberBarSection.Width] = '+';
+    SetRasterCell(Diagram, NumberBarSection.TopLeft.Row, NumberBarSection.TopLeft.Column, '+');
+    SetRasterCell(Diagram, NumberBarSection.TopLeft.Row, NumberBarSection.TopLeft.Column + NumberBarSection.Width, '+');
+    SetRasterCell(Diagram, NumberBarSection.TopLeft.Row + (NumberBarSection.Height-1u), 0u, '+');
+    SetRasterCell(Diagram, NumberBarSection.TopLeft.Row + (NumberBarSection.Height-1u), NumberBarSection.TopLeft.Column + NumberBarSection.Width, '+');
     Cursor.Row = NumberBarSection.TopLeft.Row;
     Cursor.Column = NumberBarSection.TopLeft.Column;
     Cursor.Row += 1u;
     Cursor.Column += 1u;
-    Diagram[Cursor.Row][Cursor.Column] = 'N';
+    SetRasterCell(Diagram, Cursor.Row, Cursor.Column, 'N');
     Cursor.Column++;
-    Diagram[Cursor.Row][Cursor.Column] = 'o';
+    SetRasterCell(Diagram, Cursor.Row, Cursor.Column, 'o');
     Cursor.Column++;
-    Diagram[Cursor.Row][Cursor.Column] = 'd';
+    SetRasterCell(Diagram, Cursor.Row, Cursor.Column, 'd');
     Cursor.Column++;
-    Diagram[Cursor.Row][Cursor.Column] = 'e';
+    SetRasterCell(Diagram, Cursor.Row, Cursor.Column, 'e');
     Cursor.Column++;
-    Diagram[Cursor.Row][Cursor.Column] = ':';
+    SetRasterCell(Diagram, Cursor.Row, Cursor.Column, ':');
     Cursor.Column++;
     NumChars = NumberBarSection.Content.length();
     for (uint32_t CharIndex = 0u; CharIndex < NumChars; CharIndex++)
     {
-        Diagram[Cursor.Row][Cursor.Column] = NumberBarSection.Content[CharIndex];
+        SetRasterCell(Diagram, Cursor.Row, Cursor.Column, NumberBarSection.Content[CharIndex]);
         Cursor.Column++;
     }
 }
 
-void DrawTitleSection(std::vector<std::string>& Diagram, const ActivityDiagram& TargetDiagram)
+void DrawTitleSection(DiagramRaster& Diagram, const ActivityDiagram& TargetDiagram)
 {
     const TitleSection& TitleBarSection = std::get<TitleSection>(TargetDiagram.Frame.BottomBar.TitleSection);
     FilePosition Cursor;
@@ -931,38 +933,38 @@ void DrawTitleSection(std::vector<std::string>& Diagram, const ActivityDiagram&
 
     for (uint32_t Row = TitleBarSection.TopLeft.Row; Row < TitleBarSection.TopLeft.Row + TitleBarSection.Height; Row++)
     {
-        Diagram[Row][TitleBarSection.TopLeft.Column + TitleBarSection.Width] = '|'; 
+        SetRasterCell(Diagram, Row, TitleBarSection.TopLeft.Column + TitleBarSection.Width, '|'); 
     }
-    Diagram[TitleBarSection.TopLeft.Row][TitleBarSection.TopLeft.Column] = '+';
-    Diagram[TitleBarSection.TopLeft.Row][TitleBarSection.TopLeft.Column + TitleBarSection.Width] = '+';
-    Diagram[TitleBarSection.TopLeft.Row + (TitleBarSection.Height-1u)][0u] = '+';
-    Diagram[TitleBarSection.TopLeft.Row + (TitleBarSection.Height-1u)][TitleBarSection.TopLeft.Column + TitleBarSection.Width] = '+';
+    SetRasterCell(Diagram, TitleBarSection.TopLeft.Row, TitleBarSection.TopLeft.Column, '+');
+    SetRasterCell(Diagram, TitleBarSection.TopLeft.Row, TitleBarSection.TopLeft.Column + TitleBarSection.Width, '+');
+    SetRasterCell(Diagram, TitleBarSection.TopLeft.Row + (TitleBarSection.Height-1u), 0u, '+');
+    SetRasterCell(Diagram, TitleBarSection.TopLeft.Row + (TitleBarSection.Height-1u), TitleBarSection.TopLeft.Column + TitleBarSection.Width, '+');
     Cursor.Row = TitleBarSection.TopLeft.Row;
     Cursor.Column = TitleBarSection.TopLeft.Column;
     Cursor.Row += 1u;
     Cursor.Column += 1u;
-    Diagram[Cursor.Row][Cursor.Column] = 'T';
+    SetRasterCell(Diagram, Cursor.Row, Cursor.Column, 'T');
     Cursor.Column++;
-    Diagram[Cursor.Row][Cursor.Column] = 'i';
+    SetRasterCell(Diagram, Cursor.Row, Cursor.Column, 'i');
     Cursor.Column++;
-    Diagram[Cursor.Row][Cursor.Column] = 't';
+    SetRasterCell(Diagram, Cursor.Row, Cursor.Column, 't');
     Cursor.Column++;
-    Diagram[Cursor.Row][Cursor.Column] = 'l';
+    SetRasterCell(Diagram, Cursor.Row, Cursor.Column, 'l');
     Cursor.Column++;
-    Diagram[Cursor.Row][Cursor.Column] = 'e';
+    SetRasterCell(Diagram, Cursor.Row, Cursor.Column, 'e');
     Cursor.Column++;
-    Diagram[Cursor.Row][Cursor.Column] = ':';
+    SetRasterCell(Diagram, Cursor.Row, Cursor.Column, ':');
     Cursor.Column++;
     NumChars = TitleBarSection.Content.length();
     for (uint32_t CharIndex = 0u; CharIndex < NumChars; CharIndex++)
     {
-        Diagram[Cursor.Row][Cursor.Column] = TitleBarSection.Content[CharIndex];
+        SetRasterCell(Diagram, Cursor.Row, Cursor.Column, TitleBarSection.Content[CharIndex]);
         Cursor.Column++;
     }
 }
 
 
-void DrawCNumberSection(std::vector<std::string>& Diagram,
+void DrawCNumberSection(DiagramRaster& Diagram,
     const ActivityDiagram& TargetDiagram)
 {
     const CNumberSection& CNumSection = std::get<CNumberSection>(TargetDiagram.Frame.BottomBar.CNumberSection);
@@ -971,87 +973,97 @@ void DrawCNumberSection(std::vector<std::string>& Diagram,
 
     for (uint32_t Row = CNumSection.TopLeft.Row; Row < CNumSection.TopLeft.Row + CNumSection.Height; Row++)
     {
-        Diagram[Row][CNumSection.TopLeft.Column + CNumSection.Width] = '|'; 
+        SetRasterCell(Diagram, Row, CNumSection.TopLeft.Column + CNumSection.Width, '|'); 
     }
-    Diagram[CNumSection.TopLeft.Row][CNumSection.TopLeft.Column] = '+';
-    Diagram[CNumSection.TopLeft.Row][CNumSection.TopLeft.Column + CNumSection.Width] = '+';
-    Diagram[CNumSection.TopLeft.Row + (CNumSection.Height-1u)][0u] = '+';
-    Diagram[CNumSection.TopLeft.Row + (CNumSection.Height-1u)][CNumSection.TopLeft.Column + CNumSection.Width] = '+';
+    SetRasterCell(Diagram, CNumSection.TopLeft.Row, CNumSection.TopLeft.Column, '+');
+    SetRasterCell(Diagram, CNumSection.TopLeft.Row, CNumSection.TopLeft.Column + CNumSection.Width, '+');
+    SetRasterCell(Diagram, CNumSection.TopLeft.Row + (CNumSection.Height-1u), 0u, '+');
+    SetRasterCell(Diagram, CNumSection.TopLeft.Row + (CNumSection.Height-1u), CNumSection.TopLeft.Column + CNumSection.Width, '+');
     Cursor.Row = CNumSection.TopLeft.Row;
     Cursor.Column = CNumSection.TopLeft.Column;
     Cursor.Row += 1u;
     Cursor.Column += 1u;
-    Diagram[Cursor.Row][Cursor.Column] = 'C';
+    SetRasterCell(Diagram, Cursor.Row, Cursor.Column, 'C');
     Cursor.Column++;
-    Diagram[Cursor.Row][Cursor.Column] = 'N';
+    SetRasterCell(Diagram, Cursor.Row, Cursor.Column, 'N');
     Cursor.Column++;
-    Diagram[Cursor.Row][Cursor.Column] = 'u';
+    SetRasterCell(Diagram, Cursor.Row, Cursor.Column, 'u');
     Cursor.Column++;
-    Diagram[Cursor.Row][Cursor.Column] = 'm';
+    SetRasterCell(Diagram, Cursor.Row, Cursor.Column, 'm');
     Cursor.Column++;
-    Diagram[Cursor.Row][Cursor.Column] = 'b';
+    SetRasterCell(Diagram, Cursor.Row, Cursor.Column, 'b');
     Cursor.Column++;
-    Diagram[Cursor.Row][Cursor.Column] = 'e';
+    SetRasterCell(Diagram, Cursor.Row, Cursor.Column, 'e');
     Cursor.Column++;
-    Diagram[Cursor.Row][Cursor.Column] = 'r';
+    SetRasterCell(Diagram, Cursor.Row, Cursor.Column, 'r');
     Cursor.Column++;
-    Diagram[Cursor.Row][Cursor.Column] = ':';
+    SetRasterCell(Diagram, Cursor.Row, Cursor.Column, ':');
     Cursor.Column++;
     NumChars = CNumSection.Content.length();
     for (uint32_t CharIndex = 0u; CharIndex < NumChars; CharIndex++)
     {
-        Diagram[Cursor.Row][Cursor.Column] = CNumSection.Content[CharIndex];
+        SetRasterCell(Diagram, Cursor.Row, Cursor.Column, CNumSection.Content[CharIndex]);
         Cursor.Column++;
     }
 }
 
-void DrawBottomBar(std::vector<std::string>& Diagram, const ActivityDiagram& TargetDiagram)
+void DrawBottomBar(DiagramRaster& Diagram, const ActivityDiagram& TargetDiagram)
 {
     for (uint32_t Column = TargetDiagram.Frame.BottomBar.TopLeft.Column; Column < TargetDiagram.Width-1u; Column++)
     {
-        Diagram[TargetDiagram.Frame.BottomBar.TopLeft.Row][Column] = '-';
+        SetRasterCell(Diagram, TargetDiagram.Frame.BottomBar.TopLeft.Row, Column, '-');
     }
     DrawNodeNumberSection(Diagram, TargetDiagram);
     DrawTitleSection(Diagram, TargetDiagram);
     DrawCNumberSection(Diagram, TargetDiagram);
 }
 
-void DrawFrame(std::vector<std::string>& Diagram, const ActivityDiagram& TargetDiagram)
+void DrawFrame(DiagramRaster& Diagram, const ActivityDiagram& TargetDiagram)
 {
     for (uint32_t Column = 0u; Column < TargetDiagram.Width; Column++)
     {
-        Diagram[0u][Column] = '-';
-        Diagram[TargetDiagram.Height - 1][Column] = '-';
+        SetRasterCell(Diagram, 0u, Column, '-');
+        SetRasterCell(Diagram, TargetDiagram.Height - 1, Column, '-');
     }
     for (uint32_t Row = 0u; Row < TargetDiagram.Height; Row++)
     {
-        Diagram[Row][0u] = '|';
-        Diagram[Row][TargetDiagram.Width - 1u] = '|';
+        SetRasterCell(Diagram, Row, 0u, '|');
+        SetRasterCell(Diagram, Row, TargetDiagram.Width - 1u, '|');
     }
-    Diagram[0u][0u] = '+';
-    Diagram[0u][TargetDiagram.Width - 1u] = '+';
-    Diagram[TargetDiagram.Height - 1u][TargetDiagram.Width - 1u] = '+';
-    Diagram[TargetDiagram.Height - 1u][0u] = '+';
+    SetRasterCell(Diagram, 0u, 0u, '+');
+    SetRasterCell(Diagram, 0u, TargetDiagram.Width - 1u, '+');
+    SetRasterCell(Diagram, TargetDiagram.Height - 1u, TargetDiagram.Width - 1u, '+');
+    SetRasterCell(Diagram, TargetDiagram.Height - 1u, 0u, '+');
     DrawBottomBar(Diagram, TargetDiagram);
 }
 
-std::vector<std::string> DrawDiagram(const ActivityDiagram &TargetDiagram, Avoid::Router *ConnectedRouter)
+DiagramRaster DrawRouteLayer(const ActivityDiagram &TargetDiagram, Avoid::Router *ConnectedRouter)
 {
-    std::vector<std::string> Diagram;
-    uint32_t ActivityBoxNum;
-    std::string BlankDiagramRow(TargetDiagram.Width, ' ');
-    uint32_t NumBoxes;
+    DiagramRaster Diagram;
+    LineMask Lines;
 
-    NumBoxes = TargetDiagram.Boxes.size();
-    for (uint32_t RowNum = 0u; RowNum < TargetDiagram.Height; RowNum++)
-    {
-        Diagram.push_back(BlankDiagramRow);
-    }
-    DrawRoutes(ConnectedRouter, Diagram, TargetDiagram);
+    Diagram = ConstructRaster(TargetDiagram.Width, TargetDiagram.Height);
+    Lines = ConstructLineMask(TargetDiagram.Width, TargetDiagram.Height);
+    DrawRoutes(ConnectedRouter, Lines, TargetDiagram);
+    ResolveLineGlyphs(Lines, Diagram);
+
+    return Diagram;
+}
+
+void DrawDiagramElements(DiagramRaster& Diagram, const ActivityDiagram &TargetDiagram)
+{
     DrawBoxes(Diagram, TargetDiagram);
     DrawBoundaryStubs(Diagram, TargetDiagram);
     DrawBoundaryStubLabels(Diagram, TargetDiagram);
     DrawFrame(Diagram, TargetDiagram);
+}
+
+DiagramRaster DrawDiagram(const ActivityDiagram &TargetDiagram, Avoid::Router *ConnectedRouter)
+{
+    DiagramRaster Diagram;
+
+    Diagram = DrawRouteLayer(TargetDiagram, ConnectedRouter);
+    DrawDiagramElements(Diagram, TargetDiagram);
 
     return Diagram;
 }
@@ -4,7 +4,49 @@
 namespace IDEF
 {
 
-std::vector<std::string> DrawDiagram(const ActivityDiagram &TargetDiagram, 
+struct DiagramRaster
+{
+    uint32_t Width;
+    uint32_t Height;
+    uint32_t Stride;
+    std::string Cells;
+    uint32_t TextWordsPerRow;
+    std::vector<uint64_t> TextMask;
+};
+
+DiagramRaster ConstructRaster(uint32_t Width, uint32_t Height);
+
+void SetRasterCell(DiagramRaster& Raster, uint32_t Row, uint32_t Column, char Glyph);
+
+enum LineDirection
+{
+    NorthLine = 1u,
+    EastLine = 2u,
+    SouthLine = 4u,
+    WestLine = 8u
+};
+
+struct LineMask
+{
+    uint32_t Width;
+    uint32_t Height;
+    std::vector<uint8_t> Cells;
+};
+
+LineMask ConstructLineMask(uint32_t Width, uint32_t Height);
+
+void DrawRoute(Avoid::ConnRef* ConnRef, LineMask& Lines, const ActivityDiagram& TargetDiagram);
+
+void DrawRoutes(Avoid::Router* ConnectedRouter, LineMask& Lines, const ActivityDiagram& TargetDiagram);
+
+void ResolveLineGlyphs(const LineMask& Lines, DiagramRaster& Diagram);
+
+DiagramRaster DrawRouteLayer(const ActivityDiagram &TargetDiagram, 
+	Avoid::Router *ConnectedRouter);
+
+void DrawDiagramElements(DiagramRaster& Diagram, const ActivityDiagram &TargetDiagram);
+
+DiagramRaster DrawDiagram(const ActivityDiagram &TargetDiagram, 
 	Avoid::Router *ConnectedRouter);
 
 }
@@ -0,0 +1,230 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <variant>
+#include <libavoid/libavoid.h>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <pugixml.hpp>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <tuple>
+#include <vector>
+
+#include "Loading.h"
+#include "Placing.h"
+#include "Layouting.h"
+#include "Drawing.h"
+#include "Plotting.h"
+#include "Editing.h"
+
+namespace IDEF
+{
+
+typedef std::tuple<double, double, double, double> ConnectorKey;
+
+void OpenEditSession(EditSession& Session, const PlotJob& Job)
+{
+    Session.Job = Job;
+    Session.Diagram = ActivityDiagram();
+    Session.Router = new Avoid::Router(Avoid::OrthogonalRouting);
+    Session.Shapes.clear();
+    Session.Obstacles.clear();
+    Session.Connectors.clear();
+    Session.RouteLines = LineMask();
+    Session.RouteLayer = DiagramRaster();
+}
+
+// Boxes are matched by their index in the diagram, a box whose rectangle changed is moved
+// rather than removed and added so libavoid only reroutes the connectors near it.
+void UpdateSessionShapes(EditSession& Session, const std::vector<Avoid::Rectangle>& NewObstacles,
+    EditStatistics& Statistics)
+{
+    uint32_t NumOldShapes;
+    uint32_t NumNewShapes;
+    uint32_t NumKeptShapes;
+
+    NumOldShapes = Session.Shapes.size();
+    NumNewShapes = NewObstacles.size();
+    NumKeptShapes = std::min(NumOldShapes, NumNewShapes);
+    for (uint32_t ShapeIndex = 0u; ShapeIndex < NumKeptShapes; ShapeIndex++)
+    {
+        if (Session.Obstacles[ShapeIndex].ps != NewObstacles[ShapeIndex].ps)
+        {
+            Session.Router->moveShape(Session.Shapes[ShapeIndex], NewObstacles[ShapeIndex]);
+            Statistics.MovedShapes++;
+        }
+    }
+    for (uint32_t ShapeIndex = NumKeptShapes; ShapeIndex < NumOldShapes; ShapeIndex++)
+    {
+        Session.Router->deleteShape(Session.Shapes[ShapeIndex]);
+        Statistics.DeletedShapes++;
+    }
+    Session.Shapes.resize(NumKeptShapes);
+    for (uint32_t ShapeIndex = NumKeptShapes; ShapeIndex < NumNewShapes; ShapeIndex++)
+    {
+        Avoid::Rectangle AddedRectangle = NewObstacles[ShapeIndex];
+
+        Session.Shapes.push_back(new Avoid::ShapeRef(Session.Router, AddedRectangle));
+        Statistics.AddedShapes++;
+    }
+    Session.Obstacles = NewObstacles;
+}
+
+// Connectors are matched by the points of their two ends, so a connector whose stubs did
+// not move keeps its ConnRef and its current route.
+void UpdateSessionConnectors(EditSession& Session, const std::vector<StubConnection>& Connections,
+    std::vector<uint32_t>& AddedConnectorIndices, EditStatistics& Statistics)
+{
+    std::map<ConnectorKey, std::vector<uint32_t>> OldConnectorIndices;
+    std::vector<SessionConnector> NewConnectors;
+    std::vector<bool> ConnectorKept;
+    uint32_t NumOldConnectors;
+
+    NumOldConnectors = Session.Connectors.size();
+    for (uint32_t ConnectorIndex = 0u; ConnectorIndex < NumOldConnectors; ConnectorIndex++)
+    {
+        const SessionConnector& OldConnector = Session.Connectors[ConnectorIndex];
+        ConnectorKey Key(OldConnector.SourcePoint.x, OldConnector.SourcePoint.y,
+            OldConnector.TargetPoint.x, OldConnector.TargetPoint.y);
+
+        OldConnectorIndices[Key].push_back(ConnectorIndex);
+    }
+    ConnectorKept.resize(NumOldConnectors, false);
+    for (const StubConnection& Connection : Connections)
+    {
+        SessionConnector NewConnector;
+        std::map<ConnectorKey, std::vector<uint32_t>>::iterator FoundConnectors;
+
+        NewConnector.SourcePoint = Connection.SourceEnd.position();
+        NewConnector.TargetPoint = Connection.TargetEnd.position();
+        FoundConnectors = OldConnectorIndices.find(ConnectorKey(NewConnector.SourcePoint.x, NewConnector.SourcePoint.y,
+            NewConnector.TargetPoint.x, NewConnector.TargetPoint.y));
+        if ((FoundConnectors != OldConnectorIndices.end()) && (FoundConnectors->second.empty() == false))
+        {
+            uint32_t OldConnectorIndex;
+
+            OldConnectorIndex = FoundConnectors->second.back();
+            FoundConnectors->second.pop_back();
+            ConnectorKept[OldConnectorIndex] = true;
+            NewConnector = Session.Connectors[OldConnectorIndex];
+        }
+        else
+        {
+            NewConnector.Connector = new Avoid::ConnRef(Session.Router, Connection.SourceEnd, Connection.TargetEnd);
+            AddedConnectorIndices.push_back(NewConnectors.size());
+            Statistics.AddedConnectors++;
+        }
+        NewConnectors.push_back(NewConnector);
+    }
+    for (uint32_t ConnectorIndex = 0u; ConnectorIndex < NumOldConnectors; ConnectorIndex++)
+    {
+        if (ConnectorKept[ConnectorIndex] == false)
+        {
+            Session.Router->deleteConnector(Session.Connectors[ConnectorIndex].Connector);
+            Statistics.DeletedConnectors++;
+        }
+    }
+    Session.Connectors = NewConnectors;
+}
+
+// Only the connectors libavoid added are marked on the retained line mask. Marks cannot be
+// taken back out of the mask, so once a connector is deleted or an existing route changes
+// the whole mask is redrawn from the router.
+void RedrawSessionRoutes(EditSession& Session, const std::vector<uint32_t>& AddedConnectorIndices,
+    bool LayerResized, EditStatistics& Statistics)
+{
+    std::vector<bool> ConnectorAdded;
+    uint32_t NumConnectors;
+    bool RedrawLayer;
+
+    NumConnectors = Session.Connectors.size();
+    ConnectorAdded.resize(NumConnectors, false);
+    for (uint32_t ConnectorIndex : AddedConnectorIndices)
+    {
+        ConnectorAdded[ConnectorIndex] = true;
+    }
+    RedrawLayer = (LayerResized == true) || (Statistics.DeletedConnectors > 0u);
+    for (uint32_t ConnectorIndex = 0u; ConnectorIndex < NumConnectors; ConnectorIndex++)
+    {
+        SessionConnector& Connector = Session.Connectors[ConnectorIndex];
+        const Avoid::PolyLine& Route = Connector.Connector->displayRoute();
+
+        if ((ConnectorAdded[ConnectorIndex] == false) && (Route.ps != Connector.DrawnRoute))
+        {
+            Statistics.ReroutedConnectors++;
+            RedrawLayer = true;
+        }
+        Connector.DrawnRoute = Route.ps;
+    }
+    if (RedrawLayer == true)
+    {
+        Session.RouteLines = ConstructLineMask(Session.Diagram.Width, Session.Diagram.Height);
+        Session.RouteLayer = ConstructRaster(Session.Diagram.Width, Session.Diagram.Height);
+        DrawRoutes(Session.Router, Session.RouteLines, Session.Diagram);
+        Statistics.RouteLayerRedrawn = true;
+    }
+    else
+    {
+        for (uint32_t ConnectorIndex : AddedConnectorIndices)
+        {
+            DrawRoute(Session.Connectors[ConnectorIndex].Connector, Session.RouteLines, Session.Diagram);
+        }
+    }
+    ResolveLineGlyphs(Session.RouteLines, Session.RouteLayer);
+}
+
+// Lays out the edited diagram and applies only its differences from the previous update to
+// the retained router. The first update of a session draws the same diagram as a plot.
+DiagramRaster UpdateEditSession(EditSession& Session, const ActivityDiagram& EditedDiagram,
+    EditStatistics& Statistics)
+{
+    ActivityDiagram NewDiagram;
+    std::vector<Avoid::ConnEnd> StubConnEnds;
+    std::vector<Avoid::Rectangle> NewObstacles;
+    std::vector<StubConnection> Connections;
+    std::vector<uint32_t> AddedConnectorIndices;
+    DiagramRaster Diagram;
+    bool LayerResized;
+    const PlotJob& Job = Session.Job;
+
+    Statistics = EditStatistics();
+    NewDiagram = EditedDiagram;
+    IndexStubReferences(NewDiagram);
+    LayoutActivityDiagram(NewDiagram, Job.DiagramWidth, Job.DiagramHeight, Job.BoxWidth, Job.BoxHeight, Job.BoxXGap, Job.BoxYGap, Job.Layout);
+    PlaceObstacles(NewDiagram, NewObstacles);
+    PlaceBoxStubConnEnds(NewDiagram, StubConnEnds);
+    PlaceBoundaryStubConnEnds(NewDiagram, StubConnEnds);
+    Connections = ResolveStubConnections(NewDiagram, StubConnEnds);
+    LayerResized = (Session.RouteLayer.Cells.empty() == true) || (NewDiagram.Width != Session.Diagram.Width) ||
+        (NewDiagram.Height != Session.Diagram.Height);
+    Session.Diagram = NewDiagram;
+
+    UpdateSessionShapes(Session, NewObstacles, Statistics);
+    UpdateSessionConnectors(Session, Connections, AddedConnectorIndices, Statistics);
+    Session.Router->processTransaction();
+    RedrawSessionRoutes(Session, AddedConnectorIndices, LayerResized, Statistics);
+
+    Diagram = Session.RouteLayer;
+    DrawDiagramElements(Diagram, Session.Diagram);
+
+    return Diagram;
+}
+
+void CloseEditSession(EditSession& Session)
+{
+    delete Session.Router;
+    Session.Router = nullptr;
+    Session.Shapes.clear();
+    Session.Obstacles.clear();
+    Session.Connectors.clear();
+    Session.RouteLines = LineMask();
+    Session.RouteLayer = DiagramRaster();
+}
+
+}
@@ -0,0 +1,45 @@
+#ifndef EDITING_H
+#define EDITING_H
+
+namespace IDEF
+{
+
+struct SessionConnector
+{
+    Avoid::Point SourcePoint;
+    Avoid::Point TargetPoint;
+    Avoid::ConnRef* Connector;
+    std::vector<Avoid::Point> DrawnRoute;
+};
+
+struct EditSession
+{
+    PlotJob Job;
+    ActivityDiagram Diagram;
+    Avoid::Router* Router;
+    std::vector<Avoid::ShapeRef*> Shapes;
+    std::vector<Avoid::Rectangle> Obstacles;
+    std::vector<SessionConnector> Connectors;
+    LineMask RouteLines;
+    DiagramRaster RouteLayer;
+};
+
+struct EditStatistics
+{
+    uint32_t MovedShapes;
+    uint32_t AddedShapes;
+    uint32_t DeletedShapes;
+    uint32_t AddedConnectors;
+    uint32_t DeletedConnectors;
+    uint32_t ReroutedConnectors;
+    bool RouteLayerRedrawn;
+};
+
+void OpenEditSession(EditSession& Session, const PlotJob& Job);
+DiagramRaster UpdateEditSession(EditSession& Session, const ActivityDiagram& EditedDiagram,
+    EditStatistics& Statistics);
+void CloseEditSession(EditSession& Session);
+
+}
+
+#endif
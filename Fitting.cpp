@@ -0,0 +1,453 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <variant>
+#include <libavoid/libavoid.h>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <pugixml.hpp>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <thread>
+#include <vector>
+
+#include "Loading.h"
+#include "Layouting.h"
+#include "Placing.h"
+#include "Drawing.h"
+#include "Plotting.h"
+#include "Fitting.h"
+
+namespace IDEF
+{
+
+// The fit check cannot see where routes go or how far a crowded label is moved, so a candidate
+// that passes it may still fail to draw. Only this many of the best are routed before giving up.
+const uint32_t FitRenderAttempts = 3u;
+
+FitMeasures MeasureFitDiagram(const ActivityDiagram& LoadedDiagram)
+{
+    const StubTable& Stubs = LoadedDiagram.Stubs;
+    const StubRange* BoundaryRanges[4u] = {&LoadedDiagram.InputBoundaryStubs, &LoadedDiagram.OutputBoundaryStubs,
+        &LoadedDiagram.ControlBoundaryStubs, &LoadedDiagram.MechanismBoundaryStubs};
+    FitMeasures Measures;
+    uint32_t NodeNumberLength;
+    uint32_t TitleLength;
+    uint32_t CNumberLength;
+
+    Measures = FitMeasures();
+    Measures.NumBoxes = LoadedDiagram.Boxes.size();
+    Measures.BoxPadding = 3u;
+    for (const ActivityBox& SelectedBox : LoadedDiagram.Boxes)
+    {
+        const StubRange* BoxRanges[5u] = {&SelectedBox.InputStubs, &SelectedBox.OutputStubs, &SelectedBox.ControlStubs,
+            &SelectedBox.MechanismStubs, &SelectedBox.CallStubs};
+
+        Measures.BoxPadding = SelectedBox.Padding;
+        Measures.LongestBoxName = std::max<uint32_t>(Measures.LongestBoxName, SelectedBox.Name.length());
+        for (const StubRange* Range : BoxRanges)
+        {
+            for (uint32_t StubID = Range->First; StubID < Range->End; StubID++)
+            {
+                Interface Kind = Stubs.Kinds[StubID];
+
+                Measures.MostBoxStubs[Kind] = std::max(Measures.MostBoxStubs[Kind], Range->End - Range->First);
+                Measures.LongestBoxStubName[Kind] = std::max<uint32_t>(Measures.LongestBoxStubName[Kind], Stubs.Names[StubID].length());
+            }
+        }
+    }
+    for (const StubRange* Range : BoundaryRanges)
+    {
+        for (uint32_t StubID = Range->First; StubID < Range->End; StubID++)
+        {
+            Interface Kind = Stubs.Kinds[StubID];
+
+            Measures.NumBoundaryStubs[Kind]++;
+            Measures.LongestBoundaryStubName[Kind] = std::max<uint32_t>(Measures.LongestBoundaryStubName[Kind], Stubs.Names[StubID].length());
+        }
+    }
+    NodeNumberLength = std::get<NodeNumberSection>(LoadedDiagram.Frame.BottomBar.NodeNumberSection).Content.length();
+    TitleLength = std::get<TitleSection>(LoadedDiagram.Frame.BottomBar.TitleSection).Content.length();
+    CNumberLength = std::get<CNumberSection>(LoadedDiagram.Frame.BottomBar.CNumberSection).Content.length();
+    Measures.MinFrameWidth = std::max({4u * (NodeNumberLength + 8u), (2u * (TitleLength + 8u)) + 4u, 4u * (CNumberLength + 11u)});
+
+    return Measures;
+}
+
+// Box sizes are taken for names wrapped over one to three lines, each box tall enough for its
+// name and for its input and output stubs two rows apart. The gaps leave room for the longest
+// stubs between neighbouring boxes, and the margins around the boxes for the boundary stubs and
+// the labels of the outermost box stubs. Each is tried tight and half again as large. Boundary
+// stubs without an inner stub are spaced by the box section's size, so the frame also reaches past
+// the last of them.
+std::vector<PlotJob> ListFitCandidates(const ActivityDiagram& LoadedDiagram, const PlotJob& Job)
+{
+    FitMeasures Measures;
+    std::vector<PlotJob> Candidates;
+    std::vector<std::pair<uint32_t, uint32_t>> BoxSizes;
+    uint32_t NumBoxes;
+    uint32_t MostSideStubs;
+    uint32_t MostLowerStubs;
+    uint32_t MinBoxWidth;
+    uint32_t XGapBase;
+    uint32_t YGapBase;
+    uint32_t SideMargin;
+    uint32_t VerticalMargin;
+    uint32_t MostEdgeColumns;
+    uint32_t MostEdgeRows;
+    uint32_t LongestEdgeColumnName;
+
+    Measures = MeasureFitDiagram(LoadedDiagram);
+    NumBoxes = std::max(1u, Measures.NumBoxes);
+    MostSideStubs = std::max(Measures.MostBoxStubs[InputInterface], Measures.MostBoxStubs[OutputInterface]);
+    MostLowerStubs = std::max(Measures.MostBoxStubs[MechanismInterface], Measures.MostBoxStubs[CallInterface]);
+    MinBoxWidth = std::max({(2u * Measures.BoxPadding) + 8u, 2u * (Measures.MostBoxStubs[ControlInterface] + 1u),
+        4u * (MostLowerStubs + 1u)});
+    for (uint32_t NumLines = 1u; NumLines <= 3u; NumLines++)
+    {
+        uint32_t BoxWidth;
+        uint32_t BoxHeight;
+
+        BoxWidth = std::max(MinBoxWidth, (2u * Measures.BoxPadding) + ((Measures.LongestBoxName + NumLines - 1u) / NumLines));
+        BoxWidth += BoxWidth % 2u;
+        BoxHeight = std::max(NumLines + 3u, 2u * (MostSideStubs + 1u));
+        BoxHeight += BoxHeight % 2u;
+        for (uint32_t ExtraHeight = 0u; ExtraHeight <= 2u; ExtraHeight += 2u)
+        {
+            std::pair<uint32_t, uint32_t> BoxSize(BoxWidth, BoxHeight + ExtraHeight);
+
+            if (std::find(BoxSizes.begin(), BoxSizes.end(), BoxSize) == BoxSizes.end())
+            {
+                BoxSizes.push_back(BoxSize);
+            }
+        }
+    }
+    XGapBase = Measures.MostBoxStubs[InputInterface] + Measures.MostBoxStubs[OutputInterface] + 8u;
+    YGapBase = Measures.MostBoxStubs[ControlInterface] + MostLowerStubs + 8u;
+    SideMargin = std::max({Measures.LongestBoundaryStubName[InputInterface] + Measures.NumBoundaryStubs[InputInterface],
+        Measures.LongestBoundaryStubName[OutputInterface] + Measures.NumBoundaryStubs[OutputInterface],
+        Measures.LongestBoxStubName[InputInterface] + Measures.MostBoxStubs[InputInterface],
+        Measures.LongestBoxStubName[OutputInterface] + Measures.MostBoxStubs[OutputInterface]}) + 8u;
+    VerticalMargin = std::max(Measures.NumBoundaryStubs[ControlInterface] + Measures.MostBoxStubs[ControlInterface] + 10u,
+        Measures.NumBoundaryStubs[MechanismInterface] + MostLowerStubs + 13u);
+    MostEdgeColumns = std::max(Measures.NumBoundaryStubs[ControlInterface], Measures.NumBoundaryStubs[MechanismInterface]) + 1u;
+    MostEdgeRows = std::max(Measures.NumBoundaryStubs[InputInterface], Measures.NumBoundaryStubs[OutputInterface]) + 1u;
+    LongestEdgeColumnName = std::max(Measures.LongestBoundaryStubName[ControlInterface], Measures.LongestBoundaryStubName[MechanismInterface]);
+    for (const std::pair<uint32_t, uint32_t>& BoxSize : BoxSizes)
+    {
+        for (uint32_t XGap : {XGapBase, XGapBase + (XGapBase / 2u), 2u * XGapBase})
+        {
+            for (uint32_t YGap : {YGapBase, YGapBase + (YGapBase / 2u)})
+            {
+                for (uint32_t WidthScale = 2u; WidthScale <= 3u; WidthScale++)
+                {
+                    for (uint32_t HeightScale = 2u; HeightScale <= 3u; HeightScale++)
+                    {
+                        PlotJob Candidate;
+                        uint32_t SectionWidth;
+                        uint32_t SectionHeight;
+
+                        MeasureBoxSection(NumBoxes, Job.Layout, BoxSize.first, BoxSize.second, XGap, YGap, SectionWidth, SectionHeight);
+                        Candidate = Job;
+                        Candidate.AutoFit = false;
+                        Candidate.BoxWidth = BoxSize.first;
+                        Candidate.BoxHeight = BoxSize.second;
+                        Candidate.BoxXGap = XGap;
+                        Candidate.BoxYGap = YGap;
+                        Candidate.DiagramWidth = std::max({Measures.MinFrameWidth, SectionWidth + (SideMargin * WidthScale) + 2u,
+                            (MostEdgeColumns * (SectionWidth / (NumBoxes + 1u))) + LongestEdgeColumnName + 4u});
+                        Candidate.DiagramHeight = std::max(SectionHeight + (VerticalMargin * HeightScale) + 2u,
+                            (MostEdgeRows * (SectionHeight / (NumBoxes + 1u))) + 8u);
+                        Candidates.push_back(Candidate);
+                    }
+                }
+            }
+        }
+    }
+
+    return Candidates;
+}
+
+// True when the cells of Row from FirstColumn to LastColumn are inside the frame and above the
+// bottom bar. Positions that wrapped below zero are far past the right edge, so they fail too.
+bool CheckFrameSpan(const ActivityDiagram& Diagram, int64_t Row, int64_t FirstColumn, int64_t LastColumn)
+{
+    return (Row >= 1) && (Row < (int64_t)Diagram.Frame.BottomBar.TopLeft.Row) &&
+        (FirstColumn >= 1) && (FirstColumn <= LastColumn) && (LastColumn < ((int64_t)Diagram.Width - 1));
+}
+
+void CheckBoxStubsFit(const ActivityDiagram& Diagram, const ActivityBox& SelectedBox, uint32_t BoxIndex)
+{
+    const StubTable& Stubs = Diagram.Stubs;
+    std::string BoxName;
+
+    BoxName = "Box " + std::to_string(BoxIndex + 1u);
+    for (uint32_t StubID = SelectedBox.InputStubs.First; StubID < SelectedBox.InputStubs.End; StubID++)
+    {
+        int64_t Row = Stubs.Positions[StubID].Row;
+        int64_t Column = Stubs.Positions[StubID].Column;
+        int64_t Reach = std::max<int64_t>(Stubs.Lengths[StubID], Stubs.Names[StubID].length() + 2u);
+
+        if ((StubID > SelectedBox.InputStubs.First) && (Stubs.Positions[StubID].Row <= Stubs.Positions[StubID - 1u].Row))
+        {
+            throw std::runtime_error(BoxName + " is not tall enough for its input stubs.");
+        }
+        if (CheckFrameSpan(Diagram, Row - 1, Column - Reach, Column - 1) == false)
+        {
+            throw std::runtime_error(BoxName + "'s input stubs do not fit inside the frame.");
+        }
+    }
+    for (uint32_t StubID = SelectedBox.OutputStubs.First; StubID < SelectedBox.OutputStubs.End; StubID++)
+    {
+        int64_t Row = Stubs.Positions[StubID].Row;
+        int64_t Column = Stubs.Positions[StubID].Column;
+        int64_t Reach = std::max<int64_t>(Stubs.Lengths[StubID], Stubs.Names[StubID].length());
+
+        if ((StubID > SelectedBox.OutputStubs.First) && (Stubs.Positions[StubID].Row <= Stubs.Positions[StubID - 1u].Row))
+        {
+            throw std::runtime_error(BoxName + " is not tall enough for its output stubs.");
+        }
+        if (CheckFrameSpan(Diagram, Row - 1, Column + 1, Column + Reach) == false)
+        {
+            throw std::runtime_error(BoxName + "'s output stubs do not fit inside the frame.");
+        }
+    }
+    for (uint32_t StubID = SelectedBox.ControlStubs.First; StubID < SelectedBox.ControlStubs.End; StubID++)
+    {
+        int64_t Row = Stubs.Positions[StubID].Row;
+        int64_t Column = Stubs.Positions[StubID].Column;
+
+        if ((StubID > SelectedBox.ControlStubs.First) && (Stubs.Positions[StubID].Column <= Stubs.Positions[StubID - 1u].Column))
+        {
+            throw std::runtime_error(BoxName + " is not wide enough for its control stubs.");
+        }
+        if (CheckFrameSpan(Diagram, Row - Stubs.Lengths[StubID], Column, Column + Stubs.Names[StubID].length()) == false)
+        {
+            throw std::runtime_error(BoxName + "'s control stubs do not fit inside the frame.");
+        }
+    }
+    for (uint32_t StubID = SelectedBox.MechanismStubs.First; StubID < SelectedBox.MechanismStubs.End; StubID++)
+    {
+        int64_t Row = Stubs.Positions[StubID].Row;
+        int64_t Column = Stubs.Positions[StubID].Column;
+
+        if ((StubID > SelectedBox.MechanismStubs.First) && (Stubs.Positions[StubID].Column <= Stubs.Positions[StubID - 1u].Column))
+        {
+            throw std::runtime_error(BoxName + " is not wide enough for its mechanism stubs.");
+        }
+        if (CheckFrameSpan(Diagram, Row + Stubs.Lengths[StubID], Column, Column + Stubs.Names[StubID].length()) == false)
+        {
+            throw std::runtime_error(BoxName + "'s mechanism stubs do not fit inside the frame.");
+        }
+    }
+    for (uint32_t StubID = SelectedBox.CallStubs.First; StubID < SelectedBox.CallStubs.End; StubID++)
+    {
+        int64_t Row = Stubs.Positions[StubID].Row;
+        int64_t Column = Stubs.Positions[StubID].Column;
+
+        if ((StubID > SelectedBox.CallStubs.First) && (Stubs.Positions[StubID].Column <= Stubs.Positions[StubID - 1u].Column))
+        {
+            throw std::runtime_error(BoxName + " is not wide enough for its call stubs.");
+        }
+        if (CheckFrameSpan(Diagram, Row + Stubs.Lengths[StubID], Column, Column + Stubs.Names[StubID].length()) == false)
+        {
+            throw std::runtime_error(BoxName + "'s call stubs do not fit inside the frame.");
+        }
+    }
+}
+
+void CheckBoundaryStubsFit(const ActivityDiagram& Diagram)
+{
+    const StubTable& Stubs = Diagram.Stubs;
+
+    for (uint32_t StubID = Diagram.InputBoundaryStubs.First; StubID < Diagram.InputBoundaryStubs.End; StubID++)
+    {
+        int64_t Row = Stubs.Positions[StubID].Row;
+        int64_t Column = Stubs.Positions[StubID].Column;
+        int64_t Reach = std::max<int64_t>(Stubs.Lengths[StubID], Stubs.Names[StubID].length() + 1u);
+
+        if ((CheckFrameSpan(Diagram, Row - 1, Column + 1, Column + Reach) == false) ||
+            (CheckFrameSpan(Diagram, Row, Column + 1, Column + Reach) == false))
+        {
+            throw std::runtime_error("Input boundary stub '" + std::string(Stubs.Names[StubID]) + "' does not fit inside the frame.");
+        }
+    }
+    for (uint32_t StubID = Diagram.OutputBoundaryStubs.First; StubID < Diagram.OutputBoundaryStubs.End; StubID++)
+    {
+        int64_t Row = Stubs.Positions[StubID].Row;
+        int64_t Column = Stubs.Positions[StubID].Column;
+        int64_t Reach = std::max<int64_t>(Stubs.Lengths[StubID], Stubs.Names[StubID].length());
+
+        if ((CheckFrameSpan(Diagram, Row - 1, Column - Reach, Column - 1) == false) ||
+            (CheckFrameSpan(Diagram, Row, Column - Reach, Column - 1) == false))
+        {
+            throw std::runtime_error("Output boundary stub '" + std::string(Stubs.Names[StubID]) + "' does not fit inside the frame.");
+        }
+    }
+    for (uint32_t StubID = Diagram.ControlBoundaryStubs.First; StubID < Diagram.ControlBoundaryStubs.End; StubID++)
+    {
+        int64_t Row = Stubs.Positions[StubID].Row;
+        int64_t Column = Stubs.Positions[StubID].Column;
+
+        if (CheckFrameSpan(Diagram, Row + Stubs.Lengths[StubID], Column - 1, Column + Stubs.Names[StubID].length()) == false)
+        {
+            throw std::runtime_error("Control boundary stub '" + std::string(Stubs.Names[StubID]) + "' does not fit inside the frame.");
+        }
+    }
+    for (uint32_t StubID = Diagram.MechanismBoundaryStubs.First; StubID < Diagram.MechanismBoundaryStubs.End; StubID++)
+    {
+        int64_t Row = Stubs.Positions[StubID].Row;
+        int64_t Column = Stubs.Positions[StubID].Column;
+
+        if (CheckFrameSpan(Diagram, Row - Stubs.Lengths[StubID], Column - 1, Column + Stubs.Names[StubID].length()) == false)
+        {
+            throw std::runtime_error("Mechanism boundary stub '" + std::string(Stubs.Names[StubID]) + "' does not fit inside the frame.");
+        }
+    }
+}
+
+// Checks the laid out boxes, stubs, their labels where they are first placed and the bottom bar's
+// text against the frame without drawing anything, so it is safe in builds without the raster's
+// bounds checks. Throws describing the first part that does not fit.
+void CheckLayoutFits(const ActivityDiagram& LayedOutDiagram)
+{
+    const NodeNumberSection& NumberBarSection = std::get<NodeNumberSection>(LayedOutDiagram.Frame.BottomBar.NodeNumberSection);
+    const TitleSection& TitleBarSection = std::get<TitleSection>(LayedOutDiagram.Frame.BottomBar.TitleSection);
+    const CNumberSection& CNumSection = std::get<CNumberSection>(LayedOutDiagram.Frame.BottomBar.CNumberSection);
+    uint32_t NumBoxes;
+
+    if ((NumberBarSection.Width <= (NumberBarSection.Content.length() + 6u)) ||
+        (TitleBarSection.Width <= (TitleBarSection.Content.length() + 7u)) ||
+        (CNumSection.Width <= (CNumSection.Content.length() + 9u)))
+    {
+        throw std::runtime_error("The frame is too narrow for its bottom bar.");
+    }
+    NumBoxes = LayedOutDiagram.Boxes.size();
+    for (uint32_t BoxIndex = 0u; BoxIndex < NumBoxes; BoxIndex++)
+    {
+        const ActivityBox& SelectedBox = LayedOutDiagram.Boxes[BoxIndex];
+        int64_t Left = (int64_t)SelectedBox.Center.Column - (SelectedBox.Width / 2u);
+        int64_t Right = (int64_t)SelectedBox.Center.Column + (SelectedBox.Width / 2u);
+        int64_t Top = (int64_t)SelectedBox.Center.Row - (SelectedBox.Height / 2u);
+        int64_t Bottom = (int64_t)SelectedBox.Center.Row + (SelectedBox.Height / 2u);
+        int64_t TextWidth = (int64_t)SelectedBox.Width - (2u * SelectedBox.Padding);
+
+        if ((CheckFrameSpan(LayedOutDiagram, Top, Left, Right) == false) ||
+            (CheckFrameSpan(LayedOutDiagram, Bottom + 1, Left, Right) == false))
+        {
+            throw std::runtime_error("Box " + std::to_string(BoxIndex + 1u) + " does not fit inside the frame.");
+        }
+        if ((TextWidth < 1) || ((((int64_t)SelectedBox.Name.length() + TextWidth - 1) / TextWidth) > ((Bottom - Top) - 2)))
+        {
+            throw std::runtime_error("Box " + std::to_string(BoxIndex + 1u) + " is too small for its name.");
+        }
+        CheckBoxStubsFit(LayedOutDiagram, SelectedBox, BoxIndex);
+    }
+    CheckBoundaryStubsFit(LayedOutDiagram);
+}
+
+// Lays out every candidate on the worker threads and returns the indices of those that fit,
+// smallest diagram first. Throws with the problem of the largest candidate when none fits.
+std::vector<uint32_t> RankFitCandidates(const ActivityDiagram& LoadedDiagram, const std::vector<PlotJob>& Candidates,
+    uint32_t NumThreads)
+{
+    std::vector<PlotResult> Results;
+    std::vector<uint32_t> Ranking;
+    uint32_t NumCandidates;
+    uint32_t LargestIndex;
+
+    Results = RunPlotTasks(Candidates.size(), NumThreads, [&LoadedDiagram, &Candidates](uint32_t CandidateIndex)
+    {
+        const PlotJob& Candidate = Candidates[CandidateIndex];
+        ActivityDiagram CandidateDiagram;
+
+        CandidateDiagram = LoadedDiagram;
+        LayoutActivityDiagram(CandidateDiagram, Candidate.DiagramWidth, Candidate.DiagramHeight,
+            Candidate.BoxWidth, Candidate.BoxHeight, Candidate.BoxXGap, Candidate.BoxYGap, Candidate.Layout);
+        CheckLayoutFits(CandidateDiagram);
+    });
+    NumCandidates = Candidates.size();
+    LargestIndex = 0u;
+    for (uint32_t CandidateIndex = 0u; CandidateIndex < NumCandidates; CandidateIndex++)
+    {
+        const PlotJob& Candidate = Candidates[CandidateIndex];
+        const PlotJob& Largest = Candidates[LargestIndex];
+
+        if (Results[CandidateIndex].Succeeded == true)
+        {
+            Ranking.push_back(CandidateIndex);
+        }
+        if (((uint64_t)Candidate.DiagramWidth * Candidate.DiagramHeight) > ((uint64_t)Largest.DiagramWidth * Largest.DiagramHeight))
+        {
+            LargestIndex = CandidateIndex;
+        }
+    }
+    if (Ranking.empty() == true)
+    {
+        throw std::runtime_error("No candidate size fits the diagram, the largest failed with: " +
+            ((NumCandidates == 0u) ? std::string("no candidates") : Results[LargestIndex].ErrorMessage));
+    }
+    std::stable_sort(Ranking.begin(), Ranking.end(), [&Candidates](uint32_t FirstIndex, uint32_t SecondIndex)
+    {
+        const PlotJob& First = Candidates[FirstIndex];
+        const PlotJob& Second = Candidates[SecondIndex];
+
+        return ((uint64_t)First.DiagramWidth * First.DiagramHeight) < ((uint64_t)Second.DiagramWidth * Second.DiagramHeight);
+    });
+
+    return Ranking;
+}
+
+// Picks the sizes of the job from the diagram itself, only the best fitting candidates are
+// routed. Returns the job that was written, LoadedDiagram is left laid out with its sizes.
+PlotJob PlotFittedActivityDiagram(ActivityDiagram& LoadedDiagram, const PlotJob& Job, uint32_t NumThreads)
+{
+    std::vector<PlotJob> Candidates;
+    std::vector<uint32_t> Ranking;
+    std::string RenderProblem;
+    uint32_t NumAttempts;
+
+    Candidates = ListFitCandidates(LoadedDiagram, Job);
+    Ranking = RankFitCandidates(LoadedDiagram, Candidates, NumThreads);
+    NumAttempts = std::min<uint32_t>(Ranking.size(), FitRenderAttempts);
+    for (uint32_t RankIndex = 0u; RankIndex < NumAttempts; RankIndex++)
+    {
+        const PlotJob& Candidate = Candidates[Ranking[RankIndex]];
+        ActivityDiagram CandidateDiagram;
+        DiagramRaster Diagram;
+
+        CandidateDiagram = LoadedDiagram;
+        try
+        {
+            Diagram = RenderActivityDiagram(CandidateDiagram, Candidate);
+        }
+        catch (const std::exception& Exception)
+        {
+            RenderProblem = Exception.what();
+            continue;
+        }
+        WriteDiagram(Diagram, Candidate.OutputFilePath);
+        LoadedDiagram = std::move(CandidateDiagram);
+        return Candidate;
+    }
+
+    throw std::runtime_error("None of the " + std::to_string(NumAttempts) + " best fitting sizes could be drawn: " + RenderProblem);
+}
+
+PlotJob PlotFittedActivityDiagramFile(const PlotJob& Job, uint32_t NumThreads)
+{
+    ActivityDiagram LoadedDiagram;
+
+    LoadedDiagram = LoadActivityDiagram(Job.InputFilePath, NumThreads);
+
+    return PlotFittedActivityDiagram(LoadedDiagram, Job, NumThreads);
+}
+
+}
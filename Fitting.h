@@ -0,0 +1,30 @@
+#ifndef FITTING_H
+#define FITTING_H
+
+namespace IDEF
+{
+
+// The counts and label lengths a diagram's sizes are chosen from, indexed by Interface.
+struct FitMeasures
+{
+    uint32_t NumBoxes;
+    uint32_t BoxPadding;
+    uint32_t LongestBoxName;
+    uint32_t MostBoxStubs[5u];
+    uint32_t LongestBoxStubName[5u];
+    uint32_t NumBoundaryStubs[5u];
+    uint32_t LongestBoundaryStubName[5u];
+    uint32_t MinFrameWidth;
+};
+
+FitMeasures MeasureFitDiagram(const ActivityDiagram& LoadedDiagram);
+std::vector<PlotJob> ListFitCandidates(const ActivityDiagram& LoadedDiagram, const PlotJob& Job);
+void CheckLayoutFits(const ActivityDiagram& LayedOutDiagram);
+std::vector<uint32_t> RankFitCandidates(const ActivityDiagram& LoadedDiagram, const std::vector<PlotJob>& Candidates,
+    uint32_t NumThreads);
+PlotJob PlotFittedActivityDiagram(ActivityDiagram& LoadedDiagram, const PlotJob& Job, uint32_t NumThreads);
+PlotJob PlotFittedActivityDiagramFile(const PlotJob& Job, uint32_t NumThreads);
+
+}
+
+#endif
@@ -0,0 +1,112 @@
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <pugixml.hpp>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Generating.h"
+
+namespace IDEF
+{
+
+void AppendNamedStub(pugi::xml_node& ParentNode, const char* InterfaceName, const std::string& StubName)
+{
+    pugi::xml_node StubNode;
+
+    StubNode = ParentNode.append_child(InterfaceName);
+    StubNode.append_attribute("Name").set_value(StubName.c_str());
+}
+
+// Builds a diagram whose activities each carry ArrowsPerInterface outputs. Every output is
+// read by up to FanOut of the activities after it, first as an input and then as a control
+// once the reader's inputs are full. Boundary inputs feed the first activity, boundary
+// mechanisms are shared by every activity and boundary outputs read the last activities.
+std::string GenerateDiagramXML(const SyntheticDiagramSpec& Spec)
+{
+    pugi::xml_document DiagramXMLDocument;
+    pugi::xml_node DiagramNode;
+    std::vector<pugi::xml_node> ActivityNodes;
+    std::vector<uint32_t> NumInputs;
+    std::vector<uint32_t> NumControls;
+    std::mt19937 Generator(Spec.Seed);
+    std::ostringstream DiagramXMLStream;
+
+    if (Spec.NumActivities == 0u)
+    {
+        throw std::runtime_error("A synthetic diagram needs at least one activity.");
+    }
+    DiagramNode = DiagramXMLDocument.append_child("Diagram");
+    DiagramNode.append_attribute("Number").set_value("A0");
+    DiagramNode.append_attribute("Title").set_value("Synthetic diagram");
+    DiagramNode.append_attribute("CNumber").set_value("SYN001");
+    for (uint32_t StubIndex = 0u; StubIndex < Spec.NumBoundaryStubs; StubIndex++)
+    {
+        AppendNamedStub(DiagramNode, "Input", "Boundary input " + std::to_string(StubIndex + 1u));
+        AppendNamedStub(DiagramNode, "Control", "Boundary control " + std::to_string(StubIndex + 1u));
+        AppendNamedStub(DiagramNode, "Mechanism", "Boundary mechanism " + std::to_string(StubIndex + 1u));
+        AppendNamedStub(DiagramNode, "Output", "Flow " + std::to_string(Spec.NumActivities) + "." +
+            std::to_string((StubIndex % std::max(Spec.ArrowsPerInterface, 1u)) + 1u));
+    }
+    for (uint32_t ActivityIndex = 0u; ActivityIndex < Spec.NumActivities; ActivityIndex++)
+    {
+        pugi::xml_node ActivityNode;
+
+        ActivityNode = DiagramNode.append_child("Activity");
+        ActivityNode.append_attribute("Number").set_value(ActivityIndex + 1u);
+        ActivityNode.append_attribute("Name").set_value(("Synthetic activity " + std::to_string(ActivityIndex + 1u)).c_str());
+        ActivityNodes.push_back(ActivityNode);
+    }
+    NumInputs.resize(Spec.NumActivities, 0u);
+    NumControls.resize(Spec.NumActivities, 0u);
+    if (Spec.NumBoundaryStubs > 0u)
+    {
+        for (uint32_t StubIndex = 0u; StubIndex < std::min(Spec.NumBoundaryStubs, Spec.ArrowsPerInterface); StubIndex++)
+        {
+            AppendNamedStub(ActivityNodes[0u], "Input", "Boundary input " + std::to_string(StubIndex + 1u));
+            AppendNamedStub(ActivityNodes[0u], "Control", "Boundary control " + std::to_string(StubIndex + 1u));
+            NumInputs[0u]++;
+            NumControls[0u]++;
+        }
+    }
+    for (uint32_t ActivityIndex = 0u; ActivityIndex < Spec.NumActivities; ActivityIndex++)
+    {
+        uint32_t NumFollowing;
+
+        NumFollowing = Spec.NumActivities - (ActivityIndex + 1u);
+        for (uint32_t OutputIndex = 0u; OutputIndex < Spec.ArrowsPerInterface; OutputIndex++)
+        {
+            std::string FlowName;
+
+            FlowName = "Flow " + std::to_string(ActivityIndex + 1u) + "." + std::to_string(OutputIndex + 1u);
+            AppendNamedStub(ActivityNodes[ActivityIndex], "Output", FlowName);
+            for (uint32_t ReaderIndex = 0u; (ReaderIndex < Spec.FanOut) && (NumFollowing > 0u); ReaderIndex++)
+            {
+                uint32_t ConsumerIndex;
+
+                ConsumerIndex = ActivityIndex + 1u + (Generator() % NumFollowing);
+                if (NumInputs[ConsumerIndex] < Spec.ArrowsPerInterface)
+                {
+                    AppendNamedStub(ActivityNodes[ConsumerIndex], "Input", FlowName);
+                    NumInputs[ConsumerIndex]++;
+                }
+                else if (NumControls[ConsumerIndex] < Spec.ArrowsPerInterface)
+                {
+                    AppendNamedStub(ActivityNodes[ConsumerIndex], "Control", FlowName);
+                    NumControls[ConsumerIndex]++;
+                }
+            }
+        }
+        for (uint32_t MechanismIndex = 0u; (MechanismIndex < Spec.ArrowsPerInterface) && (MechanismIndex < Spec.NumBoundaryStubs); MechanismIndex++)
+        {
+            AppendNamedStub(ActivityNodes[ActivityIndex], "Mechanism", "Boundary mechanism " + std::to_string(MechanismIndex + 1u));
+        }
+    }
+    DiagramXMLDocument.save(DiagramXMLStream, "\t");
+
+    return DiagramXMLStream.str();
+}
+
+}
@@ -0,0 +1,20 @@
+#ifndef GENERATING_H
+#define GENERATING_H
+
+namespace IDEF
+{
+
+struct SyntheticDiagramSpec
+{
+    uint32_t NumActivities;
+    uint32_t ArrowsPerInterface;
+    uint32_t FanOut;
+    uint32_t NumBoundaryStubs;
+    uint32_t Seed;
+};
+
+std::string GenerateDiagramXML(const SyntheticDiagramSpec& Spec);
+
+}
+
+#endif
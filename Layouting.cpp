@@ -5,10 +5,15 @@
 #include <iostream>
 #include <variant>
 #include <libavoid/libavoid.h>
+#include <libavoid/vpsc.h>
 #include <map>
+#include <memory>
+#include <memory_resource>
 #include <pugixml.hpp>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 #include "Loading.h"
@@ -19,6 +24,22 @@
 namespace IDEF
 {
 
+// Down and up sweep pairs of the barycentric ordering in OrderBoxes.
+const uint32_t OrderingSweeps = 4u;
+
+// Narrows a layout coordinate back to a row or column, throwing when it fell below zero or reached
+// Limit, the diagram's height or width, instead of letting it wrap around.
+uint32_t CheckCoordinate(LayoutCoordinate Value, uint32_t Limit, const std::string& What)
+{
+    if ((Value < 0) || (Value >= (LayoutCoordinate)Limit))
+    {
+        throw std::runtime_error(What + " is at " + std::to_string(Value) + ", outside the diagram's 0 to " +
+            std::to_string(Limit) + ".");
+    }
+
+    return (uint32_t)Value;
+}
+
 void LayoutFrame(ActivityDiagram &Diagram)
 {
     NodeNumberSection& TargetNodeNumberSection = std::get<NodeNumberSection>(Diagram.Frame.BottomBar.NodeNumberSection);
@@ -26,6 +47,11 @@ void LayoutFrame(ActivityDiagram &Diagram)
     CNumberSection& TargetCNumberSection = std::get<CNumberSection>(Diagram.Frame.BottomBar.CNumberSection);
     
     Diagram.Frame.BottomBar.Height = 3u;
+    if ((Diagram.Width < 4u) || (Diagram.Height <= Diagram.Frame.BottomBar.Height))
+    {
+        throw std::runtime_error("A " + std::to_string(Diagram.Width) + " by " + std::to_string(Diagram.Height) +
+            " diagram is too small for its frame.");
+    }
     Diagram.Frame.BottomBar.TopLeft.Row = Diagram.Height - Diagram.Frame.BottomBar.Height;
     Diagram.Frame.BottomBar.TopLeft.Column = 0u;
     TargetNodeNumberSection.Width = Diagram.Width / 4u;
@@ -36,41 +62,100 @@ void LayoutFrame(ActivityDiagram &Diagram)
     TargetTitleSection.TopLeft.Row = Diagram.Frame.BottomBar.TopLeft.Row;
     TargetTitleSection.TopLeft.Column = TargetNodeNumberSection.TopLeft.Column + TargetNodeNumberSection.Width;
     TargetTitleSection.Height = Diagram.Frame.BottomBar.Height;
-    TargetCNumberSection.Width = Diagram.Width / 4u;
     TargetCNumberSection.TopLeft.Row = Diagram.Frame.BottomBar.TopLeft.Row;
     TargetCNumberSection.TopLeft.Column = TargetTitleSection.TopLeft.Column + TargetTitleSection.Width;
+    TargetCNumberSection.Width = (Diagram.Width - 1u) - TargetCNumberSection.TopLeft.Column;
     TargetCNumberSection.Height = Diagram.Frame.BottomBar.Height;
 }
 
+// The diagonal gives every box its own row and column. The grid is as close to square as whole
+// columns allow, rounding the columns up so it is never taller than it is wide.
+void CountBoxCells(uint32_t NumBoxes, BoxLayout Layout, uint32_t& NumColumns, uint32_t& NumRows)
+{
+    if (Layout == GridBoxLayout)
+    {
+        NumColumns = 1u;
+        while ((NumColumns * NumColumns) < NumBoxes)
+        {
+            NumColumns++;
+        }
+        NumRows = std::max(1u, (NumBoxes + NumColumns - 1u) / NumColumns);
+    }
+    else
+    {
+        NumColumns = NumBoxes;
+        NumRows = NumBoxes;
+    }
+}
+
+void MeasureBoxSection(uint32_t NumBoxes,
+    BoxLayout Layout,
+    uint32_t BoxWidth,
+    uint32_t BoxHeight,
+    uint32_t BoxXGap,
+    uint32_t BoxYGap,
+    uint32_t& BoxSectionWidth,
+    uint32_t& BoxSectionHeight)
+{
+    uint32_t NumColumns;
+    uint32_t NumRows;
+    LayoutCoordinate SectionWidth;
+    LayoutCoordinate SectionHeight;
+
+    CountBoxCells(NumBoxes, Layout, NumColumns, NumRows);
+    SectionWidth = ((LayoutCoordinate)NumColumns * BoxWidth) + (((LayoutCoordinate)NumColumns - 1) * BoxXGap);
+    SectionHeight = ((LayoutCoordinate)NumRows * BoxHeight) + (((LayoutCoordinate)NumRows - 1) * BoxYGap);
+    if ((SectionWidth > UINT32_MAX) || (SectionHeight > UINT32_MAX))
+    {
+        throw std::runtime_error("The " + std::to_string(SectionWidth) + " by " + std::to_string(SectionHeight) +
+            " box section is too large to lay out.");
+    }
+    BoxSectionWidth = std::max<LayoutCoordinate>(SectionWidth, 0);
+    BoxSectionHeight = std::max<LayoutCoordinate>(SectionHeight, 0);
+}
+
+// Finds the top left corner that centers the box section in the diagram, throwing when the section
+// is wider or taller than the diagram rather than letting the corner wrap around.
+void CenterBoxSection(const ActivityDiagram& Diagram,
+    uint32_t BoxSectionWidth,
+    uint32_t BoxSectionHeight,
+    uint32_t& ColumnCenterOffset,
+    uint32_t& RowCenterOffset)
+{
+    if ((BoxSectionWidth > Diagram.Width) || (BoxSectionHeight > Diagram.Height))
+    {
+        throw std::runtime_error("The boxes need " + std::to_string(BoxSectionWidth) + " by " + std::to_string(BoxSectionHeight) +
+            " characters, more than the " + std::to_string(Diagram.Width) + " by " + std::to_string(Diagram.Height) + " diagram.");
+    }
+    ColumnCenterOffset = (Diagram.Width / 2u) - (BoxSectionWidth / 2u);
+    RowCenterOffset = (Diagram.Height / 2u) - (BoxSectionHeight / 2u);
+}
+
+// Places the boxes down the diagonal in BoxOrder.
 void LayoutBoxes(ActivityDiagram &Diagram, 
     uint32_t BoxWidth, 
     uint32_t BoxHeight, 
     uint32_t BoxXGap,
-    uint32_t BoxYGap)
+    uint32_t BoxYGap,
+    const std::vector<uint32_t>& BoxOrder)
 {
     uint32_t NumBoxes;
     FilePosition Cursor;
     uint32_t ColumnCenterOffset;
     uint32_t RowCenterOffset;
-    uint32_t RowHeight;
-    uint32_t ColumnWidth;
     uint32_t BoxSectionHeight;
     uint32_t BoxSectionWidth;
     
     NumBoxes = Diagram.Boxes.size();
-    BoxSectionHeight = (NumBoxes * BoxHeight) + ((NumBoxes-1u) * BoxYGap);
-    BoxSectionWidth = (NumBoxes * BoxWidth) + ((NumBoxes-1u) * BoxXGap);
-    RowHeight = BoxSectionHeight / (1u+NumBoxes);
-    ColumnWidth = BoxSectionWidth / (1u+NumBoxes);
-    ColumnCenterOffset = (Diagram.Width / 2u) - (BoxSectionWidth / 2u);
-    RowCenterOffset = (Diagram.Height / 2u) - (BoxSectionHeight / 2u);
+    MeasureBoxSection(NumBoxes, DiagonalBoxLayout, BoxWidth, BoxHeight, BoxXGap, BoxYGap, BoxSectionWidth, BoxSectionHeight);
+    CenterBoxSection(Diagram, BoxSectionWidth, BoxSectionHeight, ColumnCenterOffset, RowCenterOffset);
     Cursor.Column = ColumnCenterOffset;
     Cursor.Row = RowCenterOffset;
     Cursor.Column += (BoxWidth/2u);
     Cursor.Row += (BoxHeight/2u);
-    for (uint32_t BoxIndex = 0u; BoxIndex < NumBoxes; BoxIndex++)
+    for (uint32_t Place = 0u; Place < NumBoxes; Place++)
     {
-        ActivityBox& SelectedBox = Diagram.Boxes[BoxIndex];
+        ActivityBox& SelectedBox = Diagram.Boxes[BoxOrder[Place]];
         
         SelectedBox.Width = BoxWidth;
         SelectedBox.Height = BoxHeight;
@@ -81,914 +166,938 @@ void LayoutBoxes(ActivityDiagram &Diagram,
     }
 }
 
-void LayoutBoxStubs(ActivityDiagram &Diagram)
+// Lists, for every box, the other boxes with an output that one of its inputs, controls or mechanisms refers to.
+// The feeders of box B are entries FirstFeeders[B] up to FirstFeeders[B + 1] of FeederBoxes, in ascending order.
+void ListFeedingBoxes(const ActivityDiagram& Diagram, std::vector<uint32_t>& FirstFeeders, std::vector<uint32_t>& FeederBoxes)
 {
+    const StubTable& Stubs = Diagram.Stubs;
+    const StubCrossReference& CrossReference = Diagram.CrossReference;
+    std::vector<std::pair<uint32_t, uint32_t>> Feeds;
     uint32_t NumBoxes;
 
     NumBoxes = Diagram.Boxes.size();
     for (uint32_t BoxIndex = 0u; BoxIndex < NumBoxes; BoxIndex++)
     {
-        ActivityBox &SelectedBox = Diagram.Boxes[BoxIndex];
-        uint8_t NumInputStubs;
-        uint8_t NumOutputStubs;
-        uint8_t NumControlStubs;
-        uint8_t NumMechanismStubs;
-        uint8_t NumCallStubs;
-        uint8_t InputInterfaceDivisions;
-        uint8_t InputInterfaceDivisionWidth;
-        uint8_t OutputInterfaceDivisions;
-        uint8_t OutputInterfaceDivisionWidth;
-        uint8_t ControlInterfaceDivisions;
-        uint8_t ControlInterfaceDivisionWidth;
-        uint8_t MechanismInterfaceDivisions;
-        uint8_t MechanismInterfaceDivisionWidth;
-        uint8_t CallInterfaceDivisions;
-        uint8_t CallInterfaceDivisionWidth;
-
-        NumInputStubs = SelectedBox.InputStubs.size();
-        NumOutputStubs = SelectedBox.OutputStubs.size();
-        NumControlStubs = SelectedBox.ControlStubs.size();
-        NumMechanismStubs = SelectedBox.MechanismStubs.size();
-        NumCallStubs = SelectedBox.CallStubs.size();
-        InputInterfaceDivisions = NumInputStubs + 1u;
-        InputInterfaceDivisionWidth = SelectedBox.Height / InputInterfaceDivisions;
-        for (uint32_t InputStubIndex = 0u; InputStubIndex < NumInputStubs; InputStubIndex++)
-        {
-            InputStub& SelectedInputStub = std::get<InputStub>(SelectedBox.InputStubs[InputStubIndex]);
-            uint32_t RowOffset;
+        const ActivityBox& SelectedBox = Diagram.Boxes[BoxIndex];
 
-            RowOffset = InputInterfaceDivisionWidth * (1u + InputStubIndex);
-            SelectedInputStub.Position.Column = SelectedBox.Center.Column - (SelectedBox.Width / 2u);
-            SelectedInputStub.Position.Row = SelectedBox.Center.Row - (SelectedBox.Height / 2u);
-            SelectedInputStub.Position.Row = SelectedInputStub.Position.Row + RowOffset;
-            SelectedInputStub.Length = 3u + InputStubIndex;
-        }
-        OutputInterfaceDivisions = NumOutputStubs + 1u;
-        OutputInterfaceDivisionWidth = SelectedBox.Height / OutputInterfaceDivisions;
-        for (uint32_t OutputStubIndex = 0u; OutputStubIndex < NumOutputStubs; OutputStubIndex++)
-        {
-            OutputStub &SelectedOutputStub = std::get<OutputStub>(SelectedBox.OutputStubs[OutputStubIndex]);
-            uint32_t RowOffset;
-
-            RowOffset = OutputInterfaceDivisionWidth * (1u + OutputStubIndex);
-            SelectedOutputStub.Position.Column = SelectedBox.Center.Column + (SelectedBox.Width / 2u);
-            SelectedOutputStub.Position.Row = SelectedBox.Center.Row - (SelectedBox.Height / 2u);
-            SelectedOutputStub.Position.Row = SelectedOutputStub.Position.Row + RowOffset;
-            SelectedOutputStub.Length = 3u + OutputStubIndex;
-        }
-        ControlInterfaceDivisions = NumControlStubs + 1u;
-        ControlInterfaceDivisionWidth = SelectedBox.Width / ControlInterfaceDivisions;
-        for (uint32_t ControlStubIndex = 0u; ControlStubIndex < NumControlStubs; ControlStubIndex++)
+        for (uint32_t StubID = SelectedBox.OutputStubs.First; StubID < SelectedBox.OutputStubs.End; StubID++)
         {
-            ControlStub &SelectedControlStub = std::get<ControlStub>(SelectedBox.ControlStubs[ControlStubIndex]);
-            uint32_t ColumnOffset;
+            uint32_t NameID = Stubs.NameIDs[StubID];
 
-            ColumnOffset = ControlInterfaceDivisionWidth * (1u + ControlStubIndex);
-            SelectedControlStub.Position.Column = SelectedBox.Center.Column - (SelectedBox.Width / 2u);
-            SelectedControlStub.Position.Row = SelectedBox.Center.Row - (SelectedBox.Height / 2u);
-            SelectedControlStub.Position.Column = SelectedControlStub.Position.Column + ColumnOffset;
-            SelectedControlStub.Length = 3u + ControlStubIndex;
-        }
-        MechanismInterfaceDivisions = NumMechanismStubs + 1u;
-        MechanismInterfaceDivisionWidth = (SelectedBox.Width / 2u) / MechanismInterfaceDivisions;
-        for (uint32_t MechanismStubIndex = 0u; MechanismStubIndex < NumMechanismStubs; MechanismStubIndex++)
-        {
-            MechanismStub &SelectedMechanismStub = std::get<MechanismStub>(SelectedBox.MechanismStubs[MechanismStubIndex]);
-            uint32_t ColumnOffset;
-
-            ColumnOffset = MechanismInterfaceDivisionWidth * (1u + MechanismStubIndex);
-            SelectedMechanismStub.Position.Column = SelectedBox.Center.Column - (SelectedBox.Width / 2u);
-            SelectedMechanismStub.Position.Row = SelectedBox.Center.Row + (SelectedBox.Height / 2u);
-            SelectedMechanismStub.Position.Column = SelectedMechanismStub.Position.Column + ColumnOffset;
-            SelectedMechanismStub.Length = 3u + MechanismStubIndex;
-        }
-        CallInterfaceDivisions = NumCallStubs + 1u;
-        CallInterfaceDivisionWidth = (SelectedBox.Width / 2) / CallInterfaceDivisions;
-        for (uint32_t CallStubIndex = 0u; CallStubIndex < NumCallStubs; CallStubIndex++)
-        {
-            CallStub &SelectedCallStub = std::get<CallStub>(SelectedBox.CallStubs[CallStubIndex]);
-            uint32_t ColumnOffset;
+            for (uint32_t ReferenceIndex = CrossReference.FirstReferences[NameID]; ReferenceIndex < CrossReference.FirstReferences[NameID + 1u]; ReferenceIndex++)
+            {
+                uint32_t ConsumerBox = CrossReference.ReferenceBoxes[ReferenceIndex];
+                Interface ConsumerKind = Stubs.Kinds[CrossReference.ReferenceStubIDs[ReferenceIndex]];
 
-            ColumnOffset = CallInterfaceDivisionWidth * (1u + CallStubIndex);
-            SelectedCallStub.Position.Column = SelectedBox.Center.Column;
-            SelectedCallStub.Position.Row = SelectedBox.Center.Row + (SelectedBox.Height / 2u);
-            SelectedCallStub.Position.Column = SelectedCallStub.Position.Column + ColumnOffset;
-            SelectedCallStub.Length = 4u;
+                if ((ConsumerBox != BoundaryStubOwner) && (ConsumerBox != BoxIndex) &&
+                    ((ConsumerKind == InputInterface) || (ConsumerKind == ControlInterface) || (ConsumerKind == MechanismInterface)))
+                {
+                    Feeds.emplace_back(ConsumerBox, BoxIndex);
+                }
+            }
         }
     }
+    std::sort(Feeds.begin(), Feeds.end());
+    Feeds.erase(std::unique(Feeds.begin(), Feeds.end()), Feeds.end());
+    FirstFeeders.assign(NumBoxes + 1u, 0u);
+    FeederBoxes.resize(Feeds.size());
+    for (uint32_t FeedIndex = 0u; FeedIndex < Feeds.size(); FeedIndex++)
+    {
+        FirstFeeders[Feeds[FeedIndex].first + 1u]++;
+        FeederBoxes[FeedIndex] = Feeds[FeedIndex].second;
+    }
+    for (uint32_t BoxIndex = 0u; BoxIndex < NumBoxes; BoxIndex++)
+    {
+        FirstFeeders[BoxIndex + 1u] += FirstFeeders[BoxIndex];
+    }
 }
 
-void FindInnerStub(const ActivityDiagram& Diagram, const Stub& BoundaryStub, Stub& FoundStub, bool& FoundFlag)
+// Orders the boxes for placement so that feeds run forwards and cross each other as little as
+// possible. Feeds that close a cycle, found by a depth first search from the boxes in document
+// order, are left out so the earlier box of a cycle stays first. Each box is then layered by the
+// longest path of feeds into it, and the layers are reordered by the mean place of each box's
+// feeders and then of its successors, sweeping down and up a few times. Boxes of a layer start in
+// document order and keep it where their means tie. BoxOrder lists the boxes layer by layer.
+void OrderBoxes(const ActivityDiagram& Diagram, std::vector<uint32_t>& BoxOrder)
 {
-    FoundFlag = false;
-    for (const ActivityBox& SelectedBox : Diagram.Boxes)
+    std::vector<uint32_t> FirstFeeders;
+    std::vector<uint32_t> FeederBoxes;
+    std::vector<uint32_t> FirstSuccessors;
+    std::vector<uint32_t> SuccessorBoxes;
+    std::vector<uint32_t> SearchOrder;
+    std::vector<uint32_t> SearchPlaces;
+    std::vector<uint8_t> Searched;
+    std::vector<std::pair<uint32_t, uint32_t>> SearchStack;
+    std::vector<uint32_t> BoxLayers;
+    std::vector<std::vector<uint32_t>> Layers;
+    std::vector<double> LayerPlaces;
+    uint32_t NumBoxes;
+
+    NumBoxes = Diagram.Boxes.size();
+    ListFeedingBoxes(Diagram, FirstFeeders, FeederBoxes);
+    FirstSuccessors.assign(NumBoxes + 1u, 0u);
+    SuccessorBoxes.resize(FeederBoxes.size());
+    for (uint32_t FeederBox : FeederBoxes)
     {
-        if (std::holds_alternative<InputStub>(BoundaryStub))
+        FirstSuccessors[FeederBox + 1u]++;
+    }
+    for (uint32_t BoxIndex = 0u; BoxIndex < NumBoxes; BoxIndex++)
+    {
+        FirstSuccessors[BoxIndex + 1u] += FirstSuccessors[BoxIndex];
+    }
+    {
+        std::vector<uint32_t> NextSuccessors(FirstSuccessors.begin(), FirstSuccessors.end() - 1u);
+
+        for (uint32_t BoxIndex = 0u; BoxIndex < NumBoxes; BoxIndex++)
         {
-            const InputStub& BoundaryInputStub = std::get<InputStub>(BoundaryStub);
-            
-            for (const Stub& SelectedStub : SelectedBox.InputStubs)
-            {
-                const InputStub& SelectedInputStub = std::get<InputStub>(SelectedStub);
-                
-                if (SelectedInputStub.Name == BoundaryInputStub.Name)
-                {
-                    FoundStub = SelectedInputStub;
-                    FoundFlag = true;
-                }
-                else
-                {
-                    for (const StubSource& StubSource : SelectedInputStub.Sources)
-                    {
-                        if (StubSource.StubName == BoundaryInputStub.Name)
-                        {
-                            FoundStub = SelectedInputStub;
-                            FoundFlag = true;
-                        }
-                    }
-                }
-            } 
-            for (const Stub& SelectedStub : SelectedBox.ControlStubs)
+            for (uint32_t FeederIndex = FirstFeeders[BoxIndex]; FeederIndex < FirstFeeders[BoxIndex + 1u]; FeederIndex++)
             {
-                const ControlStub& SelectedControlStub = std::get<ControlStub>(SelectedStub);
-                
-                if (SelectedControlStub.Name == BoundaryInputStub.Name)
-                {
-                    FoundStub = SelectedControlStub;
-                    FoundFlag = true;
-                }
-                else
-                {
-                    for (const StubSource& StubSource : SelectedControlStub.Sources)
-                    {
-                        if (StubSource.StubName == BoundaryInputStub.Name)
-                        {
-                            FoundStub = SelectedControlStub;
-                            FoundFlag = true;
-                        }
-                    }
-                }
+                SuccessorBoxes[NextSuccessors[FeederBoxes[FeederIndex]]++] = BoxIndex;
             }
         }
-        else if (std::holds_alternative<ControlStub>(BoundaryStub))
+    }
+
+    // A feed runs forwards when its feeder finishes the search after its successor, so the reversed
+    // finishing order ranks every box after all of its forward feeders.
+    Searched.assign(NumBoxes, 0u);
+    for (uint32_t RootBox = 0u; RootBox < NumBoxes; RootBox++)
+    {
+        if (Searched[RootBox] == 1u)
+        {
+            continue;
+        }
+        Searched[RootBox] = 1u;
+        SearchStack.emplace_back(RootBox, FirstSuccessors[RootBox]);
+        while (SearchStack.empty() == false)
         {
-            const ControlStub& BoundaryControlStub = std::get<ControlStub>(BoundaryStub);
-            
-            for (const Stub& SelectedStub : SelectedBox.InputStubs)
+            std::pair<uint32_t, uint32_t>& Top = SearchStack.back();
+
+            if (Top.second < FirstSuccessors[Top.first + 1u])
             {
-                const InputStub& SelectedInputStub = std::get<InputStub>(SelectedStub);
-                
-                if (SelectedInputStub.Name == BoundaryControlStub.Name)
-                {
-                    FoundStub = SelectedInputStub;
-                    FoundFlag = true;
-                }
-                else
+                uint32_t SuccessorBox = SuccessorBoxes[Top.second];
+
+                Top.second++;
+                if (Searched[SuccessorBox] == 0u)
                 {
-                    for (const StubSource& SelectedStubSource : SelectedInputStub.Sources)
-                    {
-                        if (SelectedStubSource.StubName == BoundaryControlStub.Name)
-                        {
-                            FoundStub = SelectedInputStub;
-                            FoundFlag = true;
-                        }
-                    }
+                    Searched[SuccessorBox] = 1u;
+                    SearchStack.emplace_back(SuccessorBox, FirstSuccessors[SuccessorBox]);
                 }
             }
-            for (const Stub& SelectedStub : SelectedBox.ControlStubs)
+            else
             {
-                const ControlStub& SelectedControlStub = std::get<ControlStub>(SelectedStub);
-
-                if (SelectedControlStub.Name == BoundaryControlStub.Name)
-                {
-                    FoundStub = SelectedControlStub;
-                    FoundFlag = true;
-                }
-                else
-                {
-                    for (const StubSource& SelectedStubSource : SelectedControlStub.Sources)
-                    {
-                        if (SelectedStubSource.StubName == BoundaryControlStub.Name)
-                        {
-                            FoundStub = SelectedControlStub;
-                            FoundFlag = true;
-                        }
-                    }
-                }
+                SearchOrder.push_back(Top.first);
+                SearchStack.pop_back();
             }
         }
-        else if (std::holds_alternative<OutputStub>(BoundaryStub))
+    }
+    std::reverse(SearchOrder.begin(), SearchOrder.end());
+    SearchPlaces.resize(NumBoxes);
+    for (uint32_t Place = 0u; Place < NumBoxes; Place++)
+    {
+        SearchPlaces[SearchOrder[Place]] = Place;
+    }
+
+    BoxLayers.assign(NumBoxes, 0u);
+    for (uint32_t BoxIndex : SearchOrder)
+    {
+        for (uint32_t FeederIndex = FirstFeeders[BoxIndex]; FeederIndex < FirstFeeders[BoxIndex + 1u]; FeederIndex++)
         {
-            const OutputStub& BoundaryOutputStub = std::get<OutputStub>(BoundaryStub);
-            
-            for (const Stub& SelectedStub : SelectedBox.OutputStubs)
+            uint32_t FeederBox = FeederBoxes[FeederIndex];
+
+            if (SearchPlaces[FeederBox] < SearchPlaces[BoxIndex])
             {
-                const OutputStub& SelectedOutputStub = std::get<OutputStub>(SelectedStub);
+                BoxLayers[BoxIndex] = std::max(BoxLayers[BoxIndex], BoxLayers[FeederBox] + 1u);
+            }
+        }
+        if (BoxLayers[BoxIndex] >= Layers.size())
+        {
+            Layers.resize(BoxLayers[BoxIndex] + 1u);
+        }
+    }
+    for (uint32_t BoxIndex = 0u; BoxIndex < NumBoxes; BoxIndex++)
+    {
+        Layers[BoxLayers[BoxIndex]].push_back(BoxIndex);
+    }
 
-                if (SelectedOutputStub.Name == BoundaryOutputStub.Name)
-                {
-                    FoundStub = SelectedOutputStub;
-                    FoundFlag = true;
-                }
-                else
-                {
-                    for (const StubSource& BoundaryStubSource : BoundaryOutputStub.Sources)
-                    {
-                        if (BoundaryStubSource.StubName == SelectedOutputStub.Name)
-                        {
-                            FoundStub = SelectedOutputStub;
-                            FoundFlag = true;
-                        }
-                    } 
-                }
-            }    
+    LayerPlaces.resize(NumBoxes);
+    for (const std::vector<uint32_t>& Layer : Layers)
+    {
+        for (uint32_t Place = 0u; Place < Layer.size(); Place++)
+        {
+            LayerPlaces[Layer[Place]] = Place;
         }
-        else if (std::holds_alternative<MechanismStub>(BoundaryStub))
+    }
+    for (uint32_t SweepIndex = 0u; SweepIndex < (2u * OrderingSweeps); SweepIndex++)
+    {
+        bool Downwards = (SweepIndex % 2u) == 0u;
+
+        for (uint32_t Step = 1u; Step < Layers.size(); Step++)
         {
-            const MechanismStub& BoundaryMechanismStub = std::get<MechanismStub>(BoundaryStub);
+            std::vector<uint32_t>& Layer = Layers[(Downwards == true) ? Step : (Layers.size() - 1u - Step)];
+            const std::vector<uint32_t>& FirstNeighbours = (Downwards == true) ? FirstFeeders : FirstSuccessors;
+            const std::vector<uint32_t>& NeighbourBoxes = (Downwards == true) ? FeederBoxes : SuccessorBoxes;
+            std::vector<double> Barycenters(Layer.size());
 
-            for (const Stub& SelectedStub : SelectedBox.MechanismStubs)
+            for (uint32_t Place = 0u; Place < Layer.size(); Place++)
             {
-                const MechanismStub& BoxMechanismStub = std::get<MechanismStub>(SelectedStub);
+                uint32_t BoxIndex = Layer[Place];
+                double PlaceSum;
+                uint32_t NumNeighbours;
 
-                if (BoundaryMechanismStub.Name == BoxMechanismStub.Name)
-                {
-                    FoundStub = BoxMechanismStub;
-                    FoundFlag = true;
-                }
-                else
+                PlaceSum = 0.0;
+                NumNeighbours = 0u;
+                for (uint32_t NeighbourIndex = FirstNeighbours[BoxIndex]; NeighbourIndex < FirstNeighbours[BoxIndex + 1u]; NeighbourIndex++)
                 {
-                    for (const StubSource& BoxStubSource : BoxMechanismStub.Sources)
+                    uint32_t NeighbourBox = NeighbourBoxes[NeighbourIndex];
+
+                    if ((Downwards == true) ? (BoxLayers[NeighbourBox] < BoxLayers[BoxIndex]) : (BoxLayers[NeighbourBox] > BoxLayers[BoxIndex]))
                     {
-                        if (BoxStubSource.StubName == BoundaryMechanismStub.Name)
-                        {
-                            FoundStub = BoxMechanismStub;
-                            FoundFlag = true;
-                        }
+                        PlaceSum += LayerPlaces[NeighbourBox];
+                        NumNeighbours++;
                     }
                 }
+                Barycenters[Place] = (NumNeighbours > 0u) ? (PlaceSum / NumNeighbours) : Place;
             }
-        }
-        else if (std::holds_alternative<CallStub>(BoundaryStub))
-        {
-            const CallStub& BoundaryCallStub = std::get<CallStub>(BoundaryStub);
-
-            for (const Stub& SelectedStub : SelectedBox.CallStubs)
             {
-                const CallStub& BoxCallStub = std::get<CallStub>(SelectedStub);
+                std::vector<uint32_t> Places(Layer.size());
+                std::vector<uint32_t> Reordered(Layer.size());
 
-                if (BoundaryCallStub.Name == BoxCallStub.Name)
+                for (uint32_t Place = 0u; Place < Layer.size(); Place++)
                 {
-                    FoundStub = BoxCallStub;
-                    FoundFlag = true;
+                    Places[Place] = Place;
                 }
-                else
+                std::stable_sort(Places.begin(), Places.end(), [&Barycenters](uint32_t FirstPlace, uint32_t SecondPlace)
                 {
-                    for (const StubSource& BoundaryStubSource : BoundaryCallStub.Sources)
-                    {
-                        if (BoundaryStubSource.StubName == BoxCallStub.Name)
-                        {
-                            FoundStub = BoxCallStub;
-                            FoundFlag = true;
-                        }
-                    }
+                    return Barycenters[FirstPlace] < Barycenters[SecondPlace];
+                });
+                for (uint32_t Place = 0u; Place < Layer.size(); Place++)
+                {
+                    Reordered[Place] = Layer[Places[Place]];
+                    LayerPlaces[Reordered[Place]] = Place;
                 }
+                Layer = Reordered;
             }
         }
-        if (FoundFlag == true)
-        {
-            break;
-        }
+    }
+
+    BoxOrder.clear();
+    BoxOrder.reserve(NumBoxes);
+    for (const std::vector<uint32_t>& Layer : Layers)
+    {
+        BoxOrder.insert(BoxOrder.end(), Layer.begin(), Layer.end());
     }
 }
 
-std::vector<ActivityBox> LocateConnectedBoxes(ActivityDiagram& Diagram, std::string& TargetStubName)
+// Fills the columns of the grid top to bottom in BoxOrder, so the reading order runs down
+// each column and then on to the next. Every column is then compacted on its own with libavoid's
+// VPSC solver: a box is drawn towards the mean row of the boxes in earlier columns that feed it,
+// while keeping its place in the column, the box gap to its neighbours and the grid's top and
+// bottom. Only columns with free rows can move, so the section never grows past the grid.
+void LayoutGridBoxes(ActivityDiagram &Diagram,
+    uint32_t BoxWidth,
+    uint32_t BoxHeight,
+    uint32_t BoxXGap,
+    uint32_t BoxYGap,
+    const std::vector<uint32_t>& BoxOrder)
 {
-    std::vector<ActivityBox> ConnectedBoxes;
+    std::vector<uint32_t> FirstFeeders;
+    std::vector<uint32_t> FeederBoxes;
+    std::vector<uint32_t> BoxPlaces;
+    std::vector<double> BoxTops;
+    uint32_t NumBoxes;
+    uint32_t NumColumns;
+    uint32_t NumRows;
+    uint32_t BoxSectionWidth;
+    uint32_t BoxSectionHeight;
+    uint32_t ColumnCenterOffset;
+    uint32_t RowCenterOffset;
 
-    for (ActivityBox& SelectedBox : Diagram.Boxes)
+    NumBoxes = Diagram.Boxes.size();
+    CountBoxCells(NumBoxes, GridBoxLayout, NumColumns, NumRows);
+    MeasureBoxSection(NumBoxes, GridBoxLayout, BoxWidth, BoxHeight, BoxXGap, BoxYGap, BoxSectionWidth, BoxSectionHeight);
+    CenterBoxSection(Diagram, BoxSectionWidth, BoxSectionHeight, ColumnCenterOffset, RowCenterOffset);
+    ListFeedingBoxes(Diagram, FirstFeeders, FeederBoxes);
+    BoxPlaces.resize(NumBoxes);
+    for (uint32_t Place = 0u; Place < NumBoxes; Place++)
     {
-        for (Stub& SelectedStub : SelectedBox.InputStubs)
+        BoxPlaces[BoxOrder[Place]] = Place;
+    }
+    BoxTops.resize(NumBoxes);
+    for (uint32_t ColumnIndex = 0u; ColumnIndex < NumColumns; ColumnIndex++)
+    {
+        Avoid::Variables Variables;
+        Avoid::Constraints Constraints;
+        uint32_t FirstPlace;
+        uint32_t EndPlace;
+
+        FirstPlace = ColumnIndex * NumRows;
+        EndPlace = std::min(NumBoxes, FirstPlace + NumRows);
+        if (FirstPlace >= EndPlace)
         {
-            InputStub& SelectedInputStub = std::get<InputStub>(SelectedStub);
-
-            if (SelectedInputStub.Name == TargetStubName)
-            {
-                ConnectedBoxes.push_back(SelectedBox);
-            }
-            else
-            {
-                for (StubSource& SelectedSource : SelectedInputStub.Sources)
-                {
-                    if (SelectedSource.StubName == TargetStubName)
-                    {
-                        ConnectedBoxes.push_back(SelectedBox);
-                    }
-                }
-            }
+            break;
         }
-        for (Stub& SelectedStub : SelectedBox.OutputStubs)
+        Variables.push_back(new Avoid::Variable(0, 0.0, 100000.0));
+        Variables.push_back(new Avoid::Variable(1, BoxSectionHeight, 100000.0));
+        for (uint32_t Place = FirstPlace; Place < EndPlace; Place++)
         {
-            OutputStub& SelectedOutputStub = std::get<OutputStub>(SelectedStub);
+            uint32_t BoxIndex = BoxOrder[Place];
+            double DesiredTop;
+            uint32_t NumPlacedFeeders;
 
-            if (SelectedOutputStub.Name == TargetStubName)
-            {
-                ConnectedBoxes.push_back(SelectedBox);
-            }
-            else
+            DesiredTop = 0.0;
+            NumPlacedFeeders = 0u;
+            for (uint32_t FeederIndex = FirstFeeders[BoxIndex]; FeederIndex < FirstFeeders[BoxIndex + 1u]; FeederIndex++)
             {
-                for (StubSource& SelectedSource : SelectedOutputStub.Sources)
+                if (BoxPlaces[FeederBoxes[FeederIndex]] < FirstPlace)
                 {
-                    if (SelectedSource.StubName == TargetStubName)
-                    {
-                        ConnectedBoxes.push_back(SelectedBox);
-                    }
+                    DesiredTop += BoxTops[FeederBoxes[FeederIndex]];
+                    NumPlacedFeeders++;
                 }
             }
-        }
-        for (Stub& SelectedStub : SelectedBox.ControlStubs)
-        {
-            ControlStub& SelectedControlStub = std::get<ControlStub>(SelectedStub);
-
-            if (SelectedControlStub.Name == TargetStubName)
+            if (NumPlacedFeeders > 0u)
             {
-                ConnectedBoxes.push_back(SelectedBox);
+                DesiredTop /= NumPlacedFeeders;
             }
             else
             {
-                for (StubSource& SelectedSource : SelectedControlStub.Sources)
-                {
-                    if (SelectedSource.StubName == TargetStubName)
-                    {
-                        ConnectedBoxes.push_back(SelectedBox);
-                    }
-                }
+                DesiredTop = (Place - FirstPlace) * (BoxHeight + BoxYGap);
             }
-        }
-        for (Stub& SelectedStub : SelectedBox.MechanismStubs)
-        {
-            MechanismStub& SelectedMechanismStub = std::get<MechanismStub>(SelectedStub);
-
-            if (SelectedMechanismStub.Name == TargetStubName)
+            Variables.push_back(new Avoid::Variable(Variables.size(), DesiredTop));
+            if (Place == FirstPlace)
             {
-                ConnectedBoxes.push_back(SelectedBox);
+                Constraints.push_back(new Avoid::Constraint(Variables[0u], Variables.back(), 0.0));
             }
             else
             {
-                for (StubSource& SelectedSource : SelectedMechanismStub.Sources)
-                {
-                    if (SelectedSource.StubName == TargetStubName)
-                    {
-                        ConnectedBoxes.push_back(SelectedBox);
-                    }
-                }
+                Constraints.push_back(new Avoid::Constraint(Variables[Variables.size() - 2u], Variables.back(), BoxHeight + BoxYGap));
             }
         }
-        for (Stub& SelectedStub : SelectedBox.CallStubs)
+        Constraints.push_back(new Avoid::Constraint(Variables.back(), Variables[1u], BoxHeight));
         {
-            CallStub& SelectedCallStub = std::get<CallStub>(SelectedStub);
+            Avoid::IncSolver Solver(Variables, Constraints);
 
-            if (SelectedCallStub.Name == TargetStubName)
-            {
-                ConnectedBoxes.push_back(SelectedBox);
-            }
-            else
-            {
-                for (StubSource& SelectedSource : SelectedCallStub.Sources)
-                {
-                    if (SelectedSource.StubName == TargetStubName)
-                    {
-                        ConnectedBoxes.push_back(SelectedBox);
-                    }
-                }
-            }
+            Solver.solve();
+        }
+        for (uint32_t Place = FirstPlace; Place < EndPlace; Place++)
+        {
+            uint32_t BoxIndex = BoxOrder[Place];
+            ActivityBox& SelectedBox = Diagram.Boxes[BoxIndex];
+            double SolvedTop;
+
+            SolvedTop = Variables[2u + Place - FirstPlace]->finalPosition;
+            BoxTops[BoxIndex] = std::floor(SolvedTop + 0.5);
+            SelectedBox.Width = BoxWidth;
+            SelectedBox.Height = BoxHeight;
+            SelectedBox.Center.Column = ColumnCenterOffset + (ColumnIndex * (BoxWidth + BoxXGap)) + (BoxWidth / 2u);
+            SelectedBox.Center.Row = RowCenterOffset + (uint32_t)std::max(0.0, BoxTops[BoxIndex]) + (BoxHeight / 2u);
+        }
+        for (Avoid::Constraint* SolvedConstraint : Constraints)
+        {
+            delete SolvedConstraint;
+        }
+        for (Avoid::Variable* SolvedVariable : Variables)
+        {
+            delete SolvedVariable;
         }
     }
+}
 
-    return ConnectedBoxes;
+// Stubs of one interface are spaced a division apart, so a box too small for a division of at
+// least one character would draw them all on the same row or column.
+void CheckInterfaceDivisions(uint32_t BoxIndex, uint32_t NumStubs, uint32_t DivisionWidth, const char* KindName, const char* SizeName)
+{
+    if ((NumStubs > 0u) && (DivisionWidth == 0u))
+    {
+        throw std::runtime_error("Box " + std::to_string(BoxIndex + 1u) + " is not " + SizeName + " enough to separate its " +
+            std::to_string(NumStubs) + " " + KindName + " stubs.");
+    }
 }
 
-bool CheckStubOverlap(Stub FirstStub, Stub SecondStub)
+void LayoutBoxStubs(ActivityDiagram &Diagram)
 {
-    bool Overlaps;
+    StubTable& Stubs = Diagram.Stubs;
+    uint32_t NumBoxes;
 
-    Overlaps = false;
-    if (std::holds_alternative<InputStub>(FirstStub))
+    NumBoxes = Diagram.Boxes.size();
+    for (uint32_t BoxIndex = 0u; BoxIndex < NumBoxes; BoxIndex++)
     {
-        InputStub FirstInputStub;
-
-        FirstInputStub = std::get<InputStub>(FirstStub);
-        if (std::holds_alternative<InputStub>(SecondStub))
+        ActivityBox &SelectedBox = Diagram.Boxes[BoxIndex];
+        uint32_t NumInputStubs;
+        uint32_t NumOutputStubs;
+        uint32_t NumControlStubs;
+        uint32_t NumMechanismStubs;
+        uint32_t NumCallStubs;
+        uint32_t InputInterfaceDivisions;
+        uint32_t InputInterfaceDivisionWidth;
+        uint32_t OutputInterfaceDivisions;
+        uint32_t OutputInterfaceDivisionWidth;
+        uint32_t ControlInterfaceDivisions;
+        uint32_t ControlInterfaceDivisionWidth;
+        uint32_t MechanismInterfaceDivisions;
+        uint32_t MechanismInterfaceDivisionWidth;
+        uint32_t CallInterfaceDivisions;
+        uint32_t CallInterfaceDivisionWidth;
+
+        NumInputStubs = SelectedBox.InputStubs.End - SelectedBox.InputStubs.First;
+        NumOutputStubs = SelectedBox.OutputStubs.End - SelectedBox.OutputStubs.First;
+        NumControlStubs = SelectedBox.ControlStubs.End - SelectedBox.ControlStubs.First;
+        NumMechanismStubs = SelectedBox.MechanismStubs.End - SelectedBox.MechanismStubs.First;
+        NumCallStubs = SelectedBox.CallStubs.End - SelectedBox.CallStubs.First;
+        InputInterfaceDivisions = NumInputStubs + 1u;
+        InputInterfaceDivisionWidth = SelectedBox.Height / InputInterfaceDivisions;
+        CheckInterfaceDivisions(BoxIndex, NumInputStubs, InputInterfaceDivisionWidth, "input", "tall");
+        for (uint32_t InputStubIndex = 0u; InputStubIndex < NumInputStubs; InputStubIndex++)
         {
-            InputStub SecondInputStub;
+            FilePosition& StubPosition = Stubs.Positions[SelectedBox.InputStubs.First + InputStubIndex];
+            uint32_t RowOffset;
 
-            SecondInputStub = std::get<InputStub>(SecondStub);
-            if (FirstInputStub.Position.Row == SecondInputStub.Position.Row)
-            {
-                Overlaps = true;
-            }
-            else if (FirstInputStub.Position.Row == (SecondInputStub.Position.Row - 1u))
-            {
-                Overlaps = true;
-            }
-            else if (FirstInputStub.Position.Row == (SecondInputStub.Position.Row + 1u))
-            {
-                Overlaps = true;
-            }
+            RowOffset = InputInterfaceDivisionWidth * (1u + InputStubIndex);
+            StubPosition.Column = SelectedBox.Center.Column - (SelectedBox.Width / 2u);
+            StubPosition.Row = SelectedBox.Center.Row - (SelectedBox.Height / 2u);
+            StubPosition.Row = StubPosition.Row + RowOffset;
+            Stubs.Lengths[SelectedBox.InputStubs.First + InputStubIndex] = 3u + InputStubIndex;
         }
-    }
-    else if (std::holds_alternative<OutputStub>(FirstStub))
-    {
-        OutputStub FirstOutputStub;
-
-        FirstOutputStub = std::get<OutputStub>(FirstStub);
-        if (std::holds_alternative<OutputStub>(SecondStub))
+        OutputInterfaceDivisions = NumOutputStubs + 1u;
+        OutputInterfaceDivisionWidth = SelectedBox.Height / OutputInterfaceDivisions;
+        CheckInterfaceDivisions(BoxIndex, NumOutputStubs, OutputInterfaceDivisionWidth, "output", "tall");
+        for (uint32_t OutputStubIndex = 0u; OutputStubIndex < NumOutputStubs; OutputStubIndex++)
         {
-            OutputStub SecondOutputStub;
+            FilePosition& StubPosition = Stubs.Positions[SelectedBox.OutputStubs.First + OutputStubIndex];
+            uint32_t RowOffset;
 
-            SecondOutputStub = std::get<OutputStub>(SecondStub);
-            if (FirstOutputStub.Position.Row == SecondOutputStub.Position.Row)
-            {
-                Overlaps = true;
-            }
-            else if (FirstOutputStub.Position.Row == (SecondOutputStub.Position.Row - 1u))
-            {
-                Overlaps = true;
-            }
-            else if (FirstOutputStub.Position.Row == (SecondOutputStub.Position.Row + 1u))
-            {
-                Overlaps = true;
-            }
+            RowOffset = OutputInterfaceDivisionWidth * (1u + OutputStubIndex);
+            StubPosition.Column = SelectedBox.Center.Column + (SelectedBox.Width / 2u);
+            StubPosition.Row = SelectedBox.Center.Row - (SelectedBox.Height / 2u);
+            StubPosition.Row = StubPosition.Row + RowOffset;
+            Stubs.Lengths[SelectedBox.OutputStubs.First + OutputStubIndex] = 3u + OutputStubIndex;
         }
-    }
-    else if (std::holds_alternative<ControlStub>(FirstStub))
-    {
-        ControlStub FirstControlStub;
-
-        FirstControlStub = std::get<ControlStub>(FirstStub);
-        if (std::holds_alternative<ControlStub>(SecondStub))
+        ControlInterfaceDivisions = NumControlStubs + 1u;
+        ControlInterfaceDivisionWidth = SelectedBox.Width / ControlInterfaceDivisions;
+        CheckInterfaceDivisions(BoxIndex, NumControlStubs, ControlInterfaceDivisionWidth, "control", "wide");
+        for (uint32_t ControlStubIndex = 0u; ControlStubIndex < NumControlStubs; ControlStubIndex++)
         {
-            ControlStub SecondControlStub;
+            FilePosition& StubPosition = Stubs.Positions[SelectedBox.ControlStubs.First + ControlStubIndex];
+            uint32_t ColumnOffset;
 
-            SecondControlStub = std::get<ControlStub>(SecondStub);
-            if (FirstControlStub.Position.Column == SecondControlStub.Position.Column)
-            {
-                Overlaps = true;
-            }
-            else if (FirstControlStub.Position.Column == (SecondControlStub.Position.Column - 1u))
-            {
-                Overlaps = true;
-            }
-            else if (FirstControlStub.Position.Column == (SecondControlStub.Position.Column + 1u))
-            {
-                Overlaps = true;
-            }
+            ColumnOffset = ControlInterfaceDivisionWidth * (1u + ControlStubIndex);
+            StubPosition.Column = SelectedBox.Center.Column - (SelectedBox.Width / 2u);
+            StubPosition.Row = SelectedBox.Center.Row - (SelectedBox.Height / 2u);
+            StubPosition.Column = StubPosition.Column + ColumnOffset;
+            Stubs.Lengths[SelectedBox.ControlStubs.First + ControlStubIndex] = 3u + ControlStubIndex;
         }
-    }
-    else if (std::holds_alternative<MechanismStub>(FirstStub))
-    {
-        MechanismStub FirstMechanismStub;
-
-        FirstMechanismStub = std::get<MechanismStub>(FirstStub);
-        if (std::holds_alternative<MechanismStub>(SecondStub))
+        MechanismInterfaceDivisions = NumMechanismStubs + 1u;
+        MechanismInterfaceDivisionWidth = (SelectedBox.Width / 2u) / MechanismInterfaceDivisions;
+        CheckInterfaceDivisions(BoxIndex, NumMechanismStubs, MechanismInterfaceDivisionWidth, "mechanism", "wide");
+        for (uint32_t MechanismStubIndex = 0u; MechanismStubIndex < NumMechanismStubs; MechanismStubIndex++)
         {
-            MechanismStub SecondMechanismStub;
+            FilePosition& StubPosition = Stubs.Positions[SelectedBox.MechanismStubs.First + MechanismStubIndex];
+            uint32_t ColumnOffset;
 
-            SecondMechanismStub = std::get<MechanismStub>(SecondStub);
-            if (FirstMechanismStub.Position.Column == SecondMechanismStub.Position.Column)
-            {
-                Overlaps = true;
-            }
-            else if (FirstMechanismStub.Position.Column == (SecondMechanismStub.Position.Column - 1u))
-            {
-                Overlaps = true;
-            }
-            else if (FirstMechanismStub.Position.Column == (SecondMechanismStub.Position.Column + 1u))
-            {
-                Overlaps = true;
-            }
+            ColumnOffset = MechanismInterfaceDivisionWidth * (1u + MechanismStubIndex);
+            StubPosition.Column = SelectedBox.Center.Column - (SelectedBox.Width / 2u);
+            StubPosition.Row = SelectedBox.Center.Row + (SelectedBox.Height / 2u);
+            StubPosition.Column = StubPosition.Column + ColumnOffset;
+            Stubs.Lengths[SelectedBox.MechanismStubs.First + MechanismStubIndex] = 3u + MechanismStubIndex;
         }
-    }
-    else if (std::holds_alternative<CallStub>(FirstStub))
-    {
-        CallStub FirstCallStub;
-
-        FirstCallStub = std::get<CallStub>(FirstStub);
-        if (std::holds_alternative<CallStub>(SecondStub))
+        CallInterfaceDivisions = NumCallStubs + 1u;
+        CallInterfaceDivisionWidth = (SelectedBox.Width / 2u) / CallInterfaceDivisions;
+        CheckInterfaceDivisions(BoxIndex, NumCallStubs, CallInterfaceDivisionWidth, "call", "wide");
+        for (uint32_t CallStubIndex = 0u; CallStubIndex < NumCallStubs; CallStubIndex++)
         {
-            CallStub SecondCallStub;
+            FilePosition& StubPosition = Stubs.Positions[SelectedBox.CallStubs.First + CallStubIndex];
+            uint32_t ColumnOffset;
 
-            SecondCallStub = std::get<CallStub>(SecondStub);
-            if (FirstCallStub.Position.Column == SecondCallStub.Position.Column)
-            {
-                Overlaps = true;
-            }
-            else if (FirstCallStub.Position.Column == (SecondCallStub.Position.Column - 1u))
-            {
-                Overlaps = true;
-            }
-            else if (FirstCallStub.Position.Column == (SecondCallStub.Position.Column + 1u))
-            {
-                Overlaps = true;
-            }
+            ColumnOffset = CallInterfaceDivisionWidth * (1u + CallStubIndex);
+            StubPosition.Column = SelectedBox.Center.Column;
+            StubPosition.Row = SelectedBox.Center.Row + (SelectedBox.Height / 2u);
+            StubPosition.Column = StubPosition.Column + ColumnOffset;
+            Stubs.Lengths[SelectedBox.CallStubs.First + CallStubIndex] = 4u;
         }
     }
-
-    return Overlaps;
 }
 
-void ShiftInputStubs(ActivityDiagram& Diagram)
+// Looks up the box stubs of FirstKind or SecondKind that refer to NameID, keeping the one on the
+// box that comes first and the last one within that box, whose stub IDs ascend. OwnNameOnly skips stubs that refer to
+// the name only through one of their sources.
+void MatchInnerStubs(const ActivityDiagram& Diagram,
+    uint32_t NameID,
+    Interface FirstKind,
+    Interface SecondKind,
+    bool OwnNameOnly,
+    uint32_t& FoundStubID,
+    uint32_t& FoundBoxIndex,
+    bool& FoundFlag)
 {
-    uint32_t NumInputStubs;
+    const StubTable& Stubs = Diagram.Stubs;
+    const StubCrossReference& CrossReference = Diagram.CrossReference;
 
-    NumInputStubs = Diagram.InputBoundaryStubs.size();
-    for (uint32_t InputStubIndex = 0u; InputStubIndex < NumInputStubs; InputStubIndex++)
+    for (uint32_t ReferenceIndex = CrossReference.FirstReferences[NameID]; ReferenceIndex < CrossReference.FirstReferences[NameID + 1u]; ReferenceIndex++)
     {
-        for (uint32_t OtherInputStubIndex = 0u; OtherInputStubIndex < NumInputStubs; OtherInputStubIndex++)
-        {
-            if (InputStubIndex != OtherInputStubIndex)
-            {
-                InputStub FirstStub;
-                InputStub SecondStub;
+        uint32_t StubID;
+        uint32_t BoxIndex;
 
-                FirstStub = std::get<InputStub>(Diagram.InputBoundaryStubs[InputStubIndex]);
-                SecondStub = std::get<InputStub>(Diagram.InputBoundaryStubs[OtherInputStubIndex]);
-                for (uint32_t RowOffset = FirstStub.Position.Row; RowOffset > 0u; RowOffset--)
-                {
-                    if (CheckStubOverlap(FirstStub, SecondStub))
-                    {
-                        FirstStub.Position.Row--;
-                    }
-                }
-                if (CheckStubOverlap(FirstStub, SecondStub))
-                {
-                    throw std::runtime_error("Could not shift input boundary stubs.");
-                }
-                Diagram.InputBoundaryStubs[InputStubIndex] = FirstStub;
-            }
+        StubID = CrossReference.ReferenceStubIDs[ReferenceIndex];
+        BoxIndex = CrossReference.ReferenceBoxes[ReferenceIndex];
+        if ((BoxIndex == BoundaryStubOwner) || ((Stubs.Kinds[StubID] != FirstKind) && (Stubs.Kinds[StubID] != SecondKind)) ||
+            ((OwnNameOnly == true) && (CrossReference.ThroughSource[ReferenceIndex] == true)))
+        {
+            continue;
+        }
+        if ((FoundFlag == false) || (BoxIndex < FoundBoxIndex) || ((BoxIndex == FoundBoxIndex) && (StubID > FoundStubID)))
+        {
+            FoundStubID = StubID;
+            FoundBoxIndex = BoxIndex;
+            FoundFlag = true;
         }
     }
 }
 
-void ShiftOutputStubs(ActivityDiagram& Diagram)
+// Finds the stub of the first box that a boundary stub connects to. Boundary inputs and controls
+// may land on either box interface, the other kinds only on their own. Inputs, controls and
+// mechanisms match box stubs naming the boundary stub or listing it as a source, outputs and
+// calls match box stubs named after the boundary stub or one of its sources.
+void FindInnerStub(const ActivityDiagram& Diagram, uint32_t BoundaryStubID, uint32_t& FoundStubID, bool& FoundFlag)
 {
-    uint32_t NumOutputStubs;
+    const StubTable& Stubs = Diagram.Stubs;
+    Interface BoundaryKind;
+    uint32_t FoundBoxIndex;
 
-    NumOutputStubs = Diagram.OutputBoundaryStubs.size();
-    for (uint32_t OutputStubIndex = 0u; OutputStubIndex < NumOutputStubs; OutputStubIndex++)
+    FoundFlag = false;
+    FoundBoxIndex = 0u;
+    BoundaryKind = Stubs.Kinds[BoundaryStubID];
+    if ((BoundaryKind == InputInterface) || (BoundaryKind == ControlInterface))
+    {
+        MatchInnerStubs(Diagram, Stubs.NameIDs[BoundaryStubID], InputInterface, ControlInterface, false, FoundStubID, FoundBoxIndex, FoundFlag);
+    }
+    else if (BoundaryKind == MechanismInterface)
+    {
+        MatchInnerStubs(Diagram, Stubs.NameIDs[BoundaryStubID], MechanismInterface, MechanismInterface, false, FoundStubID, FoundBoxIndex, FoundFlag);
+    }
+    else
     {
-        for (uint32_t OtherOutputStubIndex = 0u; OtherOutputStubIndex < NumOutputStubs; OtherOutputStubIndex++)
+        MatchInnerStubs(Diagram, Stubs.NameIDs[BoundaryStubID], BoundaryKind, BoundaryKind, true, FoundStubID, FoundBoxIndex, FoundFlag);
+        for (uint32_t SourceIndex = Stubs.FirstSources[BoundaryStubID]; SourceIndex < Stubs.FirstSources[BoundaryStubID + 1u]; SourceIndex++)
         {
-            if (OutputStubIndex != OtherOutputStubIndex)
-            {
-                OutputStub FirstStub;
-                OutputStub SecondStub;
-
-                FirstStub = std::get<OutputStub>(Diagram.OutputBoundaryStubs[OutputStubIndex]);
-                SecondStub = std::get<OutputStub>(Diagram.OutputBoundaryStubs[OtherOutputStubIndex]);
-                for (uint32_t RowOffset = FirstStub.Position.Row; RowOffset > 0u; RowOffset--)
-                {
-                    if (CheckStubOverlap(FirstStub, SecondStub))
-                    {
-                        FirstStub.Position.Row--;
-                    }
-                }
-                if (CheckStubOverlap(FirstStub, SecondStub))
-                {
-                    throw std::runtime_error("Could not shift output boundary stubs.");
-                }
-                Diagram.OutputBoundaryStubs[OutputStubIndex] = FirstStub;
-            }
+            MatchInnerStubs(Diagram, Stubs.SourceNameIDs[SourceIndex], BoundaryKind, BoundaryKind, true, FoundStubID, FoundBoxIndex, FoundFlag);
         }
     }
 }
 
-void ShiftControlStubs(ActivityDiagram& Diagram)
+// Boundary stubs of one edge overlap when they are on the same or adjacent rows or columns, so
+// each is given a slot two past its neighbour. Inputs and outputs only ever move up the frame,
+// controls and mechanisms only right, so the stubs are swept from the far end of that direction:
+// each keeps its own coordinate if it is clear of the stub before it and otherwise takes the
+// nearest clear slot. Of stubs on the same coordinate the later one stays. Slots holds the new
+// coordinate of every stub of the range, and false is returned if they do not fit: shifted up no
+// slot may be above the row Limit, shifted right no label may reach past the column Limit.
+bool SlotBoundaryStubs(const StubTable& Stubs, const StubRange& BoundaryStubs, bool ShiftUp, uint32_t Limit,
+    std::vector<uint32_t>& Slots)
 {
-    uint32_t NumControlStubs;
+    std::vector<uint32_t> SortedStubIDs;
+    bool Fits;
 
-    NumControlStubs = Diagram.ControlBoundaryStubs.size();
-    for (uint32_t ControlStubIndex = 0u; ControlStubIndex < NumControlStubs; ControlStubIndex++)
+    Slots.resize(BoundaryStubs.End - BoundaryStubs.First);
+    for (uint32_t StubID = BoundaryStubs.First; StubID < BoundaryStubs.End; StubID++)
     {
-        for (uint32_t OtherControlStubIndex = 0u; OtherControlStubIndex < NumControlStubs; OtherControlStubIndex++)
-        {
-            if (ControlStubIndex != OtherControlStubIndex)
-            {
-                ControlStub FirstStub;
-                ControlStub SecondStub;
-
-                FirstStub = std::get<ControlStub>(Diagram.ControlBoundaryStubs[ControlStubIndex]);
-                SecondStub = std::get<ControlStub>(Diagram.ControlBoundaryStubs[OtherControlStubIndex]);
-                for (uint32_t ColumnOffset = FirstStub.Position.Column; ColumnOffset < Diagram.Width; ColumnOffset++)
-                {
-                    if (CheckStubOverlap(FirstStub, SecondStub))
-                    {
-                        FirstStub.Position.Column++;
-                    }
-                }
-                if (CheckStubOverlap(FirstStub, SecondStub))
-                {
-                    throw std::runtime_error("Could not shift control boundary stubs.");
-                }
-                Diagram.ControlBoundaryStubs[ControlStubIndex] = FirstStub;
-            }
-        }
+        Slots[StubID - BoundaryStubs.First] = (ShiftUp == true) ? Stubs.Positions[StubID].Row : Stubs.Positions[StubID].Column;
+        SortedStubIDs.push_back(StubID);
     }
-}
-
-void ShiftMechanismStubs(ActivityDiagram& Diagram)
-{
-    uint32_t NumMechanismStubs;
+    std::sort(SortedStubIDs.begin(), SortedStubIDs.end(), [&](uint32_t FirstStubID, uint32_t SecondStubID)
+    {
+        uint32_t FirstSlot = Slots[FirstStubID - BoundaryStubs.First];
+        uint32_t SecondSlot = Slots[SecondStubID - BoundaryStubs.First];
 
-    NumMechanismStubs = Diagram.MechanismBoundaryStubs.size();
-    for (uint32_t MechanismStubIndex = 0u; MechanismStubIndex < NumMechanismStubs; MechanismStubIndex++)
+        if (FirstSlot != SecondSlot)
+        {
+            return (ShiftUp == true) ? (FirstSlot > SecondSlot) : (FirstSlot < SecondSlot);
+        }
+        return FirstStubID > SecondStubID;
+    });
+    Fits = true;
+    for (uint32_t SortedIndex = 1u; SortedIndex < SortedStubIDs.size(); SortedIndex++)
     {
-        for (uint32_t OtherMechanismStubIndex = 0u; OtherMechanismStubIndex < NumMechanismStubs; OtherMechanismStubIndex++)
+        uint32_t PreviousSlot = Slots[SortedStubIDs[SortedIndex - 1u] - BoundaryStubs.First];
+        uint32_t& Slot = Slots[SortedStubIDs[SortedIndex] - BoundaryStubs.First];
+
+        if (ShiftUp == true)
         {
-            if (MechanismStubIndex != OtherMechanismStubIndex)
+            if (PreviousSlot < (Limit + 2u))
             {
-                MechanismStub FirstStub;
-                MechanismStub SecondStub;
+                Fits = false;
+                break;
+            }
+            Slot = std::min(Slot, PreviousSlot - 2u);
+        }
+        else
+        {
+            uint64_t LabelEnd;
 
-                FirstStub = std::get<MechanismStub>(Diagram.MechanismBoundaryStubs[MechanismStubIndex]);
-                SecondStub = std::get<MechanismStub>(Diagram.MechanismBoundaryStubs[OtherMechanismStubIndex]);
-                for (uint32_t MechanismOffset = FirstStub.Position.Column; MechanismOffset < Diagram.Width; MechanismOffset++)
-                {
-                    if (CheckStubOverlap(FirstStub, SecondStub))
-                    {
-                        FirstStub.Position.Column++;
-                    }
-                }
-                if (CheckStubOverlap(FirstStub, SecondStub))
-                {
-                    throw std::runtime_error("Could not shift mechanism boundary stubs.");
-                }
-                Diagram.MechanismBoundaryStubs[MechanismStubIndex] = FirstStub;
+            Slot = std::max<uint64_t>(Slot, (uint64_t)PreviousSlot + 2u);
+            LabelEnd = (uint64_t)Slot + Stubs.Names[SortedStubIDs[SortedIndex]].length();
+            if (LabelEnd > Limit)
+            {
+                Fits = false;
+                break;
             }
         }
     }
+
+    return Fits;
 }
 
+// Every edge is slotted before any stub is moved, so a diagram with too many boundary stubs is
+// rejected as a whole. Input and output labels sit on the row above their stub, so the highest
+// slot is the second row inside the frame. Control and mechanism labels run right of their stub
+// and stop short of the frame's right border.
 void ShiftBoundaryStubs(ActivityDiagram &Diagram)
 {
-    ShiftInputStubs(Diagram);
-    ShiftOutputStubs(Diagram);
-    ShiftControlStubs(Diagram);
-    ShiftMechanismStubs(Diagram);
+    StubTable& Stubs = Diagram.Stubs;
+    std::vector<uint32_t> InputSlots;
+    std::vector<uint32_t> OutputSlots;
+    std::vector<uint32_t> ControlSlots;
+    std::vector<uint32_t> MechanismSlots;
+
+    if (SlotBoundaryStubs(Stubs, Diagram.InputBoundaryStubs, true, 2u, InputSlots) == false)
+    {
+        throw std::runtime_error("The diagram is not tall enough to separate its " +
+            std::to_string(InputSlots.size()) + " input boundary stubs.");
+    }
+    if (SlotBoundaryStubs(Stubs, Diagram.OutputBoundaryStubs, true, 2u, OutputSlots) == false)
+    {
+        throw std::runtime_error("The diagram is not tall enough to separate its " +
+            std::to_string(OutputSlots.size()) + " output boundary stubs.");
+    }
+    if (SlotBoundaryStubs(Stubs, Diagram.ControlBoundaryStubs, false, Diagram.Width - 2u, ControlSlots) == false)
+    {
+        throw std::runtime_error("The diagram is not wide enough to separate its " +
+            std::to_string(ControlSlots.size()) + " control boundary stubs and their labels.");
+    }
+    if (SlotBoundaryStubs(Stubs, Diagram.MechanismBoundaryStubs, false, Diagram.Width - 2u, MechanismSlots) == false)
+    {
+        throw std::runtime_error("The diagram is not wide enough to separate its " +
+            std::to_string(MechanismSlots.size()) + " mechanism boundary stubs and their labels.");
+    }
+    for (uint32_t StubID = Diagram.InputBoundaryStubs.First; StubID < Diagram.InputBoundaryStubs.End; StubID++)
+    {
+        Stubs.Positions[StubID].Row = InputSlots[StubID - Diagram.InputBoundaryStubs.First];
+    }
+    for (uint32_t StubID = Diagram.OutputBoundaryStubs.First; StubID < Diagram.OutputBoundaryStubs.End; StubID++)
+    {
+        Stubs.Positions[StubID].Row = OutputSlots[StubID - Diagram.OutputBoundaryStubs.First];
+    }
+    for (uint32_t StubID = Diagram.ControlBoundaryStubs.First; StubID < Diagram.ControlBoundaryStubs.End; StubID++)
+    {
+        Stubs.Positions[StubID].Column = ControlSlots[StubID - Diagram.ControlBoundaryStubs.First];
+    }
+    for (uint32_t StubID = Diagram.MechanismBoundaryStubs.First; StubID < Diagram.MechanismBoundaryStubs.End; StubID++)
+    {
+        Stubs.Positions[StubID].Column = MechanismSlots[StubID - Diagram.MechanismBoundaryStubs.First];
+    }
 }
 
-void LayoutBoundaryStubs(ActivityDiagram &Diagram, uint32_t BoxWidth, uint32_t BoxHeight, uint32_t BoxXGap, uint32_t BoxYGap)
+// Boundary stubs without an inner stub are spread along their edge in steps of the box section's
+// size over one more than the number of boxes.
+void LayoutBoundaryStubs(ActivityDiagram &Diagram, uint32_t BoxSectionWidth, uint32_t BoxSectionHeight)
 {
-    uint32_t BoxSectionHeight;
-    uint32_t BoxSectionWidth;
+    StubTable& Stubs = Diagram.Stubs;
     uint32_t RowHeight;
     uint32_t ColumnWidth;
     uint32_t NumBoxes;
     uint32_t StubIndex;
-    uint32_t ColumnCenterOffset;
-    uint32_t RowCenterOffset;
     
     NumBoxes = Diagram.Boxes.size();
-    BoxSectionHeight = (NumBoxes * BoxHeight) + ((NumBoxes - 1u) * BoxYGap);
-    BoxSectionWidth = (NumBoxes * BoxWidth) + ((NumBoxes - 1u) * BoxXGap);
     RowHeight = BoxSectionHeight / (1u + NumBoxes);
     ColumnWidth = BoxSectionWidth / (1u + NumBoxes);
-    ColumnCenterOffset = (Diagram.Width / 2u) - (BoxSectionWidth / 2u);
-    RowCenterOffset = (Diagram.Height / 2u) - (BoxSectionHeight / 2u);
     StubIndex = 0u;
-    for (Stub& BoundaryStub : Diagram.InputBoundaryStubs)
+    for (uint32_t BoundaryStubID = Diagram.InputBoundaryStubs.First; BoundaryStubID < Diagram.InputBoundaryStubs.End; BoundaryStubID++)
     {
-        Stub FoundStub;
+        FilePosition& BoundaryPosition = Stubs.Positions[BoundaryStubID];
+        uint32_t FoundStubID;
         bool FoundFlag;
-        InputStub& BoundaryInputStub = std::get<InputStub>(BoundaryStub);
 
-        FindInnerStub(Diagram, BoundaryStub, FoundStub, FoundFlag);
+        FindInnerStub(Diagram, BoundaryStubID, FoundStubID, FoundFlag);
         if (FoundFlag)
         {
-            if (std::holds_alternative<InputStub>(FoundStub))
+            if (Stubs.Kinds[FoundStubID] == InputInterface)
             {
-                InputStub& FoundInputStub = std::get<InputStub>(FoundStub);
-
-                BoundaryInputStub.Position.Row = FoundInputStub.Position.Row;
-                BoundaryInputStub.Position.Column = 0u;
+                BoundaryPosition.Row = Stubs.Positions[FoundStubID].Row;
+                BoundaryPosition.Column = 0u;
             }
-            else if (std::holds_alternative<ControlStub>(FoundStub))
+            else if (Stubs.Kinds[FoundStubID] == ControlInterface)
             {
-                ControlStub& FoundControlStub = std::get<ControlStub>(FoundStub);
-
-                BoundaryInputStub.Position.Row = FoundControlStub.Position.Row - FoundControlStub.Length;
-                BoundaryInputStub.Position.Column = 0u;
+                BoundaryPosition.Row = CheckCoordinate((LayoutCoordinate)Stubs.Positions[FoundStubID].Row - Stubs.Lengths[FoundStubID],
+                    Diagram.Height, "Input boundary stub '" + std::string(Stubs.Names[BoundaryStubID]) + "'");
+                BoundaryPosition.Column = 0u;
             }
         }
         else
         {
-            BoundaryInputStub.Position.Column = 0u;
-            BoundaryInputStub.Position.Row = (1u+StubIndex) * RowHeight;
+            BoundaryPosition.Column = 0u;
+            BoundaryPosition.Row = (1u+StubIndex) * RowHeight;
         }
         StubIndex++;
     }
     StubIndex = 0u;
-    for (Stub& BoundaryStub : Diagram.ControlBoundaryStubs)
+    for (uint32_t BoundaryStubID = Diagram.ControlBoundaryStubs.First; BoundaryStubID < Diagram.ControlBoundaryStubs.End; BoundaryStubID++)
     {
-        Stub FoundStub;
+        FilePosition& BoundaryPosition = Stubs.Positions[BoundaryStubID];
+        uint32_t FoundStubID;
         bool FoundFlag;
-        ControlStub& BoundaryControlStub = std::get<ControlStub>(BoundaryStub);
 
-        FindInnerStub(Diagram, BoundaryStub, FoundStub, FoundFlag);
+        FindInnerStub(Diagram, BoundaryStubID, FoundStubID, FoundFlag);
         if (FoundFlag)
         {
-            if (std::holds_alternative<InputStub>(FoundStub))
+            if (Stubs.Kinds[FoundStubID] == InputInterface)
             {
-                InputStub& FoundInputStub = std::get<InputStub>(FoundStub);
-                
-                BoundaryControlStub.Position.Row = 0u;
-                BoundaryControlStub.Position.Column = FoundInputStub.Position.Column - FoundInputStub.Length;
+                BoundaryPosition.Row = 0u;
+                BoundaryPosition.Column = CheckCoordinate((LayoutCoordinate)Stubs.Positions[FoundStubID].Column - Stubs.Lengths[FoundStubID],
+                    Diagram.Width, "Control boundary stub '" + std::string(Stubs.Names[BoundaryStubID]) + "'");
             }
-            else if (std::holds_alternative<ControlStub>(FoundStub))
+            else if (Stubs.Kinds[FoundStubID] == ControlInterface)
             {
-                ControlStub& FoundControlStub = std::get<ControlStub>(FoundStub);
-
-                BoundaryControlStub.Position.Row = 0u;
-                BoundaryControlStub.Position.Column = FoundControlStub.Position.Column;
+                BoundaryPosition.Row = 0u;
+                BoundaryPosition.Column = Stubs.Positions[FoundStubID].Column;
             }
         }
         else
         {
-            BoundaryControlStub.Position.Column = (1u+StubIndex) * ColumnWidth;
-            BoundaryControlStub.Position.Row = 0u;
+            BoundaryPosition.Column = (1u+StubIndex) * ColumnWidth;
+            BoundaryPosition.Row = 0u;
         }
         StubIndex++;
     }
     StubIndex = 0u;
-    for (Stub& BoundaryStub : Diagram.OutputBoundaryStubs)
+    for (uint32_t BoundaryStubID = Diagram.OutputBoundaryStubs.First; BoundaryStubID < Diagram.OutputBoundaryStubs.End; BoundaryStubID++)
     {
-        Stub FoundStub;
+        FilePosition& BoundaryPosition = Stubs.Positions[BoundaryStubID];
+        uint32_t FoundStubID;
         bool FoundFlag;
-        OutputStub& BoundaryOutputStub = std::get<OutputStub>(BoundaryStub);
 
-        FindInnerStub(Diagram, BoundaryStub, FoundStub, FoundFlag);
+        FindInnerStub(Diagram, BoundaryStubID, FoundStubID, FoundFlag);
         if (FoundFlag)
         {
-            if (std::holds_alternative<OutputStub>(FoundStub))
-            {
-                OutputStub& FoundOutputStub = std::get<OutputStub>(FoundStub);
-                
-                BoundaryOutputStub.Position.Row = FoundOutputStub.Position.Row;
-                BoundaryOutputStub.Position.Column = Diagram.Width - 1u;
-            }
+            BoundaryPosition.Row = Stubs.Positions[FoundStubID].Row;
+            BoundaryPosition.Column = Diagram.Width - 1u;
         }
         else
         {
-            BoundaryOutputStub.Position.Column = Diagram.Width - 1u;
-            BoundaryOutputStub.Position.Row = (1u+StubIndex) * RowHeight;
+            BoundaryPosition.Column = Diagram.Width - 1u;
+            BoundaryPosition.Row = (1u+StubIndex) * RowHeight;
         }
         StubIndex++;
     }
     StubIndex = 0u;
-    for (Stub& BoundaryStub : Diagram.MechanismBoundaryStubs)
+    for (uint32_t BoundaryStubID = Diagram.MechanismBoundaryStubs.First; BoundaryStubID < Diagram.MechanismBoundaryStubs.End; BoundaryStubID++)
     {
-        Stub FoundStub;
+        FilePosition& BoundaryPosition = Stubs.Positions[BoundaryStubID];
+        uint32_t FoundStubID;
         bool FoundFlag;
-        MechanismStub& BoundaryMechanismStub = std::get<MechanismStub>(BoundaryStub);
 
-        FindInnerStub(Diagram, BoundaryStub, FoundStub, FoundFlag);
+        FindInnerStub(Diagram, BoundaryStubID, FoundStubID, FoundFlag);
         if (FoundFlag)
         {
-            if (std::holds_alternative<MechanismStub>(FoundStub))
-            {
-                MechanismStub& FoundMechanismStub = std::get<MechanismStub>(FoundStub);
-                
-                BoundaryMechanismStub.Position.Row = Diagram.Height - 1u - Diagram.Frame.BottomBar.Height;
-                BoundaryMechanismStub.Position.Column = FoundMechanismStub.Position.Column;
-            }
+            BoundaryPosition.Row = Diagram.Height - 1u - Diagram.Frame.BottomBar.Height;
+            BoundaryPosition.Column = Stubs.Positions[FoundStubID].Column;
         }
         else
         {
-            BoundaryMechanismStub.Position.Column = (1u+StubIndex) * ColumnWidth;
-            BoundaryMechanismStub.Position.Row = Diagram.Height - 1u - Diagram.Frame.BottomBar.Height;
+            BoundaryPosition.Column = (1u+StubIndex) * ColumnWidth;
+            BoundaryPosition.Row = Diagram.Height - 1u - Diagram.Frame.BottomBar.Height;
         }
         StubIndex++;
     }
 }
 
+// Each boundary stub is lengthened by one for every stub of its kind above or to the left of
+// it, so their labels do not share a row or column.
 void ChangeBoundaryStubLengths(ActivityDiagram& Diagram)
 {
-    uint32_t NumControlStubs;
-    uint32_t NumOutputStubs;
-    uint32_t NumMechanismStubs;
-    uint32_t NumInputStubs;
-
-    NumInputStubs = Diagram.InputBoundaryStubs.size();
-    NumOutputStubs = Diagram.OutputBoundaryStubs.size();
-    NumControlStubs = Diagram.ControlBoundaryStubs.size();
-    NumMechanismStubs = Diagram.MechanismBoundaryStubs.size();
-    for (uint32_t I = 0u; I < NumInputStubs; I++)
-    {
-        InputStub InputBoundaryStub;
+    StubTable& Stubs = Diagram.Stubs;
+
+    for (uint32_t I = Diagram.InputBoundaryStubs.First; I < Diagram.InputBoundaryStubs.End; I++)
+    {
         uint32_t StubsAbove;
 
         StubsAbove = 0u;
-        InputBoundaryStub = std::get<InputStub>(Diagram.InputBoundaryStubs[I]);
-        for (uint32_t K = 0u; K < NumInputStubs; K++)
+        for (uint32_t K = Diagram.InputBoundaryStubs.First; K < Diagram.InputBoundaryStubs.End; K++)
         {
-            if (I == K)
+            if ((I != K) && (Stubs.Positions[K].Row < Stubs.Positions[I].Row))
             {
-                continue;
-            }
-            else
-            {
-                InputStub OtherInputBoundaryStub;
-
-                OtherInputBoundaryStub = std::get<InputStub>(Diagram.InputBoundaryStubs[K]);
-                if (OtherInputBoundaryStub.Position.Row < InputBoundaryStub.Position.Row)
-                {
-                    StubsAbove++;
-                }
+                StubsAbove++;
             }
         }
-        InputBoundaryStub.Length = 3u + StubsAbove;
-        Diagram.InputBoundaryStubs[I] = InputBoundaryStub;
+        Stubs.Lengths[I] = 3u + StubsAbove;
     }
-    for (uint32_t I = 0u; I < NumOutputStubs; I++)
+    for (uint32_t I = Diagram.OutputBoundaryStubs.First; I < Diagram.OutputBoundaryStubs.End; I++)
     {
-        OutputStub OutputBoundaryStub;
         uint32_t StubsAbove;
 
         StubsAbove = 0u;
-        OutputBoundaryStub = std::get<OutputStub>(Diagram.OutputBoundaryStubs[I]);
-        for (uint32_t K = 0u; K < NumOutputStubs; K++)
+        for (uint32_t K = Diagram.OutputBoundaryStubs.First; K < Diagram.OutputBoundaryStubs.End; K++)
         {
-            if (I == K)
-            {
-                continue;
-            }
-            else
+            if ((I != K) && (Stubs.Positions[K].Row < Stubs.Positions[I].Row))
             {
-                OutputStub OtherOutputBoundaryStub;
-
-                OtherOutputBoundaryStub = std::get<OutputStub>(Diagram.OutputBoundaryStubs[K]);
-                if (OtherOutputBoundaryStub.Position.Row < OutputBoundaryStub.Position.Row)
-                {
-                    StubsAbove++;
-                }
+                StubsAbove++;
             }
         }
-        OutputBoundaryStub.Length = 3u + StubsAbove;
-        Diagram.OutputBoundaryStubs[I] = OutputBoundaryStub;
+        Stubs.Lengths[I] = 3u + StubsAbove;
     }
-    for (uint32_t I = 0u; I < NumControlStubs; I++)
+    for (uint32_t I = Diagram.ControlBoundaryStubs.First; I < Diagram.ControlBoundaryStubs.End; I++)
     {
-        ControlStub ControlBoundaryStub;
         uint32_t StubsLeftwards;
 
         StubsLeftwards = 0u;
-        ControlBoundaryStub = std::get<ControlStub>(Diagram.ControlBoundaryStubs[I]);
-        for (uint32_t K = 0u; K < NumControlStubs; K++)
+        for (uint32_t K = Diagram.ControlBoundaryStubs.First; K < Diagram.ControlBoundaryStubs.End; K++)
         {
-            if (I == K)
-            {
-                continue;
-            }
-            else
+            if ((I != K) && (Stubs.Positions[K].Column < Stubs.Positions[I].Column))
             {
-                ControlStub OtherControlBoundaryStub;
-
-                OtherControlBoundaryStub = std::get<ControlStub>(Diagram.ControlBoundaryStubs[K]);
-                if (OtherControlBoundaryStub.Position.Column < ControlBoundaryStub.Position.Column)
-                {
-                    StubsLeftwards++;
-                }
+                StubsLeftwards++;
             }
         }
-        ControlBoundaryStub.Length = 3u + StubsLeftwards;
-        Diagram.ControlBoundaryStubs[I] = ControlBoundaryStub;
+        Stubs.Lengths[I] = 3u + StubsLeftwards;
     }
-    for (uint32_t I = 0u; I < NumMechanismStubs; I++)
+    for (uint32_t I = Diagram.MechanismBoundaryStubs.First; I < Diagram.MechanismBoundaryStubs.End; I++)
     {
-        MechanismStub MechanismBoundaryStub;
         uint32_t StubsLeftwards;
 
         StubsLeftwards = 0u;
-        MechanismBoundaryStub = std::get<MechanismStub>(Diagram.MechanismBoundaryStubs[I]);
-        for (uint32_t K = 0u; K < NumMechanismStubs; K++)
+        for (uint32_t K = Diagram.MechanismBoundaryStubs.First; K < Diagram.MechanismBoundaryStubs.End; K++)
         {
-            if (I == K)
+            if ((I != K) && (Stubs.Positions[K].Column < Stubs.Positions[I].Column))
             {
-                continue;
+                StubsLeftwards++;
             }
-            else
-            {
-                MechanismStub OtherMechanismBoundaryStub;
+        }
+        Stubs.Lengths[I] = 3u + StubsLeftwards;
+    }
+}
 
-                OtherMechanismBoundaryStub = std::get<MechanismStub>(Diagram.MechanismBoundaryStubs[K]);
-                if (OtherMechanismBoundaryStub.Position.Column < MechanismBoundaryStub.Position.Column)
-                {
-                    StubsLeftwards++;
-                }
-            }
+// A label is one row of text. Where drawing looks for other text in the two cells before a
+// label, FirstColumn includes them.
+void CheckLabelBounds(const ActivityDiagram& Diagram, LayoutCoordinate Row, LayoutCoordinate FirstColumn,
+    LayoutCoordinate LastColumn, const std::string& What)
+{
+    CheckCoordinate(Row, Diagram.Height, What);
+    CheckCoordinate(FirstColumn, Diagram.Width, What);
+    CheckCoordinate(LastColumn, Diagram.Width, What);
+}
+
+// A bottom bar section draws its right border down all of its rows and its caption, then its
+// content, along its second row.
+template <typename SectionType>
+void CheckSectionBounds(const ActivityDiagram& Diagram, const DiagramSection& Section, uint32_t CaptionLength,
+    const std::string& What)
+{
+    const SectionType& TypedSection = std::get<SectionType>(Section);
+    LayoutCoordinate Row = TypedSection.TopLeft.Row;
+    LayoutCoordinate Column = TypedSection.TopLeft.Column;
+
+    if (TypedSection.Height < 2u)
+    {
+        throw std::runtime_error(What + " is too short for its caption.");
+    }
+    CheckCoordinate(Row + TypedSection.Height - 1, Diagram.Height, What);
+    CheckCoordinate(Column + TypedSection.Width, Diagram.Width, What);
+    CheckLabelBounds(Diagram, Row + 1, Column + 1, Column + CaptionLength + (LayoutCoordinate)TypedSection.Content.length(), What + "'s text");
+}
+
+// Checks the bottom bar, every box, stub, the far end of each stub's line and every label where it
+// is first placed against the diagram before anything is placed or drawn from them, as the raster
+// only bounds checks its cells in debug builds. Box stubs reach away from their box and boundary
+// stubs into the frame. Box stub labels sit beside the stub's outer end, boundary stub labels
+// beside the stub on the frame's side.
+void CheckLayoutBounds(const ActivityDiagram& Diagram)
+{
+    const StubTable& Stubs = Diagram.Stubs;
+    uint32_t NumBoxes;
+
+    CheckCoordinate(Diagram.Frame.BottomBar.TopLeft.Row, Diagram.Height, "The bottom bar");
+    CheckCoordinate(Diagram.Frame.BottomBar.TopLeft.Column, Diagram.Width, "The bottom bar");
+    CheckSectionBounds<NodeNumberSection>(Diagram, Diagram.Frame.BottomBar.NodeNumberSection, 5u, "The node number section");
+    CheckSectionBounds<TitleSection>(Diagram, Diagram.Frame.BottomBar.TitleSection, 6u, "The title section");
+    CheckSectionBounds<CNumberSection>(Diagram, Diagram.Frame.BottomBar.CNumberSection, 8u, "The C-number section");
+
+    NumBoxes = Diagram.Boxes.size();
+    for (uint32_t BoxIndex = 0u; BoxIndex < NumBoxes; BoxIndex++)
+    {
+        const ActivityBox& SelectedBox = Diagram.Boxes[BoxIndex];
+        std::string BoxName = "Box " + std::to_string(BoxIndex + 1u);
+        LayoutCoordinate TextWidth;
+        LayoutCoordinate NameLines;
+
+        CheckCoordinate((LayoutCoordinate)SelectedBox.Center.Column - (SelectedBox.Width / 2u), Diagram.Width, BoxName + "'s left edge");
+        CheckCoordinate((LayoutCoordinate)SelectedBox.Center.Column + (SelectedBox.Width / 2u), Diagram.Width, BoxName + "'s right edge");
+        CheckCoordinate((LayoutCoordinate)SelectedBox.Center.Row - (SelectedBox.Height / 2u), Diagram.Height, BoxName + "'s top edge");
+        CheckCoordinate((LayoutCoordinate)SelectedBox.Center.Row + (SelectedBox.Height / 2u), Diagram.Height, BoxName + "'s bottom edge");
+        TextWidth = (LayoutCoordinate)SelectedBox.Width - (2u * SelectedBox.Padding);
+        if (TextWidth < 1)
+        {
+            throw std::runtime_error(BoxName + " is too narrow for its name.");
+        }
+        NameLines = (LayoutCoordinate)SelectedBox.Name.length() / TextWidth;
+        CheckCoordinate((LayoutCoordinate)SelectedBox.Center.Row - (NameLines / 2) + NameLines, Diagram.Height, BoxName + "'s name");
+        CheckCoordinate((LayoutCoordinate)SelectedBox.Center.Column + (SelectedBox.Width / 2u) - 1 - (LayoutCoordinate)SelectedBox.NodeNumber.length(),
+            Diagram.Width, BoxName + "'s number");
+    }
+    for (uint32_t StubID = 0u; StubID < Diagram.NumStubs; StubID++)
+    {
+        LayoutCoordinate Row = Stubs.Positions[StubID].Row;
+        LayoutCoordinate Column = Stubs.Positions[StubID].Column;
+        LayoutCoordinate Length = Stubs.Lengths[StubID];
+        LayoutCoordinate NameLength = Stubs.Names[StubID].length();
+        std::string StubName = "Stub '" + std::string(Stubs.Names[StubID]) + "'";
+        bool Boundary = (Stubs.OwnerBoxes[StubID] == BoundaryStubOwner);
+
+        CheckCoordinate(Row, Diagram.Height, StubName);
+        CheckCoordinate(Column, Diagram.Width, StubName);
+        if (Boundary == true)
+        {
+            Length = -Length;
+        }
+        if (Stubs.Kinds[StubID] == InputInterface)
+        {
+            CheckCoordinate(Column - Length, Diagram.Width, StubName + "'s end");
+        }
+        else if (Stubs.Kinds[StubID] == OutputInterface)
+        {
+            CheckCoordinate(Column + Length, Diagram.Width, StubName + "'s end");
+        }
+        else if (Stubs.Kinds[StubID] == ControlInterface)
+        {
+            CheckCoordinate(Row - Length, Diagram.Height, StubName + "'s end");
+        }
+        else
+        {
+            CheckCoordinate(Row + Length, Diagram.Height, StubName + "'s end");
+        }
+        if (NameLength == 0)
+        {
+            continue;
+        }
+        if ((Stubs.Kinds[StubID] == InputInterface) && (Boundary == true))
+        {
+            CheckLabelBounds(Diagram, Row - 1, Column + 1, Column + NameLength, StubName + "'s label");
+        }
+        else if (Stubs.Kinds[StubID] == InputInterface)
+        {
+            CheckLabelBounds(Diagram, Row - 1, Column - NameLength - 2, Column - 1, StubName + "'s label");
+        }
+        else if ((Stubs.Kinds[StubID] == OutputInterface) && (Boundary == true))
+        {
+            CheckLabelBounds(Diagram, Row - 1, Column - NameLength, Column - 1, StubName + "'s label");
+        }
+        else if (Stubs.Kinds[StubID] == OutputInterface)
+        {
+            CheckLabelBounds(Diagram, Row - 1, Column - 1, Column + NameLength, StubName + "'s label");
+        }
+        else if (Stubs.Kinds[StubID] == ControlInterface)
+        {
+            CheckLabelBounds(Diagram, (Boundary == true) ? (Row + 1) : (Row - 2), Column - 1, Column + NameLength, StubName + "'s label");
+        }
+        else
+        {
+            CheckLabelBounds(Diagram, (Boundary == true) ? (Row - 1) : (Row + 2), Column - 1, Column + NameLength, StubName + "'s label");
         }
-        MechanismBoundaryStub.Length = 3u + StubsLeftwards;
-        Diagram.MechanismBoundaryStubs[I] = MechanismBoundaryStub;
     }
 }
 
@@ -998,16 +1107,31 @@ void LayoutActivityDiagram(ActivityDiagram &LoadedDiagram,
     uint32_t BoxWidth, 
     uint32_t BoxHeight, 
     uint32_t BoxXGap, 
-    uint32_t BoxYGap)
+    uint32_t BoxYGap,
+    BoxLayout Layout)
 {
+    std::vector<uint32_t> BoxOrder;
+    uint32_t BoxSectionWidth;
+    uint32_t BoxSectionHeight;
+
     LoadedDiagram.Width = Width;
     LoadedDiagram.Height = Height;
     LayoutFrame(LoadedDiagram);
-    LayoutBoxes(LoadedDiagram, BoxWidth, BoxHeight, BoxXGap, BoxYGap);
+    OrderBoxes(LoadedDiagram, BoxOrder);
+    if (Layout == GridBoxLayout)
+    {
+        LayoutGridBoxes(LoadedDiagram, BoxWidth, BoxHeight, BoxXGap, BoxYGap, BoxOrder);
+    }
+    else
+    {
+        LayoutBoxes(LoadedDiagram, BoxWidth, BoxHeight, BoxXGap, BoxYGap, BoxOrder);
+    }
     LayoutBoxStubs(LoadedDiagram);
-    LayoutBoundaryStubs(LoadedDiagram, BoxWidth, BoxHeight, BoxXGap, BoxYGap);
+    MeasureBoxSection(LoadedDiagram.Boxes.size(), Layout, BoxWidth, BoxHeight, BoxXGap, BoxYGap, BoxSectionWidth, BoxSectionHeight);
+    LayoutBoundaryStubs(LoadedDiagram, BoxSectionWidth, BoxSectionHeight);
     ChangeBoundaryStubLengths(LoadedDiagram);
     ShiftBoundaryStubs(LoadedDiagram);
+    CheckLayoutBounds(LoadedDiagram);
 }
 
 }
\ No newline at end of file
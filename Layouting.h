@@ -4,12 +4,37 @@
 namespace IDEF
 {
 
+// How LayoutActivityDiagram places the boxes. The diagonal puts each box below and to the right
+// of the one before, the grid fills columns of boxes from the top left.
+enum BoxLayout
+{
+    DiagonalBoxLayout,
+    GridBoxLayout
+};
+
+// Layout geometry is worked out in 64 bits so the sums and differences of wall chart sizes cannot
+// wrap, and is narrowed back to a row or column by CheckCoordinate.
+typedef int64_t LayoutCoordinate;
+
+uint32_t CheckCoordinate(LayoutCoordinate Value, uint32_t Limit, const std::string& What);
 void LayoutFrame(ActivityDiagram &Diagram);
-void LayoutBoxes(ActivityDiagram &Diagram, uint32_t BoxWidth, uint32_t BoxHeight, uint32_t BoxXGap, uint32_t BoxYGap);
+void CenterBoxSection(const ActivityDiagram& Diagram, uint32_t BoxSectionWidth, uint32_t BoxSectionHeight,
+    uint32_t& ColumnCenterOffset, uint32_t& RowCenterOffset);
+void CountBoxCells(uint32_t NumBoxes, BoxLayout Layout, uint32_t& NumColumns, uint32_t& NumRows);
+void MeasureBoxSection(uint32_t NumBoxes, BoxLayout Layout, uint32_t BoxWidth, uint32_t BoxHeight, uint32_t BoxXGap, uint32_t BoxYGap,
+    uint32_t& BoxSectionWidth, uint32_t& BoxSectionHeight);
+void OrderBoxes(const ActivityDiagram& Diagram, std::vector<uint32_t>& BoxOrder);
+void LayoutBoxes(ActivityDiagram &Diagram, uint32_t BoxWidth, uint32_t BoxHeight, uint32_t BoxXGap, uint32_t BoxYGap,
+    const std::vector<uint32_t>& BoxOrder);
+void LayoutGridBoxes(ActivityDiagram &Diagram, uint32_t BoxWidth, uint32_t BoxHeight, uint32_t BoxXGap, uint32_t BoxYGap,
+    const std::vector<uint32_t>& BoxOrder);
 void LayoutBoxStubs(ActivityDiagram &Diagram);
-void FindInnerStub(const ActivityDiagram& Diagram, const Stub& BoundaryStub, Stub& FoundStub, bool& FoundFlag);
-void LayoutBoundaryStubs(ActivityDiagram &Diagram, uint32_t BoxWidth, uint32_t BoxHeight, uint32_t BoxXGap, uint32_t BoxYGap);
-void LayoutActivityDiagram(ActivityDiagram &LoadedDiagram, uint32_t Width, uint32_t Height, uint32_t BoxWidth, uint32_t BoxHeight, uint32_t BoxXGap, uint32_t BoxYGap); 
+void FindInnerStub(const ActivityDiagram& Diagram, uint32_t BoundaryStubID, uint32_t& FoundStubID, bool& FoundFlag);
+void CheckInterfaceDivisions(uint32_t BoxIndex, uint32_t NumStubs, uint32_t DivisionWidth, const char* KindName, const char* SizeName);
+void LayoutBoundaryStubs(ActivityDiagram &Diagram, uint32_t BoxSectionWidth, uint32_t BoxSectionHeight);
+void CheckLayoutBounds(const ActivityDiagram& Diagram);
+void LayoutActivityDiagram(ActivityDiagram &LoadedDiagram, uint32_t Width, uint32_t Height, uint32_t BoxWidth, uint32_t BoxHeight,
+    uint32_t BoxXGap, uint32_t BoxYGap, BoxLayout Layout);
 
 }
 
@@ -1,15 +1,28 @@
 #include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <cstring>
+#include <exception>
 #include <fstream>
 #include <iostream>
 #include <variant>
 #include <libavoid/libavoid.h>
 #include <map>
+#include <memory>
+#include <memory_resource>
 #include <pugixml.hpp>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
 #include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 #include "Loading.h"
 #include "Placing.h"
 #include "Drawing.h"
@@ -18,157 +31,545 @@
 namespace IDEF
 {
 
-InputStub LoadInputStub(const pugi::xml_node& InputStubXMLNode, bool Headed)
+// Documents are parsed in place, so attribute text stays in the document's buffer and is
+// referenced from there instead of being copied into every stub.
+std::string_view LoadAttributeText(const pugi::xml_node& XMLNode, const char* AttributeName)
 {
-    InputStub NewStub;
-    
-    NewStub.Name = InputStubXMLNode.attribute("Name").as_string();
-    for (const pugi::xml_node &StubSourceXMLNode : InputStubXMLNode.children())
-    {
-        StubSource NewStubSource;
+    const char* AttributeText;
 
-        NewStubSource.StubName = StubSourceXMLNode.attribute("Name").as_string();
-        NewStub.Sources.push_back(NewStubSource);
-    }
-    NewStub.Position.Row = 0u;
-    NewStub.Position.Column = 0u;
-    NewStub.Length = 0u;
-    NewStub.Headed = Headed;
+    AttributeText = XMLNode.attribute(AttributeName).as_string();
 
-    return NewStub;   
+    return std::string_view(AttributeText, strlen(AttributeText));
 }
 
-OutputStub LoadOutputStub(const pugi::xml_node& OutputStubXMLNode, bool Headed)
+// Names are interned per document, so every diagram of a model shares one set of name IDs and
+// later stages compare and index names by ID.
+uint32_t InternStubName(StubNameTable& NameTable, std::string_view Name)
 {
-    OutputStub NewStub;
+    StubNameTable::iterator FoundName;
+    uint32_t NameID;
 
-    NewStub.Name = OutputStubXMLNode.attribute("Name").as_string();
-    for (const pugi::xml_node &StubSourceXMLNode : OutputStubXMLNode.children())
+    FoundName = NameTable.find(Name);
+    if (FoundName == NameTable.end())
+    {
+        NameID = NameTable.size();
+        NameTable.insert({Name, NameID});
+    }
+    else
     {
-        StubSource NewStubSource;
+        NameID = FoundName->second;
+    }
+
+    return NameID;
+}
+
+std::shared_ptr<char> ReadSourceText(const std::string &FilePath, size_t& TextSize)
+{
+    std::ifstream SourceFileStream;
+    std::shared_ptr<char> SourceText;
 
-        NewStubSource.StubName = StubSourceXMLNode.attribute("Name").as_string();
-        NewStub.Sources.push_back(NewStubSource);
+    SourceFileStream.open(FilePath, std::ios_base::in | std::ios_base::binary | std::ios_base::ate);
+    if (SourceFileStream.is_open() == false)
+    {
+        throw std::runtime_error("Could not open the input file: " + FilePath);
     }
-    NewStub.Position.Row = 0u;
-    NewStub.Position.Column = 0u;
-    NewStub.Length = 0u;
-    NewStub.Headed = Headed;
+    TextSize = SourceFileStream.tellg();
+    SourceText = std::shared_ptr<char>(new char[TextSize + 1u], std::default_delete<char[]>());
+    SourceFileStream.seekg(0);
+    SourceFileStream.read(SourceText.get(), TextSize);
+    SourceText.get()[TextSize] = '\0';
 
-    return NewStub;   
+    return SourceText;
 }
 
-ControlStub LoadControlStub(const pugi::xml_node& ControlStubXMLNode, bool Headed)
+// Files of at least this size are mapped rather than read, below it the mapping costs more
+// than the copy it saves.
+const size_t MappedSourceMinimumSize = 1u << 20u;
+
+// Maps a large file copy-on-write so pugixml can parse it in place, only the pages the parser
+// writes its terminators into are copied and the rest stay backed by the page cache.
+std::shared_ptr<char> LoadSourceText(const std::string &FilePath, size_t& TextSize)
 {
-    ControlStub NewStub;
+#if defined(__unix__) || defined(__APPLE__)
+    int SourceFile;
+    struct stat SourceFileStatus;
+    void* Mapping;
+    size_t MappingSize;
+
+    SourceFile = open(FilePath.c_str(), O_RDONLY);
+    if (SourceFile < 0)
+    {
+        throw std::runtime_error("Could not open the input file: " + FilePath);
+    }
+    if ((fstat(SourceFile, &SourceFileStatus) != 0) || ((size_t)SourceFileStatus.st_size < MappedSourceMinimumSize))
+    {
+        close(SourceFile);
+        return ReadSourceText(FilePath, TextSize);
+    }
+    MappingSize = SourceFileStatus.st_size;
+    Mapping = mmap(nullptr, MappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, SourceFile, 0);
+    close(SourceFile);
+    if (Mapping == MAP_FAILED)
+    {
+        return ReadSourceText(FilePath, TextSize);
+    }
+    madvise(Mapping, MappingSize, MADV_SEQUENTIAL);
+    TextSize = MappingSize;
 
-    NewStub.Name = ControlStubXMLNode.attribute("Name").as_string();
-    for (const pugi::xml_node &StubSourceXMLNode : ControlStubXMLNode.children())
+    return std::shared_ptr<char>((char*)Mapping, [MappingSize](char* MappedText)
     {
-        StubSource NewStubSource;
+        munmap(MappedText, MappingSize);
+    });
+#else
+    return ReadSourceText(FilePath, TextSize);
+#endif
+}
+
+// Child tag names placed by their length, which differs for every name, so a child's kind is
+// found with one lookup and one compare. The stub kinds share their Interface values.
+enum ChildKind
+{
+    InputChild = InputInterface,
+    OutputChild = OutputInterface,
+    ControlChild = ControlInterface,
+    MechanismChild = MechanismInterface,
+    CallChild = CallInterface,
+    ActivityChild,
+    UnknownChild
+};
+
+struct ChildTag
+{
+    const char* Name;
+    uint32_t NameLength;
+    ChildKind Kind;
+};
+
+const ChildTag ChildTags[8u] =
+{
+    {"Activity", 8u, ActivityChild},
+    {"Mechanism", 9u, MechanismChild},
+    {"", 0u, UnknownChild},
+    {"", 0u, UnknownChild},
+    {"Call", 4u, CallChild},
+    {"Input", 5u, InputChild},
+    {"Output", 6u, OutputChild},
+    {"Control", 7u, ControlChild}
+};
+
+ChildKind FindChildKind(const char* Name)
+{
+    size_t NameLength;
 
-        NewStubSource.StubName = StubSourceXMLNode.attribute("Name").as_string();
-        NewStub.Sources.push_back(NewStubSource);
+    NameLength = strlen(Name);
+    const ChildTag& Tag = ChildTags[NameLength & 7u];
+    if ((NameLength == Tag.NameLength) && (memcmp(Name, Tag.Name, NameLength) == 0))
+    {
+        return Tag.Kind;
     }
-    NewStub.Position.Row = 0u;
-    NewStub.Position.Column = 0u;
-    NewStub.Length = 0u;
-    NewStub.Headed = Headed;
 
-    return NewStub;   
+    return UnknownChild;
+}
+
+// Sizes every array of a table for the given number of stubs and sources in one allocation each.
+void ReserveStubTable(StubTable& Stubs, uint32_t NumStubs, uint32_t NumSources)
+{
+    Stubs.Kinds.reserve(NumStubs);
+    Stubs.OwnerBoxes.reserve(NumStubs);
+    Stubs.Positions.reserve(NumStubs);
+    Stubs.Lengths.reserve(NumStubs);
+    Stubs.Headed.reserve(NumStubs);
+    Stubs.Names.reserve(NumStubs);
+    Stubs.NameIDs.reserve(NumStubs);
+    Stubs.FirstSources.reserve(NumStubs + 1u);
+    Stubs.SourceNames.reserve(NumSources);
+    Stubs.SourceNameIDs.reserve(NumSources);
+}
+
+// Offsets are taken from the parser, so they count from the start of the text it was given.
+void AddLoadDiagnostic(std::vector<LoadDiagnostic>& Diagnostics, const pugi::xml_node& XMLNode, const std::string& Message)
+{
+    LoadDiagnostic NewDiagnostic;
+
+    NewDiagnostic.Offset = std::max<ptrdiff_t>(0, XMLNode.offset_debug());
+    NewDiagnostic.Line = 0u;
+    NewDiagnostic.Column = 0u;
+    NewDiagnostic.Message = Message;
+    Diagnostics.push_back(NewDiagnostic);
 }
 
-MechanismStub LoadMechanismStub(const pugi::xml_node& MechanismStubXMLNode, bool Headed)
+// Appends one kind of a box's or the boundary's stubs in document order, so they occupy one
+// range of the table. Names are interned later by InternStubNames, call stubs carry no names.
+// SourceOffsets receives each source's offset for reporting sources that name no stub.
+StubRange LoadStubRange(const XMLNodeList& StubXMLNodes,
+    Interface Kind,
+    uint32_t OwnerBox,
+    bool Headed,
+    StubTable& Stubs,
+    std::pmr::vector<size_t>& SourceOffsets,
+    std::vector<LoadDiagnostic>& Diagnostics)
 {
-    MechanismStub NewStub;
- 
-    NewStub.Name = MechanismStubXMLNode.attribute("Name").as_string();
-    for (const pugi::xml_node &StubSourceXMLNode : MechanismStubXMLNode.children())
+    StubRange NewRange;
+
+    if (Stubs.FirstSources.empty() == true)
     {
-        StubSource NewStubSource;
+        Stubs.FirstSources.push_back(0u);
+    }
+    NewRange.First = Stubs.Kinds.size();
+    for (const pugi::xml_node &StubXMLNode : StubXMLNodes)
+    {
+        std::string_view StubName;
 
-        NewStubSource.StubName = StubSourceXMLNode.attribute("Name").as_string();
-        NewStub.Sources.push_back(NewStubSource);
+        if (Kind != CallInterface)
+        {
+            StubName = LoadAttributeText(StubXMLNode, "Name");
+            for (const pugi::xml_node &StubSourceXMLNode : StubXMLNode.children())
+            {
+                if (strcmp(StubSourceXMLNode.name(), "Source") != 0)
+                {
+                    AddLoadDiagnostic(Diagnostics, StubSourceXMLNode, std::string("Unknown stub child node kind: ") + StubSourceXMLNode.name());
+                    continue;
+                }
+                Stubs.SourceNames.push_back(LoadAttributeText(StubSourceXMLNode, "Name"));
+                SourceOffsets.push_back(std::max<ptrdiff_t>(0, StubSourceXMLNode.offset_debug()));
+            }
+        }
+        Stubs.Kinds.push_back(Kind);
+        Stubs.OwnerBoxes.push_back(OwnerBox);
+        Stubs.Positions.push_back(FilePosition{0u, 0u});
+        Stubs.Lengths.push_back(0u);
+        Stubs.Headed.push_back(Headed);
+        Stubs.Names.push_back(StubName);
+        Stubs.FirstSources.push_back(Stubs.SourceNames.size());
     }
-    NewStub.Position.Row = 0u;
-    NewStub.Position.Column = 0u;
-    NewStub.Length = 0u;
-    NewStub.Headed = Headed;
+    NewRange.End = Stubs.Kinds.size();
 
-    return NewStub;   
+    return NewRange;
 }
 
-CallStub LoadCallStub(const pugi::xml_node& CallStubXMLNode, bool Headed)
+// Interns the names of the stubs from FirstStubID on, each stub's sources before its own name.
+void InternStubNames(StubTable& Stubs, uint32_t FirstStubID, StubNameTable& NameTable)
 {
-    CallStub NewStub;
+    uint32_t NumStubs;
 
-    NewStub.Position.Row = 0u;
-    NewStub.Position.Column = 0u;
-    NewStub.Length = 0u;
-    NewStub.Headed = Headed;
-
-    return NewStub;   
+    NumStubs = Stubs.Kinds.size();
+    for (uint32_t StubID = FirstStubID; StubID < NumStubs; StubID++)
+    {
+        for (uint32_t SourceIndex = Stubs.FirstSources[StubID]; SourceIndex < Stubs.FirstSources[StubID + 1u]; SourceIndex++)
+        {
+            Stubs.SourceNameIDs.push_back(InternStubName(NameTable, Stubs.SourceNames[SourceIndex]));
+        }
+        Stubs.NameIDs.push_back(InternStubName(NameTable, Stubs.Names[StubID]));
+    }
 }
 
-ActivityBox LoadActivity(const pugi::xml_node &ActivityNode)
+// StubXMLNodes is scratch space for sorting the children by kind, it is reused between boxes.
+ActivityBox LoadActivity(const pugi::xml_node &ActivityNode,
+    uint32_t BoxIndex,
+    StubTable& Stubs,
+    std::pmr::vector<size_t>& SourceOffsets,
+    std::vector<LoadDiagnostic>& Diagnostics,
+    XMLNodeList (&StubXMLNodes)[5u])
 {
     ActivityBox NewActivityBox;
 
-    NewActivityBox.Name = ActivityNode.attribute("Name").as_string();
-    NewActivityBox.NodeNumber = ActivityNode.attribute("Number").as_string();
-    NewActivityBox.DRE = ActivityNode.attribute("DRE").as_string();
+    NewActivityBox.Name = LoadAttributeText(ActivityNode, "Name");
+    NewActivityBox.NodeNumber = LoadAttributeText(ActivityNode, "Number");
+    NewActivityBox.DRE = LoadAttributeText(ActivityNode, "DRE");
     NewActivityBox.Width = 0u;
     NewActivityBox.Height = 0u;
     NewActivityBox.Center.Row = 0u;
     NewActivityBox.Center.Column = 0u;
     NewActivityBox.Padding = 3u;
+    for (XMLNodeList& KindXMLNodes : StubXMLNodes)
+    {
+        KindXMLNodes.clear();
+    }
     for (const pugi::xml_node &XMLStub : ActivityNode.children())
     {
-        Stub NewStub;
+        ChildKind StubKind;
+
+        StubKind = FindChildKind(XMLStub.name());
+        if (StubKind > CallChild)
+        {
+            AddLoadDiagnostic(Diagnostics, XMLStub, std::string("Unknown activity stub kind: ") + XMLStub.name());
+            continue;
+        }
+        StubXMLNodes[StubKind].push_back(XMLStub);
+    }
+    NewActivityBox.InputStubs = LoadStubRange(StubXMLNodes[InputChild], InputInterface, BoxIndex, true, Stubs, SourceOffsets, Diagnostics);
+    NewActivityBox.OutputStubs = LoadStubRange(StubXMLNodes[OutputChild], OutputInterface, BoxIndex, false, Stubs, SourceOffsets, Diagnostics);
+    NewActivityBox.ControlStubs = LoadStubRange(StubXMLNodes[ControlChild], ControlInterface, BoxIndex, true, Stubs, SourceOffsets, Diagnostics);
+    NewActivityBox.MechanismStubs = LoadStubRange(StubXMLNodes[MechanismChild], MechanismInterface, BoxIndex, true, Stubs, SourceOffsets, Diagnostics);
+    NewActivityBox.CallStubs = LoadStubRange(StubXMLNodes[CallChild], CallInterface, BoxIndex, false, Stubs, SourceOffsets, Diagnostics);
+
+    return NewActivityBox;
+}
+
+// Diagrams with at least this many activities load their boxes on up to the caller's thread
+// count, smaller ones do not repay starting threads. Each thread claims chunks of
+// ActivityChunkSize boxes at a time.
+const uint32_t ParallelActivityMinimum = 128u;
+const uint32_t ActivityChunkSize = 64u;
+
+// The boxes of a chunk are written to their own slots of the diagram, their stubs go to the
+// chunk's table and are moved into the diagram's table once every chunk is loaded.
+struct ActivityChunk
+{
+    uint32_t FirstBox;
+    uint32_t EndBox;
+    StubTable Stubs;
+    std::pmr::vector<size_t> SourceOffsets;
+    std::vector<LoadDiagnostic> Diagnostics;
+    std::exception_ptr Failure;
+};
+
+// Counts the children and grandchildren of a chunk's activities, at least as many as its stubs
+// and their sources, so the chunk's table is sized once before it is filled.
+void ReserveActivityChunk(const XMLNodeList& ActivityXMLNodes, ActivityChunk& Chunk)
+{
+    uint32_t NumChildren;
+    uint32_t NumGrandchildren;
 
-        if (strcmp(XMLStub.name(), "Input") == 0)
+    NumChildren = 0u;
+    NumGrandchildren = 0u;
+    for (uint32_t BoxIndex = Chunk.FirstBox; BoxIndex < Chunk.EndBox; BoxIndex++)
+    {
+        for (const pugi::xml_node &ChildXMLNode : ActivityXMLNodes[BoxIndex].children())
         {
-            NewStub = LoadInputStub(XMLStub, true);
-            NewActivityBox.InputStubs.push_back(NewStub);
+            NumChildren++;
+            for (pugi::xml_node GrandchildXMLNode = ChildXMLNode.first_child(); GrandchildXMLNode;
+                GrandchildXMLNode = GrandchildXMLNode.next_sibling())
+            {
+                NumGrandchildren++;
+            }
         }
-        else if (strcmp(XMLStub.name(), "Output") == 0)
+    }
+    ReserveStubTable(Chunk.Stubs, NumChildren, NumGrandchildren);
+    Chunk.SourceOffsets.reserve(NumGrandchildren);
+}
+
+void LoadActivityChunks(const XMLNodeList& ActivityXMLNodes,
+    std::vector<ActivityBox>& Boxes,
+    std::pmr::vector<ActivityChunk>& Chunks,
+    std::atomic<uint32_t>& NextChunkIndex)
+{
+    XMLNodeList StubXMLNodes[5u];
+    uint32_t ChunkIndex;
+
+    for (ChunkIndex = NextChunkIndex++; ChunkIndex < Chunks.size(); ChunkIndex = NextChunkIndex++)
+    {
+        ActivityChunk& SelectedChunk = Chunks[ChunkIndex];
+
+        try
         {
-            NewStub = LoadOutputStub(XMLStub, false);
-            NewActivityBox.OutputStubs.push_back(NewStub);
+            ReserveActivityChunk(ActivityXMLNodes, SelectedChunk);
+            for (uint32_t BoxIndex = SelectedChunk.FirstBox; BoxIndex < SelectedChunk.EndBox; BoxIndex++)
+            {
+                Boxes[BoxIndex] = LoadActivity(ActivityXMLNodes[BoxIndex], BoxIndex, SelectedChunk.Stubs, SelectedChunk.SourceOffsets,
+                    SelectedChunk.Diagnostics, StubXMLNodes);
+            }
         }
-        else if (strcmp(XMLStub.name(), "Control") == 0)
+        catch (...)
         {
-            NewStub = LoadControlStub(XMLStub, true);
-            NewActivityBox.ControlStubs.push_back(NewStub);
+            SelectedChunk.Failure = std::current_exception();
         }
-        else if (strcmp(XMLStub.name(), "Mechanism") == 0)
+    }
+}
+
+void ShiftStubRange(StubRange& Range, uint32_t Offset)
+{
+    Range.First += Offset;
+    Range.End += Offset;
+}
+
+// Appends a loaded chunk's stubs to the diagram's table, chunks are appended in document order
+// so stub and name IDs come out as if the boxes had been loaded one after another.
+void AppendActivityChunk(ActivityChunk& Chunk,
+    ActivityDiagram& Diagram,
+    StubNameTable& NameTable,
+    std::pmr::vector<size_t>& SourceOffsets,
+    std::vector<LoadDiagnostic>& Diagnostics)
+{
+    StubTable& Stubs = Diagram.Stubs;
+    uint32_t StubOffset;
+    uint32_t SourceOffset;
+    uint32_t NumChunkStubs;
+
+    StubOffset = Stubs.Kinds.size();
+    SourceOffset = Stubs.SourceNames.size();
+    NumChunkStubs = Chunk.Stubs.Kinds.size();
+    for (uint32_t BoxIndex = Chunk.FirstBox; BoxIndex < Chunk.EndBox; BoxIndex++)
+    {
+        ActivityBox& SelectedBox = Diagram.Boxes[BoxIndex];
+
+        ShiftStubRange(SelectedBox.InputStubs, StubOffset);
+        ShiftStubRange(SelectedBox.OutputStubs, StubOffset);
+        ShiftStubRange(SelectedBox.ControlStubs, StubOffset);
+        ShiftStubRange(SelectedBox.MechanismStubs, StubOffset);
+        ShiftStubRange(SelectedBox.CallStubs, StubOffset);
+    }
+    Stubs.Kinds.insert(Stubs.Kinds.end(), Chunk.Stubs.Kinds.begin(), Chunk.Stubs.Kinds.end());
+    Stubs.OwnerBoxes.insert(Stubs.OwnerBoxes.end(), Chunk.Stubs.OwnerBoxes.begin(), Chunk.Stubs.OwnerBoxes.end());
+    Stubs.Positions.insert(Stubs.Positions.end(), Chunk.Stubs.Positions.begin(), Chunk.Stubs.Positions.end());
+    Stubs.Lengths.insert(Stubs.Lengths.end(), Chunk.Stubs.Lengths.begin(), Chunk.Stubs.Lengths.end());
+    Stubs.Headed.insert(Stubs.Headed.end(), Chunk.Stubs.Headed.begin(), Chunk.Stubs.Headed.end());
+    Stubs.Names.insert(Stubs.Names.end(), Chunk.Stubs.Names.begin(), Chunk.Stubs.Names.end());
+    Stubs.SourceNames.insert(Stubs.SourceNames.end(), Chunk.Stubs.SourceNames.begin(), Chunk.Stubs.SourceNames.end());
+    for (uint32_t StubIndex = 0u; StubIndex < NumChunkStubs; StubIndex++)
+    {
+        Stubs.FirstSources.push_back(Chunk.Stubs.FirstSources[StubIndex + 1u] + SourceOffset);
+    }
+    SourceOffsets.insert(SourceOffsets.end(), Chunk.SourceOffsets.begin(), Chunk.SourceOffsets.end());
+    Diagnostics.insert(Diagnostics.end(), Chunk.Diagnostics.begin(), Chunk.Diagnostics.end());
+    InternStubNames(Stubs, StubOffset, NameTable);
+}
+
+// Every source has to name a stub of the same diagram, otherwise its connection is silently lost.
+void CheckStubSources(const ActivityDiagram& Diagram, const std::pmr::vector<size_t>& SourceOffsets, std::vector<LoadDiagnostic>& Diagnostics)
+{
+    const StubTable& Stubs = Diagram.Stubs;
+    std::vector<uint8_t> NamedIDs;
+    uint32_t NumSources;
+
+    NamedIDs.assign(Diagram.NumNames, false);
+    for (uint32_t StubID = 0u; StubID < Diagram.NumStubs; StubID++)
+    {
+        if (Stubs.Kinds[StubID] != CallInterface)
         {
-            NewStub = LoadMechanismStub(XMLStub, true);
-            NewActivityBox.MechanismStubs.push_back(NewStub);
+            NamedIDs[Stubs.NameIDs[StubID]] = true;
         }
-        else if (strcmp(XMLStub.name(), "Call") == 0)
+    }
+    NumSources = Stubs.SourceNameIDs.size();
+    for (uint32_t SourceIndex = 0u; SourceIndex < NumSources; SourceIndex++)
+    {
+        if (NamedIDs[Stubs.SourceNameIDs[SourceIndex]] == false)
         {
-            NewStub = LoadCallStub(XMLStub, false);
-            NewActivityBox.CallStubs.push_back(NewStub);
+            LoadDiagnostic NewDiagnostic;
+
+            NewDiagnostic.Offset = SourceOffsets[SourceIndex];
+            NewDiagnostic.Line = 0u;
+            NewDiagnostic.Column = 0u;
+            NewDiagnostic.Message = "Source '" + std::string(Stubs.SourceNames[SourceIndex]) + "' names no stub of the diagram.";
+            Diagnostics.push_back(NewDiagnostic);
         }
-        else
+    }
+}
+
+// Counts a reference on the counting pass and stores it on the filling pass.
+void AddStubReference(StubCrossReference& CrossReference,
+    std::vector<uint32_t>& NextReferences,
+    uint32_t NameID,
+    uint32_t StubID,
+    uint32_t BoxIndex,
+    bool ThroughSource,
+    bool Counting)
+{
+    uint32_t ReferenceIndex;
+
+    if (Counting == true)
+    {
+        CrossReference.FirstReferences[NameID + 1u]++;
+    }
+    else
+    {
+        ReferenceIndex = NextReferences[NameID]++;
+        CrossReference.ReferenceStubIDs[ReferenceIndex] = StubID;
+        CrossReference.ReferenceBoxes[ReferenceIndex] = BoxIndex;
+        CrossReference.ThroughSource[ReferenceIndex] = ThroughSource;
+    }
+}
+
+void AddStubRangeReferences(const StubTable& Stubs,
+    StubRange Range,
+    uint32_t BoxIndex,
+    StubCrossReference& CrossReference,
+    std::vector<uint32_t>& NextReferences,
+    bool Counting)
+{
+    for (uint32_t StubID = Range.First; StubID < Range.End; StubID++)
+    {
+        AddStubReference(CrossReference, NextReferences, Stubs.NameIDs[StubID], StubID, BoxIndex, false, Counting);
+        for (uint32_t SourceIndex = Stubs.FirstSources[StubID]; SourceIndex < Stubs.FirstSources[StubID + 1u]; SourceIndex++)
         {
-            throw std::runtime_error("Unknown activity stub kind");
+            if (Stubs.SourceNameIDs[SourceIndex] != Stubs.NameIDs[StubID])
+            {
+                AddStubReference(CrossReference, NextReferences, Stubs.SourceNameIDs[SourceIndex], StubID, BoxIndex, true, Counting);
+            }
         }
     }
+}
 
-    return NewActivityBox;
+// Walks the boundary's and the boxes' stub ranges twice, counting the references to every name
+// ID and then filling them in. Stubs left in the table by a box an edit removed are not indexed.
+void IndexStubReferences(ActivityDiagram& Diagram)
+{
+    const StubTable& Stubs = Diagram.Stubs;
+    StubCrossReference& CrossReference = Diagram.CrossReference;
+    std::vector<uint32_t> NextReferences;
+    uint32_t NumBoxes;
+    uint32_t NumReferences;
+
+    NumBoxes = Diagram.Boxes.size();
+    CrossReference.FirstReferences.assign((size_t)Diagram.NumNames + 1u, 0u);
+    for (uint32_t Pass = 0u; Pass < 2u; Pass++)
+    {
+        bool Counting;
+
+        Counting = (Pass == 0u);
+        if (Counting == false)
+        {
+            for (uint32_t NameID = 0u; NameID < Diagram.NumNames; NameID++)
+            {
+                CrossReference.FirstReferences[NameID + 1u] += CrossReference.FirstReferences[NameID];
+            }
+            NumReferences = CrossReference.FirstReferences[Diagram.NumNames];
+            CrossReference.ReferenceStubIDs.resize(NumReferences);
+            CrossReference.ReferenceBoxes.resize(NumReferences);
+            CrossReference.ThroughSource.resize(NumReferences);
+            NextReferences.assign(CrossReference.FirstReferences.begin(), CrossReference.FirstReferences.end() - 1);
+        }
+        AddStubRangeReferences(Stubs, Diagram.InputBoundaryStubs, BoundaryStubOwner, CrossReference, NextReferences, Counting);
+        AddStubRangeReferences(Stubs, Diagram.OutputBoundaryStubs, BoundaryStubOwner, CrossReference, NextReferences, Counting);
+        AddStubRangeReferences(Stubs, Diagram.ControlBoundaryStubs, BoundaryStubOwner, CrossReference, NextReferences, Counting);
+        AddStubRangeReferences(Stubs, Diagram.MechanismBoundaryStubs, BoundaryStubOwner, CrossReference, NextReferences, Counting);
+        for (uint32_t BoxIndex = 0u; BoxIndex < NumBoxes; BoxIndex++)
+        {
+            const ActivityBox& SelectedBox = Diagram.Boxes[BoxIndex];
+
+            AddStubRangeReferences(Stubs, SelectedBox.InputStubs, BoxIndex, CrossReference, NextReferences, Counting);
+            AddStubRangeReferences(Stubs, SelectedBox.OutputStubs, BoxIndex, CrossReference, NextReferences, Counting);
+            AddStubRangeReferences(Stubs, SelectedBox.ControlStubs, BoxIndex, CrossReference, NextReferences, Counting);
+            AddStubRangeReferences(Stubs, SelectedBox.MechanismStubs, BoxIndex, CrossReference, NextReferences, Counting);
+            AddStubRangeReferences(Stubs, SelectedBox.CallStubs, BoxIndex, CrossReference, NextReferences, Counting);
+        }
+    }
 }
 
-ActivityDiagram LoadActivityDiagram(const std::string &FilePath)
+// The children are sorted by kind in one pass, then the activities are loaded into preallocated
+// box slots, on several threads for large diagrams. Problems are added to Diagnostics and the
+// offending elements skipped, so one load reports all of them. The lists that only live while
+// the diagram loads come from LoadArena and are released together, the diagram's own arrays are
+// sized once all of its stubs are counted. Callers already running on a pool pass a MaxThreads of
+// 1 so the load does not start threads on top of it.
+ActivityDiagram LoadActivityDiagramNode(const pugi::xml_node &ActivityDiagramNode, StubNameTable& NameTable,
+    std::vector<LoadDiagnostic>& Diagnostics, uint32_t MaxThreads)
 {
-    pugi::xml_document DiagramXMLDocument;
-    pugi::xml_parse_result ParseResult;
-    pugi::xml_node ActivityDiagramNode;
+    std::pmr::monotonic_buffer_resource LoadArena;
     ActivityDiagram NewDiagram;
+    std::pmr::vector<size_t> SourceOffsets(&LoadArena);
+    XMLNodeList BoundaryXMLNodes[5u] = {XMLNodeList(&LoadArena), XMLNodeList(&LoadArena), XMLNodeList(&LoadArena),
+        XMLNodeList(&LoadArena), XMLNodeList(&LoadArena)};
+    XMLNodeList ActivityXMLNodes(&LoadArena);
+    std::pmr::vector<ActivityChunk> Chunks(&LoadArena);
+    std::vector<std::thread> Workers;
+    std::atomic<uint32_t> NextChunkIndex;
+    uint32_t NumActivities;
+    uint32_t NumChunks;
+    uint32_t NumThreads;
+    uint32_t NumStubs;
+    uint32_t NumSources;
 
-    ParseResult = DiagramXMLDocument.load_file(FilePath.c_str());
-    ActivityDiagramNode = DiagramXMLDocument.child("Diagram");
     NewDiagram.Frame.BottomBar.NodeNumberSection = NodeNumberSection();
     NewDiagram.Frame.BottomBar.TitleSection = TitleSection();
     NewDiagram.Frame.BottomBar.CNumberSection = CNumberSection();
@@ -176,60 +577,488 @@ ActivityDiagram LoadActivityDiagram(const std::string &FilePath)
     TitleSection& TargetTitleSection = std::get<TitleSection>(NewDiagram.Frame.BottomBar.TitleSection);
     CNumberSection& TargetCNumberSection = std::get<CNumberSection>(NewDiagram.Frame.BottomBar.CNumberSection);
     NewDiagram.Frame.BottomBar.Height = 4u;
-    TargetNodeNumberSection.Content = ActivityDiagramNode.attribute("Number").as_string();
+    TargetNodeNumberSection.Content = LoadAttributeText(ActivityDiagramNode, "Number");
     TargetNodeNumberSection.TopLeft.Row = 0u;
     TargetNodeNumberSection.TopLeft.Column = 0u;
-    TargetTitleSection.Content = ActivityDiagramNode.attribute("Title").as_string();
+    TargetTitleSection.Content = LoadAttributeText(ActivityDiagramNode, "Title");
     TargetTitleSection.TopLeft.Row = 0u;
     TargetTitleSection.TopLeft.Column = 0u;
-    TargetCNumberSection.Content = ActivityDiagramNode.attribute("CNumber").as_string();
+    TargetCNumberSection.Content = LoadAttributeText(ActivityDiagramNode, "CNumber");
     TargetCNumberSection.TopLeft.Row = 0u;
     TargetCNumberSection.TopLeft.Column = 0u;
     NewDiagram.Width = 0u;
     NewDiagram.Height = 0u;
     for (const pugi::xml_node &ChildXMLNode : ActivityDiagramNode.children())
     {
-        Stub NewStub;
+        ChildKind ChildNodeKind;
 
-        if (strcmp(ChildXMLNode.name(), "Input") == 0)
+        ChildNodeKind = FindChildKind(ChildXMLNode.name());
+        if (ChildNodeKind == ActivityChild)
         {
-            NewStub = LoadInputStub(ChildXMLNode, false);
-            NewDiagram.InputBoundaryStubs.push_back(NewStub);
+            ActivityXMLNodes.push_back(ChildXMLNode);
         }
-        else if (strcmp(ChildXMLNode.name(), "Output") == 0)
+        else if ((ChildNodeKind == UnknownChild) || (ChildNodeKind == CallChild))
         {
-            NewStub = LoadOutputStub(ChildXMLNode, true);
-            NewDiagram.OutputBoundaryStubs.push_back(NewStub);
+            AddLoadDiagnostic(Diagnostics, ChildXMLNode, std::string("Unknown XML activity diagram child node kind: ") + ChildXMLNode.name());
         }
-        else if (strcmp(ChildXMLNode.name(), "Control") == 0)
+        else
         {
-            NewStub = LoadControlStub(ChildXMLNode, false);
-            NewDiagram.ControlBoundaryStubs.push_back(NewStub);
+            BoundaryXMLNodes[ChildNodeKind].push_back(ChildXMLNode);
         }
-        else if (strcmp(ChildXMLNode.name(), "Mechanism") == 0)
+    }
+    NumStubs = 0u;
+    for (const XMLNodeList& KindXMLNodes : BoundaryXMLNodes)
+    {
+        NumStubs += KindXMLNodes.size();
+    }
+    ReserveStubTable(NewDiagram.Stubs, NumStubs, 0u);
+    NewDiagram.InputBoundaryStubs = LoadStubRange(BoundaryXMLNodes[InputChild], InputInterface, BoundaryStubOwner, false, NewDiagram.Stubs, SourceOffsets, Diagnostics);
+    NewDiagram.OutputBoundaryStubs = LoadStubRange(BoundaryXMLNodes[OutputChild], OutputInterface, BoundaryStubOwner, true, NewDiagram.Stubs, SourceOffsets, Diagnostics);
+    NewDiagram.ControlBoundaryStubs = LoadStubRange(BoundaryXMLNodes[ControlChild], ControlInterface, BoundaryStubOwner, false, NewDiagram.Stubs, SourceOffsets, Diagnostics);
+    NewDiagram.MechanismBoundaryStubs = LoadStubRange(BoundaryXMLNodes[MechanismChild], MechanismInterface, BoundaryStubOwner, false, NewDiagram.Stubs, SourceOffsets, Diagnostics);
+    InternStubNames(NewDiagram.Stubs, 0u, NameTable);
+    NumActivities = ActivityXMLNodes.size();
+    NumChunks = (NumActivities + ActivityChunkSize - 1u) / ActivityChunkSize;
+    NewDiagram.Boxes.resize(NumActivities);
+    Chunks.resize(NumChunks);
+    for (uint32_t ChunkIndex = 0u; ChunkIndex < NumChunks; ChunkIndex++)
+    {
+        Chunks[ChunkIndex].FirstBox = ChunkIndex * ActivityChunkSize;
+        Chunks[ChunkIndex].EndBox = std::min(NumActivities, (ChunkIndex + 1u) * ActivityChunkSize);
+    }
+    NextChunkIndex = 0u;
+    NumThreads = 1u;
+    if (NumActivities >= ParallelActivityMinimum)
+    {
+        NumThreads = std::max(1u, std::min(MaxThreads, NumChunks));
+    }
+    for (uint32_t ThreadIndex = 1u; ThreadIndex < NumThreads; ThreadIndex++)
+    {
+        Workers.emplace_back(LoadActivityChunks, std::cref(ActivityXMLNodes), std::ref(NewDiagram.Boxes), std::ref(Chunks),
+            std::ref(NextChunkIndex));
+    }
+    LoadActivityChunks(ActivityXMLNodes, NewDiagram.Boxes, Chunks, NextChunkIndex);
+    for (std::thread& Worker : Workers)
+    {
+        Worker.join();
+    }
+    NumStubs = NewDiagram.Stubs.Kinds.size();
+    NumSources = NewDiagram.Stubs.SourceNames.size();
+    for (ActivityChunk& LoadedChunk : Chunks)
+    {
+        if (LoadedChunk.Failure)
         {
-            NewStub = LoadMechanismStub(ChildXMLNode, false);
-            NewDiagram.MechanismBoundaryStubs.push_back(NewStub);
+            std::rethrow_exception(LoadedChunk.Failure);
         }
-        else if (strcmp(ChildXMLNode.name(), "Activity") == 0)
+        NumStubs += LoadedChunk.Stubs.Kinds.size();
+        NumSources += LoadedChunk.Stubs.SourceNames.size();
+    }
+    ReserveStubTable(NewDiagram.Stubs, NumStubs, NumSources);
+    SourceOffsets.reserve(NumSources);
+    for (ActivityChunk& LoadedChunk : Chunks)
+    {
+        AppendActivityChunk(LoadedChunk, NewDiagram, NameTable, SourceOffsets, Diagnostics);
+    }
+    NewDiagram.NumStubs = NewDiagram.Stubs.Kinds.size();
+    NewDiagram.NumNames = NameTable.size();
+    CheckStubSources(NewDiagram, SourceOffsets, Diagnostics);
+    IndexStubReferences(NewDiagram);
+
+    return NewDiagram;
+}
+
+// Fills in the lines and columns of diagnostics whose offsets count from DiagramOffset into
+// Text, the unmodified text around the diagram. FirstLine and FirstColumn locate Text's first
+// character in its file. The diagnostics are sorted by offset so the text is walked once.
+void LocateLoadDiagnostics(std::vector<LoadDiagnostic>& Diagnostics,
+    const char* Text,
+    size_t TextSize,
+    size_t DiagramOffset,
+    uint32_t FirstLine,
+    uint32_t FirstColumn)
+{
+    size_t TextIndex;
+    size_t LineStart;
+    uint32_t Line;
+    bool FirstLineFlag;
+
+    std::stable_sort(Diagnostics.begin(), Diagnostics.end(), [](const LoadDiagnostic& First, const LoadDiagnostic& Second)
+    {
+        return First.Offset < Second.Offset;
+    });
+    TextIndex = 0u;
+    LineStart = 0u;
+    Line = FirstLine;
+    FirstLineFlag = true;
+    for (LoadDiagnostic& SelectedDiagnostic : Diagnostics)
+    {
+        size_t TargetIndex;
+
+        TargetIndex = std::min(TextSize, DiagramOffset + SelectedDiagnostic.Offset);
+        for (; TextIndex < TargetIndex; TextIndex++)
+        {
+            if (Text[TextIndex] == '\n')
+            {
+                Line++;
+                LineStart = TextIndex + 1u;
+                FirstLineFlag = false;
+            }
+        }
+        SelectedDiagnostic.Line = Line;
+        SelectedDiagnostic.Column = (TargetIndex - LineStart) + ((FirstLineFlag == true) ? FirstColumn : 1u);
+    }
+}
+
+// Reports every problem of a failed load in one error, one "Source:Line:Column: Message" per line.
+void ThrowLoadDiagnostics(const std::vector<LoadDiagnostic>& Diagnostics, const std::string& SourceName)
+{
+    std::string ErrorMessage;
+
+    ErrorMessage = std::to_string(Diagnostics.size()) + " problem(s) loading " + SourceName + ":";
+    for (const LoadDiagnostic& SelectedDiagnostic : Diagnostics)
+    {
+        ErrorMessage += "\n" + SourceName + ":" + std::to_string(SelectedDiagnostic.Line) + ":" +
+            std::to_string(SelectedDiagnostic.Column) + ": " + SelectedDiagnostic.Message;
+    }
+
+    throw std::runtime_error(ErrorMessage);
+}
+
+// Checks the parse before loading the tree, a document pugixml rejected is reported on its own.
+bool CheckDocumentParse(const pugi::xml_parse_result& ParseResult, std::vector<LoadDiagnostic>& Diagnostics)
+{
+    LoadDiagnostic NewDiagnostic;
+
+    if (ParseResult)
+    {
+        return true;
+    }
+    NewDiagnostic.Offset = std::max<ptrdiff_t>(0, ParseResult.offset);
+    NewDiagnostic.Line = 0u;
+    NewDiagnostic.Column = 0u;
+    NewDiagnostic.Message = std::string("XML parse error: ") + ParseResult.description();
+    Diagnostics.push_back(NewDiagnostic);
+
+    return false;
+}
+
+// Loads a diagram from text it parses in place. Problems are added to Diagnostics, the caller
+// still holding the unmodified text locates and reports them. Text in any encoding but UTF-8 is
+// converted by pugixml into a buffer the document owns, the diagram's names then point into that
+// buffer, so the document is kept alive alongside the text for as long as the diagram is.
+ActivityDiagram LoadActivityDiagramSource(const std::shared_ptr<char>& SourceText, size_t TextSize,
+    std::vector<LoadDiagnostic>& Diagnostics, uint32_t MaxThreads)
+{
+    std::shared_ptr<pugi::xml_document> DiagramXMLDocument;
+    pugi::xml_parse_result ParseResult;
+    pugi::xml_node DiagramNode;
+    std::pmr::monotonic_buffer_resource NameArena;
+    StubNameTable NameTable(&NameArena);
+    ActivityDiagram NewDiagram;
+
+    DiagramXMLDocument = std::make_shared<pugi::xml_document>();
+    ParseResult = DiagramXMLDocument->load_buffer_inplace(SourceText.get(), TextSize);
+    if (CheckDocumentParse(ParseResult, Diagnostics) == false)
+    {
+        return NewDiagram;
+    }
+    DiagramNode = DiagramXMLDocument->child("Diagram");
+    if (!DiagramNode)
+    {
+        AddLoadDiagnostic(Diagnostics, DiagramXMLDocument->first_child(), "The document has no <Diagram> root element.");
+        return NewDiagram;
+    }
+    NewDiagram = LoadActivityDiagramNode(DiagramNode, NameTable, Diagnostics, MaxThreads);
+    if (ParseResult.encoding == pugi::encoding_utf8)
+    {
+        NewDiagram.SourceText = SourceText;
+    }
+    else
+    {
+        NewDiagram.SourceText = std::shared_ptr<char>(SourceText.get(), [SourceText, DiagramXMLDocument](char*)
         {
-            ActivityBox NewActivityBox;
+        });
+    }
+
+    return NewDiagram;
+}
+
+// The text was parsed in place, so a failed load reads the file again to locate its problems.
+ActivityDiagram LoadActivityDiagramFileSource(const std::string &FilePath, const std::shared_ptr<char>& SourceText, size_t TextSize,
+    uint32_t MaxThreads)
+{
+    std::vector<LoadDiagnostic> Diagnostics;
+    std::shared_ptr<char> OriginalText;
+    size_t OriginalSize;
+    ActivityDiagram NewDiagram;
+
+    NewDiagram = LoadActivityDiagramSource(SourceText, TextSize, Diagnostics, MaxThreads);
+    if (Diagnostics.empty() == false)
+    {
+        OriginalText = ReadSourceText(FilePath, OriginalSize);
+        LocateLoadDiagnostics(Diagnostics, OriginalText.get(), OriginalSize, 0u, 1u, 1u);
+        ThrowLoadDiagnostics(Diagnostics, FilePath);
+    }
+
+    return NewDiagram;
+}
+
+ActivityDiagram LoadActivityDiagram(const std::string &FilePath, uint32_t MaxThreads)
+{
+    std::shared_ptr<char> SourceText;
+    size_t TextSize;
+
+    SourceText = LoadSourceText(FilePath, TextSize);
+
+    return LoadActivityDiagramFileSource(FilePath, SourceText, TextSize, MaxThreads);
+}
 
-            NewActivityBox = LoadActivity(ChildXMLNode);
-            NewDiagram.Boxes.push_back(NewActivityBox);
+ActivityDiagram LoadActivityDiagramText(const std::string &DiagramXML, uint32_t MaxThreads)
+{
+    std::shared_ptr<char> SourceText;
+    std::vector<LoadDiagnostic> Diagnostics;
+    ActivityDiagram NewDiagram;
+
+    SourceText = std::shared_ptr<char>(new char[DiagramXML.size() + 1u], std::default_delete<char[]>());
+    memcpy(SourceText.get(), DiagramXML.data(), DiagramXML.size());
+    SourceText.get()[DiagramXML.size()] = '\0';
+    NewDiagram = LoadActivityDiagramSource(SourceText, DiagramXML.size(), Diagnostics, MaxThreads);
+    if (Diagnostics.empty() == false)
+    {
+        LocateLoadDiagnostics(Diagnostics, DiagramXML.data(), DiagramXML.size(), 0u, 1u, 1u);
+        ThrowLoadDiagnostics(Diagnostics, "diagram");
+    }
+
+    return NewDiagram;
+}
+
+// Model streams read the file this many bytes at a time.
+const size_t ModelStreamChunkSize = 1u << 16u;
+
+// Long enough to tell "<![CDATA[" from the other markup that starts with '<'.
+const size_t ModelStreamMarkupPrefixSize = 9u;
+
+void OpenModelStream(ModelStream& Stream, const std::string& FilePath)
+{
+    Stream.FilePath = FilePath;
+    Stream.FileStream.open(FilePath, std::ios_base::in | std::ios_base::binary);
+    if (Stream.FileStream.is_open() == false)
+    {
+        throw std::runtime_error("Could not open the input file: " + FilePath);
+    }
+    Stream.Buffer.clear();
+    Stream.ScanIndex = 0u;
+    Stream.DiagramIndex = 0u;
+    Stream.BufferLine = 1u;
+    Stream.BufferColumn = 1u;
+    Stream.Depth = 0u;
+    Stream.DiagramDepth = 0u;
+    Stream.RootFound = false;
+    Stream.InsideDiagram = false;
+    Stream.FileEnded = false;
+}
+
+// Drops the text before the current diagram, or all scanned text outside of one, then appends
+// the next chunk of the file. The file line and column of the buffer's start follow the dropped
+// text. Returns false once the file has no more text.
+bool ReadModelStreamChunk(ModelStream& Stream)
+{
+    size_t KeptIndex;
+    size_t BufferSize;
+    size_t LastLineEnd;
+
+    KeptIndex = (Stream.InsideDiagram == true) ? Stream.DiagramIndex : Stream.ScanIndex;
+    LastLineEnd = std::string_view(Stream.Buffer).substr(0u, KeptIndex).rfind('\n');
+    if (LastLineEnd == std::string_view::npos)
+    {
+        Stream.BufferColumn += KeptIndex;
+    }
+    else
+    {
+        Stream.BufferLine += std::count(Stream.Buffer.begin(), Stream.Buffer.begin() + LastLineEnd + 1u, '\n');
+        Stream.BufferColumn = 1u + (KeptIndex - (LastLineEnd + 1u));
+    }
+    Stream.Buffer.erase(0u, KeptIndex);
+    Stream.ScanIndex -= KeptIndex;
+    Stream.DiagramIndex -= std::min(Stream.DiagramIndex, KeptIndex);
+    if (Stream.FileEnded == true)
+    {
+        return false;
+    }
+    BufferSize = Stream.Buffer.size();
+    Stream.Buffer.resize(BufferSize + ModelStreamChunkSize);
+    Stream.FileStream.read(Stream.Buffer.data() + BufferSize, ModelStreamChunkSize);
+    Stream.Buffer.resize(BufferSize + Stream.FileStream.gcount());
+    if (Stream.FileStream.eof() || (Stream.FileStream.gcount() == 0))
+    {
+        Stream.FileEnded = true;
+    }
+
+    return true;
+}
+
+// Returns the index just past the markup starting at MarkupIndex, or npos when the buffer ends
+// before it does. Comments, CDATA and processing instructions may hold any text, tags only end
+// at a '>' outside of an attribute's quotes.
+size_t FindMarkupEnd(const std::string& Buffer, size_t MarkupIndex)
+{
+    std::string_view Markup;
+    size_t EndIndex;
+    char Quote;
+
+    Markup = std::string_view(Buffer).substr(MarkupIndex);
+    if (Markup.starts_with("<!--"))
+    {
+        EndIndex = Markup.find("-->", 4u);
+        return (EndIndex == std::string_view::npos) ? EndIndex : MarkupIndex + EndIndex + 3u;
+    }
+    if (Markup.starts_with("<![CDATA["))
+    {
+        EndIndex = Markup.find("]]>", 9u);
+        return (EndIndex == std::string_view::npos) ? EndIndex : MarkupIndex + EndIndex + 3u;
+    }
+    if (Markup.starts_with("<?"))
+    {
+        EndIndex = Markup.find("?>", 2u);
+        return (EndIndex == std::string_view::npos) ? EndIndex : MarkupIndex + EndIndex + 2u;
+    }
+    Quote = '\0';
+    for (EndIndex = 1u; EndIndex < Markup.size(); EndIndex++)
+    {
+        if (Quote != '\0')
+        {
+            if (Markup[EndIndex] == Quote)
+            {
+                Quote = '\0';
+            }
         }
-        else
+        else if ((Markup[EndIndex] == '"') || (Markup[EndIndex] == '\''))
         {
-            std::string ErrorMessage;
+            Quote = Markup[EndIndex];
+        }
+        else if (Markup[EndIndex] == '>')
+        {
+            return MarkupIndex + EndIndex + 1u;
+        }
+    }
 
-            ErrorMessage = "Unknown XML activity diagram child node kind: ";
-            ErrorMessage += ChildXMLNode.name();
+    return std::string::npos;
+}
+
+// Scans the model's markup for the next <Diagram> element and loads just its text. A <Model> root
+// yields each of its <Diagram> children, a lone <Diagram> root yields itself. Returns false after
+// the last diagram.
+bool ReadModelStreamDiagram(ModelStream& Stream, ActivityDiagram& NextDiagram, uint32_t MaxThreads)
+{
+    std::shared_ptr<char> DiagramText;
+    std::vector<LoadDiagnostic> Diagnostics;
+    size_t DiagramSize;
+
+    while (true)
+    {
+        size_t MarkupIndex;
+        size_t MarkupEnd;
+        std::string_view Markup;
+        std::string_view ElementName;
+        bool SelfClosing;
 
-            throw std::runtime_error(ErrorMessage);
+        MarkupIndex = Stream.Buffer.find('<', Stream.ScanIndex);
+        if (MarkupIndex == std::string::npos)
+        {
+            Stream.ScanIndex = Stream.Buffer.size();
+            if (ReadModelStreamChunk(Stream) == false)
+            {
+                if (Stream.InsideDiagram == true)
+                {
+                    throw std::runtime_error("The model file ended inside a diagram.");
+                }
+                return false;
+            }
+            continue;
+        }
+        MarkupEnd = std::string::npos;
+        if (((Stream.Buffer.size() - MarkupIndex) >= ModelStreamMarkupPrefixSize) || (Stream.FileEnded == true))
+        {
+            MarkupEnd = FindMarkupEnd(Stream.Buffer, MarkupIndex);
+        }
+        if (MarkupEnd == std::string::npos)
+        {
+            Stream.ScanIndex = MarkupIndex;
+            if (ReadModelStreamChunk(Stream) == false)
+            {
+                throw std::runtime_error("The model file ended inside its markup.");
+            }
+            continue;
+        }
+        Stream.ScanIndex = MarkupEnd;
+        Markup = std::string_view(Stream.Buffer).substr(MarkupIndex, MarkupEnd - MarkupIndex);
+        if (Markup.starts_with("<?") || Markup.starts_with("<!"))
+        {
+            continue;
+        }
+        if (Markup.starts_with("</"))
+        {
+            if (Stream.Depth == 0u)
+            {
+                throw std::runtime_error("The model file closes an element it never opened.");
+            }
+            Stream.Depth--;
+            if ((Stream.InsideDiagram == true) && (Stream.Depth == Stream.DiagramDepth))
+            {
+                break;
+            }
+            continue;
+        }
+        ElementName = Markup.substr(1u, Markup.find_first_of(" \t\r\n/>") - 1u);
+        SelfClosing = Markup.ends_with("/>");
+        if (Stream.RootFound == false)
+        {
+            if (ElementName == "Model")
+            {
+                Stream.DiagramDepth = 1u;
+            }
+            else if (ElementName == "Diagram")
+            {
+                Stream.DiagramDepth = 0u;
+            }
+            else
+            {
+                throw std::runtime_error("Unknown XML model root node kind: " + std::string(ElementName));
+            }
+            Stream.RootFound = true;
+        }
+        if ((Stream.InsideDiagram == false) && (Stream.Depth == Stream.DiagramDepth))
+        {
+            if (ElementName != "Diagram")
+            {
+                throw std::runtime_error("Unknown XML model child node kind: " + std::string(ElementName));
+            }
+            Stream.InsideDiagram = true;
+            Stream.DiagramIndex = MarkupIndex;
+            if (SelfClosing == true)
+            {
+                break;
+            }
+        }
+        if (SelfClosing == false)
+        {
+            Stream.Depth++;
         }
     }
+    DiagramSize = Stream.ScanIndex - Stream.DiagramIndex;
+    DiagramText = std::shared_ptr<char>(new char[DiagramSize + 1u], std::default_delete<char[]>());
+    memcpy(DiagramText.get(), Stream.Buffer.data() + Stream.DiagramIndex, DiagramSize);
+    DiagramText.get()[DiagramSize] = '\0';
+    Stream.InsideDiagram = false;
+    NextDiagram = LoadActivityDiagramSource(DiagramText, DiagramSize, Diagnostics, MaxThreads);
+    if (Diagnostics.empty() == false)
+    {
+        LocateLoadDiagnostics(Diagnostics, Stream.Buffer.data(), Stream.Buffer.size(), Stream.DiagramIndex, Stream.BufferLine,
+            Stream.BufferColumn);
+        ThrowLoadDiagnostics(Diagnostics, Stream.FilePath);
+    }
 
-    return NewDiagram;
+    return true;
 }
 
 }
@@ -15,133 +15,85 @@ struct FilePosition
     }
 };
 
-struct StubSource
+enum Interface
 {
-    std::string StubName;
+    InputInterface,
+    OutputInterface,
+    ControlInterface,
+    MechanismInterface,
+    CallInterface
 };
 
-struct InputStub
-{
-    std::string Name;
-    FilePosition Position;
-    std::vector<StubSource> Sources;
-    uint32_t Length;
-    bool Headed;
-      
-    bool operator<(const InputStub& RHS) const
-    {
-        uint32_t ThisEncodedPosition;
-        uint32_t RHSEncodedPosition;
-
-        ThisEncodedPosition = Position.Column + (Position.Row * 1000u);
-        RHSEncodedPosition = RHS.Position.Column + (RHS.Position.Row * 1000u);
-
-        return ThisEncodedPosition < RHSEncodedPosition;
-    }
-};
+// Owner of the stubs on a diagram's boundary rather than on one of its boxes.
+const uint32_t BoundaryStubOwner = 0xFFFFFFFFu;
 
-struct OutputStub
+// Every stub of a diagram, stored as parallel arrays indexed by the stub's ID. The sources of
+// stub ID are entries FirstSources[ID] up to FirstSources[ID + 1] of the source arrays.
+struct StubTable
 {
-    std::string Name;
-    FilePosition Position;
-    std::vector<StubSource> Sources;
-    uint32_t Length;
-    bool Headed;
-
-    bool operator<(const OutputStub& RHS) const
-    {
-        uint32_t ThisEncodedPosition;
-        uint32_t RHSEncodedPosition;
-
-        ThisEncodedPosition = Position.Column + (Position.Row * 1000u);
-        RHSEncodedPosition = RHS.Position.Column + (RHS.Position.Row * 1000u);
-
-        return ThisEncodedPosition < RHSEncodedPosition;
-    }
+    std::vector<Interface> Kinds;
+    std::vector<uint32_t> OwnerBoxes;
+    std::vector<FilePosition> Positions;
+    std::vector<uint32_t> Lengths;
+    std::vector<uint8_t> Headed;
+    std::vector<std::string_view> Names;
+    std::vector<uint32_t> NameIDs;
+    std::vector<uint32_t> FirstSources;
+    std::vector<std::string_view> SourceNames;
+    std::vector<uint32_t> SourceNameIDs;
 };
 
-struct ControlStub
+// The stubs of a diagram's boxes and boundary referring to each name ID, by their own name or by
+// one of their sources, boundary first and then box by box. A stub appears once when its own name
+// matches, otherwise once per matching source. ReferenceBoxes holds the position of the stub's
+// box in the diagram, or BoundaryStubOwner. The references to name ID are entries
+// FirstReferences[ID] up to FirstReferences[ID + 1]. It is built when a diagram is loaded, a
+// diagram whose boxes or stubs change afterwards is indexed again with IndexStubReferences.
+struct StubCrossReference
 {
-    std::string Name;
-    FilePosition Position;
-    std::vector<StubSource> Sources;
-    uint32_t Length;
-    bool Headed;
-
-    bool operator<(const ControlStub& RHS) const
-    {
-        uint32_t ThisEncodedPosition;
-        uint32_t RHSEncodedPosition;
-
-        ThisEncodedPosition = Position.Column + (Position.Row * 1000u);
-        RHSEncodedPosition = RHS.Position.Column + (RHS.Position.Row * 1000u);
-
-        return ThisEncodedPosition < RHSEncodedPosition;
-    }
+    std::vector<uint32_t> FirstReferences;
+    std::vector<uint32_t> ReferenceStubIDs;
+    std::vector<uint32_t> ReferenceBoxes;
+    std::vector<uint8_t> ThroughSource;
 };
 
-struct MechanismStub
+// A problem found while loading, at a byte offset into the diagram's text. Line and Column count
+// from 1 and are only filled in by LocateLoadDiagnostics, once a load has failed.
+struct LoadDiagnostic
 {
-    std::string Name;
-    FilePosition Position;
-    std::vector<StubSource> Sources;
-    uint32_t Length;
-    bool Headed;
-
-    bool operator<(const MechanismStub& RHS) const
-    {
-        uint32_t ThisEncodedPosition;
-        uint32_t RHSEncodedPosition;
-
-        ThisEncodedPosition = Position.Column + (Position.Row * 1000u);
-        RHSEncodedPosition = RHS.Position.Column + (RHS.Position.Row * 1000u);
-
-        return ThisEncodedPosition < RHSEncodedPosition;
-    }
+    size_t Offset;
+    uint32_t Line;
+    uint32_t Column;
+    std::string Message;
 };
 
-struct CallStub
+// The stubs of one kind on a box or the boundary, IDs First up to but not including End.
+struct StubRange
 {
-    std::string Name;
-    FilePosition Position;
-    std::vector<StubSource> Sources;
-    uint32_t Length;
-    bool Headed;
-
-    bool operator<(const CallStub& RHS) const
-    {
-        uint32_t ThisEncodedPosition;
-        uint32_t RHSEncodedPosition;
-
-        ThisEncodedPosition = Position.Column + (Position.Row * 1000u);
-        RHSEncodedPosition = RHS.Position.Column + (RHS.Position.Row * 1000u);
-
-        return ThisEncodedPosition < RHSEncodedPosition;
-    }
+    uint32_t First;
+    uint32_t End;
 };
 
-typedef std::variant<InputStub, OutputStub, ControlStub, MechanismStub, CallStub> Stub;
-
 struct ActivityBox
 {
-    std::vector<Stub> InputStubs;
-    std::vector<Stub> OutputStubs;
-    std::vector<Stub> ControlStubs;
-    std::vector<Stub> MechanismStubs;
-    std::vector<Stub> CallStubs;
-    std::string Name;
+    StubRange InputStubs;
+    StubRange OutputStubs;
+    StubRange ControlStubs;
+    StubRange MechanismStubs;
+    StubRange CallStubs;
+    std::string_view Name;
     FilePosition Center;
     uint32_t Width;
     uint32_t Height;
     uint32_t Padding;
-    std::string NodeNumber;
-    std::string DRE;
+    std::string_view NodeNumber;
+    std::string_view DRE;
 };
 
 struct NodeNumberSection 
 {
     FilePosition TopLeft;
-    std::string Content;
+    std::string_view Content;
     uint32_t Width;
     uint32_t Height;
 };
@@ -149,7 +101,7 @@ struct NodeNumberSection
 struct TitleSection
 {
     FilePosition TopLeft;
-    std::string Content;
+    std::string_view Content;
     uint32_t Width;
     uint32_t Height;
 };
@@ -157,7 +109,7 @@ struct TitleSection
 struct CNumberSection
 {
     FilePosition TopLeft;
-    std::string Content;
+    std::string_view Content;
     uint32_t Width;
     uint32_t Height;
 };
@@ -180,38 +132,63 @@ struct DiagramFrame
 
 struct ActivityDiagram
 {
-    std::string Title;
+    std::shared_ptr<char> SourceText;
+    std::string_view Title;
     uint32_t Width;
     uint32_t Height;
     std::vector<ActivityBox> Boxes;
-    std::vector<Stub> InputBoundaryStubs;
-    std::vector<Stub> OutputBoundaryStubs;
-    std::vector<Stub> ControlBoundaryStubs;
-    std::vector<Stub> MechanismBoundaryStubs;
+    StubTable Stubs;
+    StubCrossReference CrossReference;
+    StubRange InputBoundaryStubs;
+    StubRange OutputBoundaryStubs;
+    StubRange ControlBoundaryStubs;
+    StubRange MechanismBoundaryStubs;
+    uint32_t NumStubs;
+    uint32_t NumNames;
     DiagramFrame Frame;
 };
 
-struct Model
-{
-    std::string Title;
-    std::vector<ActivityDiagram> ActivityDiagrams;
-};
-
-enum Interface
-{
-    InputInterface,
-    OutputInterface,
-    ControlInterface,
-    MechanismInterface,
-    CallInterface
-};
-
-InputStub LoadInputStub(const pugi::xml_node& InputStubXMLNode, bool Headed);
-OutputStub LoadOutputStub(const pugi::xml_node& OutputStubXMLNode, bool Headed);
-ControlStub LoadControlStub(const pugi::xml_node& ControlStubXMLNode, bool Headed);
-MechanismStub LoadMechanismStub(const pugi::xml_node& MechanismStubXMLNode, bool Headed);
-CallStub LoadCallStub(const pugi::xml_node& CallStubXMLNode, bool Headed);
-ActivityDiagram LoadActivityDiagram(const std::string &FilePath);
+// Reads a model document incrementally, holding only the text of the diagram being read.
+struct ModelStream
+{
+    std::string FilePath;
+    std::ifstream FileStream;
+    std::string Buffer;
+    size_t ScanIndex;
+    size_t DiagramIndex;
+    uint32_t BufferLine;
+    uint32_t BufferColumn;
+    uint32_t Depth;
+    uint32_t DiagramDepth;
+    bool RootFound;
+    bool InsideDiagram;
+    bool FileEnded;
+};
+
+// Name tables only live while a document loads, so they are kept in an arena released with them.
+typedef std::pmr::unordered_map<std::string_view, uint32_t> StubNameTable;
+typedef std::pmr::vector<pugi::xml_node> XMLNodeList;
+
+uint32_t InternStubName(StubNameTable& NameTable, std::string_view Name);
+void ReserveStubTable(StubTable& Stubs, uint32_t NumStubs, uint32_t NumSources);
+StubRange LoadStubRange(const XMLNodeList& StubXMLNodes, Interface Kind, uint32_t OwnerBox, bool Headed,
+    StubTable& Stubs, std::pmr::vector<size_t>& SourceOffsets, std::vector<LoadDiagnostic>& Diagnostics);
+void InternStubNames(StubTable& Stubs, uint32_t FirstStubID, StubNameTable& NameTable);
+void IndexStubReferences(ActivityDiagram& Diagram);
+ActivityDiagram LoadActivityDiagramNode(const pugi::xml_node &ActivityDiagramNode, StubNameTable& NameTable,
+    std::vector<LoadDiagnostic>& Diagnostics, uint32_t MaxThreads);
+void LocateLoadDiagnostics(std::vector<LoadDiagnostic>& Diagnostics, const char* Text, size_t TextSize, size_t DiagramOffset,
+    uint32_t FirstLine, uint32_t FirstColumn);
+void ThrowLoadDiagnostics(const std::vector<LoadDiagnostic>& Diagnostics, const std::string& SourceName);
+std::shared_ptr<char> LoadSourceText(const std::string &FilePath, size_t& TextSize);
+ActivityDiagram LoadActivityDiagramSource(const std::shared_ptr<char>& SourceText, size_t TextSize,
+    std::vector<LoadDiagnostic>& Diagnostics, uint32_t MaxThreads);
+ActivityDiagram LoadActivityDiagramFileSource(const std::string &FilePath, const std::shared_ptr<char>& SourceText, size_t TextSize,
+    uint32_t MaxThreads);
+ActivityDiagram LoadActivityDiagram(const std::string &FilePath, uint32_t MaxThreads);
+ActivityDiagram LoadActivityDiagramText(const std::string &DiagramXML, uint32_t MaxThreads);
+void OpenModelStream(ModelStream& Stream, const std::string& FilePath);
+bool ReadModelStreamDiagram(ModelStream& Stream, ActivityDiagram& NextDiagram, uint32_t MaxThreads);
 
 }
 
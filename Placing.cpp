@@ -6,9 +6,13 @@
 #include <variant>
 #include <libavoid/libavoid.h>
 #include <map>
+#include <memory>
+#include <memory_resource>
 #include <pugixml.hpp>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 #include "Loading.h"
 #include "Layouting.h"
@@ -18,157 +22,69 @@
 namespace IDEF
 {
 
-std::map<Stub, Avoid::ConnEnd> PlaceBoxStubConnEnds(const ActivityDiagram& LayedOutDiagram)
+void PlaceStubConnEnd(const ActivityDiagram& LayedOutDiagram,
+    uint32_t StubID,
+    uint32_t StubColumn,
+    uint32_t StubRow,
+    std::vector<Avoid::ConnEnd>& StubConnEnds)
 {
-    std::map<Stub, Avoid::ConnEnd> BoxStubsMap;
-    uint32_t StubCount;
-    
+    uint32_t AvoidX;
+    uint32_t AvoidY;
+
+    AvoidX = StubColumn;
+    AvoidY = LayedOutDiagram.Height - StubRow;
+    StubConnEnds[StubID] = Avoid::ConnEnd(Avoid::Point(AvoidX, AvoidY));
+}
+
+// A box stub's connection end is at the far end of its line, away from the box.
+void PlaceBoxStubConnEnds(const ActivityDiagram& LayedOutDiagram, std::vector<Avoid::ConnEnd>& StubConnEnds)
+{
+    const StubTable& Stubs = LayedOutDiagram.Stubs;
+
+    StubConnEnds.resize(LayedOutDiagram.NumStubs);
     for (const ActivityBox& SelectedBox : LayedOutDiagram.Boxes)
     {
-        for (Stub SelectedStub : SelectedBox.InputStubs)
+        for (uint32_t StubID = SelectedBox.InputStubs.First; StubID < SelectedBox.InputStubs.End; StubID++)
         {
-            uint32_t StubColumn;
-            uint32_t StubRow;
-            uint32_t AvoidX;
-            uint32_t AvoidY;
-            InputStub SelectedInputStub;
-            Avoid::ConnEnd ConnectionEnd;
-
-            SelectedInputStub = std::get<InputStub>(SelectedStub);
-            StubColumn = SelectedInputStub.Position.Column - SelectedInputStub.Length;
-            StubRow = SelectedInputStub.Position.Row;
-            AvoidX = StubColumn;
-            AvoidY = LayedOutDiagram.Height - StubRow;
-            ConnectionEnd = Avoid::ConnEnd(Avoid::Point(AvoidX, AvoidY));
-            BoxStubsMap.insert({SelectedStub, ConnectionEnd});
+            PlaceStubConnEnd(LayedOutDiagram, StubID, Stubs.Positions[StubID].Column - Stubs.Lengths[StubID], Stubs.Positions[StubID].Row, StubConnEnds);
         }
-        for (Stub SelectedStub : SelectedBox.OutputStubs)
+        for (uint32_t StubID = SelectedBox.OutputStubs.First; StubID < SelectedBox.OutputStubs.End; StubID++)
         {
-            uint32_t StubColumn;
-            uint32_t StubRow;
-            uint32_t AvoidX;
-            uint32_t AvoidY;
-            OutputStub SelectedOutputStub;
-            Avoid::ConnEnd ConnectionEnd;
-           
-            SelectedOutputStub = std::get<OutputStub>(SelectedStub);
-            StubColumn = SelectedOutputStub.Position.Column + SelectedOutputStub.Length;
-            StubRow = SelectedOutputStub.Position.Row;
-            AvoidX = StubColumn;
-            AvoidY = LayedOutDiagram.Height - StubRow;
-            ConnectionEnd = Avoid::ConnEnd(Avoid::Point(AvoidX, AvoidY));
-            BoxStubsMap.insert({SelectedStub, ConnectionEnd});
+            PlaceStubConnEnd(LayedOutDiagram, StubID, Stubs.Positions[StubID].Column + Stubs.Lengths[StubID], Stubs.Positions[StubID].Row, StubConnEnds);
         }
-        for (Stub SelectedStub: SelectedBox.ControlStubs)
+        for (uint32_t StubID = SelectedBox.ControlStubs.First; StubID < SelectedBox.ControlStubs.End; StubID++)
         {
-            uint32_t StubColumn;
-            uint32_t StubRow;
-            uint32_t AvoidX;
-            uint32_t AvoidY;
-            ControlStub SelectedControlStub;
-            Avoid::ConnEnd ConnectionEnd;
-
-            SelectedControlStub = std::get<ControlStub>(SelectedStub);
-            StubColumn = SelectedControlStub.Position.Column;
-            StubRow = SelectedControlStub.Position.Row - SelectedControlStub.Length;
-            AvoidX = StubColumn;
-            AvoidY = LayedOutDiagram.Height - StubRow;
-            ConnectionEnd = Avoid::ConnEnd(Avoid::Point(AvoidX, AvoidY));
-            BoxStubsMap.insert({SelectedStub, ConnectionEnd});
+            PlaceStubConnEnd(LayedOutDiagram, StubID, Stubs.Positions[StubID].Column, Stubs.Positions[StubID].Row - Stubs.Lengths[StubID], StubConnEnds);
         }
-        for (Stub SelectedStub : SelectedBox.MechanismStubs)
+        for (uint32_t StubID = SelectedBox.MechanismStubs.First; StubID < SelectedBox.MechanismStubs.End; StubID++)
         {
-            uint32_t StubColumn;
-            uint32_t StubRow;
-            uint32_t AvoidX;
-            uint32_t AvoidY;
-            Avoid::ConnEnd ConnectionEnd;
-            MechanismStub SelectedMechanismStub;
-
-            SelectedMechanismStub = std::get<MechanismStub>(SelectedStub);
-            StubColumn = SelectedMechanismStub.Position.Column;
-            StubRow = SelectedMechanismStub.Position.Row + SelectedMechanismStub.Length;
-            AvoidX = StubColumn;
-            AvoidY = LayedOutDiagram.Height - StubRow;
-            ConnectionEnd = Avoid::ConnEnd(Avoid::Point(AvoidX, AvoidY));
-            BoxStubsMap.insert({SelectedStub, ConnectionEnd});
+            PlaceStubConnEnd(LayedOutDiagram, StubID, Stubs.Positions[StubID].Column, Stubs.Positions[StubID].Row + Stubs.Lengths[StubID], StubConnEnds);
         }
     }
-
-    return BoxStubsMap;
 }
 
-std::map<Stub, Avoid::ConnEnd> PlaceBoundaryStubConnEnds(const ActivityDiagram& LayedOutDiagram)
+// A boundary stub's connection end is at the inner end of its line, away from the frame.
+void PlaceBoundaryStubConnEnds(const ActivityDiagram& LayedOutDiagram, std::vector<Avoid::ConnEnd>& StubConnEnds)
 {
-    const uint32_t StubLength = 3u;
-    std::map<Stub, Avoid::ConnEnd> BoundaryStubsMap;
+    const StubTable& Stubs = LayedOutDiagram.Stubs;
 
-    for (const Stub& BoundaryStub : LayedOutDiagram.InputBoundaryStubs)
+    StubConnEnds.resize(LayedOutDiagram.NumStubs);
+    for (uint32_t StubID = LayedOutDiagram.InputBoundaryStubs.First; StubID < LayedOutDiagram.InputBoundaryStubs.End; StubID++)
     {
-        uint32_t StubColumn;
-        uint32_t StubRow;
-        uint32_t AvoidX;
-        uint32_t AvoidY;
-        const InputStub& BoundaryInputStub = std::get<InputStub>(BoundaryStub);
-        Avoid::ConnEnd ConnectionEnd;
-
-        StubColumn = BoundaryInputStub.Position.Column + BoundaryInputStub.Length;
-        StubRow = BoundaryInputStub.Position.Row;
-        AvoidX = StubColumn;
-        AvoidY = LayedOutDiagram.Height - StubRow;
-        ConnectionEnd = Avoid::ConnEnd(Avoid::Point(AvoidX, AvoidY));
-        BoundaryStubsMap.insert({BoundaryInputStub, ConnectionEnd});
+        PlaceStubConnEnd(LayedOutDiagram, StubID, Stubs.Positions[StubID].Column + Stubs.Lengths[StubID], Stubs.Positions[StubID].Row, StubConnEnds);
     }
-    for (const Stub BoundaryStub : LayedOutDiagram.OutputBoundaryStubs)
+    for (uint32_t StubID = LayedOutDiagram.OutputBoundaryStubs.First; StubID < LayedOutDiagram.OutputBoundaryStubs.End; StubID++)
     {
-        uint32_t StubColumn;
-        uint32_t StubRow;
-        uint32_t AvoidX;
-        uint32_t AvoidY;
-        const OutputStub& BoundaryOutputStub = std::get<OutputStub>(BoundaryStub);
-        Avoid::ConnEnd ConnectionEnd;
-
-        StubColumn = BoundaryOutputStub.Position.Column - BoundaryOutputStub.Length;
-        StubRow = BoundaryOutputStub.Position.Row;
-        AvoidX = StubColumn;
-        AvoidY = LayedOutDiagram.Height - StubRow;
-        ConnectionEnd = Avoid::ConnEnd(Avoid::Point(AvoidX, AvoidY));
-        BoundaryStubsMap.insert({BoundaryOutputStub, ConnectionEnd});
+        PlaceStubConnEnd(LayedOutDiagram, StubID, Stubs.Positions[StubID].Column - Stubs.Lengths[StubID], Stubs.Positions[StubID].Row, StubConnEnds);
     }
-    for (const Stub BoundaryStub : LayedOutDiagram.ControlBoundaryStubs)
+    for (uint32_t StubID = LayedOutDiagram.ControlBoundaryStubs.First; StubID < LayedOutDiagram.ControlBoundaryStubs.End; StubID++)
     {
-        uint32_t StubColumn;
-        uint32_t StubRow;
-        uint32_t AvoidX;
-        uint32_t AvoidY;
-        const ControlStub& BoundaryControlStub = std::get<ControlStub>(BoundaryStub);
-        Avoid::ConnEnd ConnectionEnd;
-   
-        StubColumn = BoundaryControlStub.Position.Column;
-        StubRow = BoundaryControlStub.Position.Row + BoundaryControlStub.Length;
-        AvoidX = StubColumn;
-        AvoidY = LayedOutDiagram.Height - StubRow;
-        ConnectionEnd = Avoid::ConnEnd(Avoid::Point(AvoidX, AvoidY));
-        BoundaryStubsMap.insert({BoundaryControlStub, ConnectionEnd});
+        PlaceStubConnEnd(LayedOutDiagram, StubID, Stubs.Positions[StubID].Column, Stubs.Positions[StubID].Row + Stubs.Lengths[StubID], StubConnEnds);
     }
-    for (const Stub BoundaryStub : LayedOutDiagram.MechanismBoundaryStubs)
+    for (uint32_t StubID = LayedOutDiagram.MechanismBoundaryStubs.First; StubID < LayedOutDiagram.MechanismBoundaryStubs.End; StubID++)
     {
-        uint32_t StubColumn;
-        uint32_t StubRow;
-        uint32_t AvoidX;
-        uint32_t AvoidY;
-        const MechanismStub& BoundaryMechanismStub = std::get<MechanismStub>(BoundaryStub);
-        Avoid::ConnEnd ConnectionEnd;
-
-        StubColumn = BoundaryMechanismStub.Position.Column;
-        StubRow = BoundaryMechanismStub.Position.Row - BoundaryMechanismStub.Length;
-        AvoidX = StubColumn;
-        AvoidY = LayedOutDiagram.Height - StubRow;
-        ConnectionEnd = Avoid::ConnEnd(Avoid::Point(AvoidX, AvoidY));
-        BoundaryStubsMap.insert({BoundaryMechanismStub, ConnectionEnd});
+        PlaceStubConnEnd(LayedOutDiagram, StubID, Stubs.Positions[StubID].Column, Stubs.Positions[StubID].Row - Stubs.Lengths[StubID], StubConnEnds);
     }
-   
-    return BoundaryStubsMap;
 }
 
 void PlaceObstacles(const ActivityDiagram &LayedoutDiagram, 
@@ -177,6 +93,7 @@ void PlaceObstacles(const ActivityDiagram &LayedoutDiagram,
     uint32_t NumBoxes;
 
     NumBoxes = LayedoutDiagram.Boxes.size();
+    Rectangles.reserve(Rectangles.size() + NumBoxes);
     for (uint32_t BoxIndex = 0u; BoxIndex < NumBoxes; BoxIndex++)
     {
         const ActivityBox &SelectedBox = LayedoutDiagram.Boxes[BoxIndex];
@@ -199,280 +116,108 @@ void PlaceObstacles(const ActivityDiagram &LayedoutDiagram,
     }
 }
 
-Avoid::Router *ConstructRouter(std::map<Stub, Avoid::ConnEnd> &BoxStubsMap,
-                               std::map<Stub, Avoid::ConnEnd>& BoundaryStubsMap,
-                              std::vector<Avoid::Rectangle> &Rectangles)
+// Connects a producer to the stubs referring to its name, in the cross-reference's order. Box inputs and
+// controls are accepted with AcceptInputs, box mechanisms with AcceptMechanisms and boundary
+// outputs with AcceptBoundaryOutputs.
+void ConnectStubConsumers(std::vector<StubConnection>& Connections,
+    const std::vector<Avoid::ConnEnd>& StubConnEnds,
+    const ActivityDiagram& LayedOutDiagram,
+    uint32_t ProducerID,
+    bool AcceptInputs,
+    bool AcceptMechanisms,
+    bool AcceptBoundaryOutputs)
 {
-    Avoid::Router *ConstructedRouter;
-    uint32_t NumRects;
+    const StubTable& Stubs = LayedOutDiagram.Stubs;
+    const StubCrossReference& CrossReference = LayedOutDiagram.CrossReference;
+    uint32_t ProducerNameID;
 
-    ConstructedRouter = new Avoid::Router(Avoid::OrthogonalRouting);
-    NumRects = Rectangles.size();
-    for (uint32_t RectangleIndex = 0u; RectangleIndex < NumRects; RectangleIndex++)
+    ProducerNameID = Stubs.NameIDs[ProducerID];
+    for (uint32_t ReferenceIndex = CrossReference.FirstReferences[ProducerNameID]; ReferenceIndex < CrossReference.FirstReferences[ProducerNameID + 1u]; ReferenceIndex++)
     {
-        Avoid::ShapeRef *ShapeReference;
-
-        Avoid::Rectangle SelectedRectangle = Rectangles[RectangleIndex];
-        ShapeReference = new Avoid::ShapeRef(ConstructedRouter, SelectedRectangle);
-    }
-    // This section connects boundary stubs to box stubs.
-    // TODO move this section into a procedure.
-    for (const std::pair<Stub, Avoid::ConnEnd> &BoundaryStubPair : BoundaryStubsMap)
-    {
-        const Stub& BoundaryStub = BoundaryStubPair.first;
-
-        for (const std::pair<Stub, Avoid::ConnEnd>& BoxStubPair : BoxStubsMap)
+        uint32_t ConsumerID;
+        Interface ConsumerInterface;
+        bool Accepted;
+
+        ConsumerID = CrossReference.ReferenceStubIDs[ReferenceIndex];
+        ConsumerInterface = Stubs.Kinds[ConsumerID];
+        Accepted = false;
+        if (CrossReference.ReferenceBoxes[ReferenceIndex] == BoundaryStubOwner)
         {
-            const Stub& BoxStub = BoxStubPair.first;
-              
-            if (std::holds_alternative<InputStub>(BoundaryStub))
-            {
-                const InputStub& BoundaryInputStub = std::get<InputStub>(BoundaryStub);
-
-                if (std::holds_alternative<InputStub>(BoxStub))
-                {
-                    const InputStub& BoxInputStub = std::get<InputStub>(BoxStub);
-
-                    if (BoxInputStub.Name == BoundaryInputStub.Name)
-                    {
-                        Avoid::ConnRef* NewConn;
-                        
-                        NewConn = new Avoid::ConnRef(ConstructedRouter, BoundaryStubPair.second, BoxStubPair.second);
-                    }
-                    else
-                    {
-                        for (const StubSource& BoxInputSource : BoxInputStub.Sources)
-                        {
-                            if (BoxInputSource.StubName == BoundaryInputStub.Name)
-                            {
-                                Avoid::ConnRef* NewConn;
-                                
-                                NewConn = new Avoid::ConnRef(ConstructedRouter, BoundaryStubPair.second, BoxStubPair.second);
-                            }
-                        }
-                    }
-                }
-                else if (std::holds_alternative<ControlStub>(BoxStub))
-                {
-                    const ControlStub& BoxControlStub = std::get<ControlStub>(BoxStub);
-
-                    if (BoxControlStub.Name == BoundaryInputStub.Name)
-                    {
-                        Avoid::ConnRef* NewConn;
-                        
-                        NewConn = new Avoid::ConnRef(ConstructedRouter, BoundaryStubPair.second, BoxStubPair.second);
-                    }
-                    else
-                    {
-                        for (const StubSource& BoxControlSource : BoxControlStub.Sources)
-                        {
-                            if (BoxControlSource.StubName == BoundaryInputStub.Name)
-                            {
-                                Avoid::ConnRef* NewConn;
-                                
-                                NewConn = new Avoid::ConnRef(ConstructedRouter, BoundaryStubPair.second, BoxStubPair.second);
-                            }
-                        }
-                    }
-                }
-            }
-            else if (std::holds_alternative<ControlStub>(BoundaryStub))
-            {
-                const ControlStub& BoundaryControlStub = std::get<ControlStub>(BoundaryStub);
-
-                if (std::holds_alternative<InputStub>(BoxStub))
-                {
-                    const InputStub& BoxInputStub = std::get<InputStub>(BoxStub);
-
-                    if (BoxInputStub.Name == BoundaryControlStub.Name)
-                    { 
-                        Avoid::ConnRef* NewConn;
-
-                        NewConn = new Avoid::ConnRef(ConstructedRouter, BoundaryStubPair.second, BoxStubPair.second);
-                    }
-                    else
-                    {
-                        for (const StubSource& BoxInputSource : BoxInputStub.Sources)
-                        {
-                            if (BoxInputSource.StubName == BoundaryControlStub.Name)
-                            {
-                                Avoid::ConnRef* NewConn;
-                             
-                                NewConn = new Avoid::ConnRef(ConstructedRouter, BoundaryStubPair.second, BoxStubPair.second);
-                            }
-                        }
-                    }
-                }
-                else if (std::holds_alternative<ControlStub>(BoxStub))
-                {
-                    const ControlStub& BoxControlStub = std::get<ControlStub>(BoxStub);
-
-                    if (BoxControlStub.Name == BoundaryControlStub.Name)
-                    {
-                        Avoid::ConnRef* NewConn;
-
-                        NewConn = new Avoid::ConnRef(ConstructedRouter, BoundaryStubPair.second, BoxStubPair.second);
-                    }
-                    else
-                    {
-                        for (const StubSource& BoxControlSource : BoxControlStub.Sources)
-                        {
-                            if (BoxControlSource.StubName == BoundaryControlStub.Name)
-                            {
-                                Avoid::ConnRef* NewConn;
-                          
-                                NewConn = new Avoid::ConnRef(ConstructedRouter, BoundaryStubPair.second, BoxStubPair.second);
-                            }
-                        }
-                    }
-                }
-            }
-            else if (std::holds_alternative<MechanismStub>(BoundaryStub))
-            {
-                const MechanismStub& BoundaryMechanismStub = std::get<MechanismStub>(BoundaryStub);
+            Accepted = (ConsumerInterface == OutputInterface) && (AcceptBoundaryOutputs == true);
+        }
+        else if ((ConsumerInterface == InputInterface) || (ConsumerInterface == ControlInterface))
+        {
+            Accepted = AcceptInputs;
+        }
+        else if (ConsumerInterface == MechanismInterface)
+        {
+            Accepted = AcceptMechanisms;
+        }
+        if (Accepted == true)
+        {
+            StubConnection NewConnection;
 
-                if (std::holds_alternative<MechanismStub>(BoxStub))
-                {
-                    const MechanismStub& BoxMechanismStub = std::get<MechanismStub>(BoxStub);
+            NewConnection.SourceEnd = StubConnEnds[ProducerID];
+            NewConnection.TargetEnd = StubConnEnds[ConsumerID];
+            Connections.push_back(NewConnection);
+        }
+    }
+}
 
-                    if (BoxMechanismStub.Name == BoundaryMechanismStub.Name)
-                    { 
-                        Avoid::ConnRef* NewConn;
+std::vector<StubConnection> ResolveStubConnections(const ActivityDiagram& LayedOutDiagram,
+    const std::vector<Avoid::ConnEnd>& StubConnEnds)
+{
+    std::vector<StubConnection> Connections;
 
-                        NewConn = new Avoid::ConnRef(ConstructedRouter, BoundaryStubPair.second, BoxStubPair.second);
-                    }
-                    else
-                    {
-                        for (const StubSource& BoxMechanismSource : BoxMechanismStub.Sources)
-                        {
-                            if (BoxMechanismSource.StubName == BoundaryMechanismStub.Name)
-                            {
-                                Avoid::ConnRef* NewConn;
-                                
-                                NewConn = new Avoid::ConnRef(ConstructedRouter, BoundaryStubPair.second, BoxStubPair.second);
-                            }
-                        }
-                    }
-                }
-            }
-        }
+    // Boundary inputs and controls feed box inputs and controls, boundary mechanisms feed box mechanisms.
+    for (uint32_t StubID = LayedOutDiagram.InputBoundaryStubs.First; StubID < LayedOutDiagram.InputBoundaryStubs.End; StubID++)
+    {
+        ConnectStubConsumers(Connections, StubConnEnds, LayedOutDiagram, StubID, true, false, false);
     }
-    // This section connects box stubs to other boxes and boundary stubs.
-    // TODO move this to seperate functions. 
-    for (const std::pair<Stub, Avoid::ConnEnd> &BoxStubPair : BoxStubsMap)
+    for (uint32_t StubID = LayedOutDiagram.ControlBoundaryStubs.First; StubID < LayedOutDiagram.ControlBoundaryStubs.End; StubID++)
     {
-        const Stub& FirstStub = BoxStubPair.first;
-
-        for (const std::pair<Stub, Avoid::ConnEnd> &OtherBoxStubPair : BoxStubsMap)
+        ConnectStubConsumers(Connections, StubConnEnds, LayedOutDiagram, StubID, true, false, false);
+    }
+    for (uint32_t StubID = LayedOutDiagram.MechanismBoundaryStubs.First; StubID < LayedOutDiagram.MechanismBoundaryStubs.End; StubID++)
+    {
+        ConnectStubConsumers(Connections, StubConnEnds, LayedOutDiagram, StubID, false, true, false);
+    }
+    // Box outputs feed every box interface first and then the boundary outputs.
+    for (const ActivityBox& SelectedBox : LayedOutDiagram.Boxes)
+    {
+        for (uint32_t StubID = SelectedBox.OutputStubs.First; StubID < SelectedBox.OutputStubs.End; StubID++)
         {
-            const Stub& OtherStub = OtherBoxStubPair.first;
-
-            if (std::holds_alternative<OutputStub>(FirstStub))
-            {
-                const OutputStub& FirstOutputStub = std::get<OutputStub>(FirstStub);
-                
-                if (std::holds_alternative<InputStub>(OtherStub))
-                {
-                    const InputStub& OtherInputStub = std::get<InputStub>(OtherStub);
-    
-                    if (FirstOutputStub.Name == OtherInputStub.Name)
-                    {
-                        Avoid::ConnRef* NewRef;
-    
-                        NewRef = new Avoid::ConnRef(ConstructedRouter, BoxStubPair.second, OtherBoxStubPair.second);
-                    }
-                    else
-                    {
-                        for (const StubSource& Source : OtherInputStub.Sources)
-                        {
-                            if (Source.StubName == FirstOutputStub.Name)
-                            {
-                                Avoid::ConnRef* NewRef;
-
-                                NewRef = new Avoid::ConnRef(ConstructedRouter, BoxStubPair.second, OtherBoxStubPair.second);
-                            }
-                        }
-                    }
-                }
-                else if (std::holds_alternative<ControlStub>(OtherStub))
-                {
-                    const ControlStub& OtherControlStub = std::get<ControlStub>(OtherStub);
-
-                    if (FirstOutputStub.Name == OtherControlStub.Name)
-                    {
-                        Avoid::ConnRef* NewRef;
-                        
-                        NewRef = new Avoid::ConnRef(ConstructedRouter, BoxStubPair.second, OtherBoxStubPair.second);
-                    }
-                    else
-                    {
-                        for (const StubSource& Source : OtherControlStub.Sources)
-                        {
-                            if (Source.StubName == FirstOutputStub.Name)
-                            {
-                                Avoid::ConnRef* NewRef;
-
-                                NewRef = new Avoid::ConnRef(ConstructedRouter, BoxStubPair.second, OtherBoxStubPair.second);                            }
-                        }
-                    }
-                }
-                else if (std::holds_alternative<MechanismStub>(OtherStub))
-                {
-                    const MechanismStub& OtherMechanismStub = std::get<MechanismStub>(OtherStub);
-
-                    if (FirstOutputStub.Name == OtherMechanismStub.Name)
-                    {
-                        Avoid::ConnRef* NewRef;
-                        
-                        NewRef = new Avoid::ConnRef(ConstructedRouter, BoxStubPair.second, OtherBoxStubPair.second);
-                    }
-                    else
-                    {
-                        for (const StubSource& Source : OtherMechanismStub.Sources)
-                        {
-                            if (Source.StubName == FirstOutputStub.Name)
-                            {
-                                Avoid::ConnRef* NewRef;
-
-                                NewRef = new Avoid::ConnRef(ConstructedRouter, BoxStubPair.second, OtherBoxStubPair.second);                            }
-                        }
-                    }
-                }
-            }
+            ConnectStubConsumers(Connections, StubConnEnds, LayedOutDiagram, StubID, true, true, false);
+            ConnectStubConsumers(Connections, StubConnEnds, LayedOutDiagram, StubID, false, false, true);
         }
-        for (const std::pair<Stub, Avoid::ConnEnd> &BoundaryBoxStubPair : BoundaryStubsMap)
-        {
-            const Stub& BoundaryStub = BoundaryBoxStubPair.first;
+    }
 
-            if (std::holds_alternative<OutputStub>(FirstStub))
-            {
-                const OutputStub& FirstOutputStub = std::get<OutputStub>(FirstStub);
+    return Connections;
+}
 
-                if (std::holds_alternative<OutputStub>(BoundaryStub))
-                {
-                    const OutputStub& BoundaryOutputStub = std::get<OutputStub>(BoundaryStub);
+Avoid::Router *ConstructRouter(const ActivityDiagram& LayedOutDiagram,
+    const std::vector<Avoid::ConnEnd>& StubConnEnds,
+    std::vector<Avoid::Rectangle> &Rectangles)
+{
+    Avoid::Router *ConstructedRouter;
+    uint32_t NumRects;
+    std::vector<StubConnection> Connections;
 
-                    if (FirstOutputStub.Name == BoundaryOutputStub.Name)
-                    {
-                        Avoid::ConnRef* NewRef;
+    ConstructedRouter = new Avoid::Router(Avoid::OrthogonalRouting);
+    NumRects = Rectangles.size();
+    for (uint32_t RectangleIndex = 0u; RectangleIndex < NumRects; RectangleIndex++)
+    {
+        Avoid::ShapeRef *ShapeReference;
 
-                        NewRef = new Avoid::ConnRef(ConstructedRouter, BoxStubPair.second, BoundaryBoxStubPair.second);
-                    }
-                    else
-                    {
-                        for (const StubSource& Source : BoundaryOutputStub.Sources)
-                        {
-                            if (Source.StubName == FirstOutputStub.Name)
-                            {
-                                Avoid::ConnRef* NewRef;
-    
-                                NewRef = new Avoid::ConnRef(ConstructedRouter, BoxStubPair.second, BoundaryBoxStubPair.second);
-                            }
-                        }
-                    }
-                }
-            }
-        }
+        Avoid::Rectangle SelectedRectangle = Rectangles[RectangleIndex];
+        ShapeReference = new Avoid::ShapeRef(ConstructedRouter, SelectedRectangle);
+    }
+    Connections = ResolveStubConnections(LayedOutDiagram, StubConnEnds);
+    for (const StubConnection& Connection : Connections)
+    {
+        Avoid::ConnRef* NewConn;
+
+        NewConn = new Avoid::ConnRef(ConstructedRouter, Connection.SourceEnd, Connection.TargetEnd);
     }
     ConstructedRouter->processTransaction();
     
@@ -4,15 +4,24 @@
 namespace IDEF
 {
 
-std::map<Stub, Avoid::ConnEnd> PlaceBoxStubConnEnds(const ActivityDiagram& LayedOutDiagram);
+struct StubConnection
+{
+    Avoid::ConnEnd SourceEnd;
+    Avoid::ConnEnd TargetEnd;
+};
+
+void PlaceBoxStubConnEnds(const ActivityDiagram& LayedOutDiagram, std::vector<Avoid::ConnEnd>& StubConnEnds);
+
+void PlaceBoundaryStubConnEnds(const ActivityDiagram& LayedOutDiagram, std::vector<Avoid::ConnEnd>& StubConnEnds);
 
-std::map<Stub, Avoid::ConnEnd> PlaceBoundaryStubConnEnds(const ActivityDiagram& LayedOutDiagram);
+std::vector<StubConnection> ResolveStubConnections(const ActivityDiagram& LayedOutDiagram,
+    const std::vector<Avoid::ConnEnd>& StubConnEnds);
 
 void PlaceObstacles(const ActivityDiagram &LayedoutDiagram, 
     std::vector<Avoid::Rectangle> &Rectangles);
 
-Avoid::Router *ConstructRouter(std::map<Stub, Avoid::ConnEnd> &BoxStubsMap,
-    std::map<Stub, Avoid::ConnEnd>& BoundaryStubsMap,
+Avoid::Router *ConstructRouter(const ActivityDiagram& LayedOutDiagram,
+    const std::vector<Avoid::ConnEnd>& StubConnEnds,
     std::vector<Avoid::Rectangle> &Rectangles);
 
 }
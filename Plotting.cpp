@@ -0,0 +1,375 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <variant>
+#include <libavoid/libavoid.h>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <pugixml.hpp>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <thread>
+#include <vector>
+
+#include "Loading.h"
+#include "Layouting.h"
+#include "Placing.h"
+#include "Drawing.h"
+#include "Plotting.h"
+#include "Caching.h"
+#include "Fitting.h"
+
+namespace IDEF
+{
+
+void WriteDiagram(const DiagramRaster& Diagram, const std::string& OutputFilePath)
+{
+    std::fstream OutputFileStream;
+
+    OutputFileStream.open(OutputFilePath, std::ios_base::out | std::ios_base::binary);
+    if (OutputFileStream.is_open() == false)
+    {
+        throw std::runtime_error("Could not open the output file: " + OutputFilePath);
+    }
+    OutputFileStream.write(Diagram.Cells.data(), Diagram.Cells.size());
+    OutputFileStream.close();
+}
+
+DiagramRaster RenderLayedOutActivityDiagram(const ActivityDiagram& LayedOutDiagram)
+{
+    std::vector<Avoid::ConnEnd> StubConnEnds;
+    std::vector<Avoid::Rectangle> Obstacles;
+    Avoid::Router *Router;
+    DiagramRaster Diagram;
+
+    PlaceObstacles(LayedOutDiagram, Obstacles);
+    PlaceBoxStubConnEnds(LayedOutDiagram, StubConnEnds);
+    PlaceBoundaryStubConnEnds(LayedOutDiagram, StubConnEnds);
+    Router = ConstructRouter(LayedOutDiagram, StubConnEnds, Obstacles);
+    try
+    {
+        Diagram = DrawDiagram(LayedOutDiagram, Router);
+    }
+    catch (...)
+    {
+        delete Router;
+        throw;
+    }
+    delete Router;
+
+    return Diagram;
+}
+
+DiagramRaster RenderActivityDiagram(ActivityDiagram& LoadedDiagram, const PlotJob& Job)
+{
+    LayoutActivityDiagram(LoadedDiagram, Job.DiagramWidth, Job.DiagramHeight, Job.BoxWidth, Job.BoxHeight, Job.BoxXGap, Job.BoxYGap, Job.Layout);
+
+    return RenderLayedOutActivityDiagram(LoadedDiagram);
+}
+
+void PlotActivityDiagram(ActivityDiagram& LoadedDiagram, const PlotJob& Job)
+{
+    DiagramRaster Diagram;
+
+    Diagram = RenderActivityDiagram(LoadedDiagram, Job);
+    WriteDiagram(Diagram, Job.OutputFilePath);
+}
+
+// NumThreads bounds the threads loading and fitting may start, batch workers pass 1.
+void PlotActivityDiagramFile(const PlotJob& Job, uint32_t NumThreads)
+{
+    ActivityDiagram LoadedDiagram;
+
+    if (Job.AutoFit == true)
+    {
+        PlotFittedActivityDiagramFile(Job, NumThreads);
+        return;
+    }
+    if (Job.UseCache == true)
+    {
+        LoadedDiagram = LoadLayedOutDiagramCached(Job, NumThreads);
+        WriteDiagram(RenderLayedOutActivityDiagram(LoadedDiagram), Job.OutputFilePath);
+        return;
+    }
+    LoadedDiagram = LoadActivityDiagram(Job.InputFilePath, NumThreads);
+    PlotActivityDiagram(LoadedDiagram, Job);
+}
+
+// Each manifest line holds the same eight parameters as a single plot, or only the input and
+// output paths to have the sizes fitted. Blank lines and lines starting with '#' are skipped.
+std::vector<PlotJob> LoadPlotJobs(std::istream& ManifestStream)
+{
+    std::vector<PlotJob> Jobs;
+    std::string Line;
+    uint32_t LineNumber;
+
+    LineNumber = 0u;
+    while (std::getline(ManifestStream, Line))
+    {
+        std::istringstream LineStream(Line);
+        PlotJob NewJob;
+        std::string Trailing;
+        size_t FirstCharIndex;
+
+        LineNumber++;
+        FirstCharIndex = Line.find_first_not_of(" \t\r");
+        if ((FirstCharIndex == std::string::npos) || (Line[FirstCharIndex] == '#'))
+        {
+            continue;
+        }
+        LineStream >> NewJob.InputFilePath >> NewJob.OutputFilePath;
+        NewJob.UseCache = false;
+        NewJob.Layout = DiagonalBoxLayout;
+        NewJob.AutoFit = (LineStream.eof() == true) || ((LineStream >> std::ws).eof() == true);
+        if (NewJob.AutoFit == false)
+        {
+            LineStream >> NewJob.DiagramWidth >> NewJob.DiagramHeight;
+            LineStream >> NewJob.BoxWidth >> NewJob.BoxHeight;
+            LineStream >> NewJob.BoxXGap >> NewJob.BoxYGap;
+        }
+        if (LineStream.fail() || (LineStream >> Trailing))
+        {
+            throw std::runtime_error("Malformed manifest line " + std::to_string(LineNumber) + ": " + Line);
+        }
+        Jobs.push_back(NewJob);
+    }
+
+    return Jobs;
+}
+
+void PlotWorker(std::vector<PlotResult>& Results,
+    const std::function<void(uint32_t)>& PlotTask,
+    std::atomic<uint32_t>& NextTaskIndex)
+{
+    uint32_t NumTasks;
+    uint32_t TaskIndex;
+
+    NumTasks = Results.size();
+    for (TaskIndex = NextTaskIndex++; TaskIndex < NumTasks; TaskIndex = NextTaskIndex++)
+    {
+        PlotResult& Result = Results[TaskIndex];
+
+        try
+        {
+            PlotTask(TaskIndex);
+            Result.Succeeded = true;
+        }
+        catch (const std::exception& Exception)
+        {
+            Result.Succeeded = false;
+            Result.ErrorMessage = Exception.what();
+        }
+    }
+}
+
+// Tasks are independent so each worker pulls the next unclaimed index, one result slot per task.
+std::vector<PlotResult> RunPlotTasks(uint32_t NumTasks, uint32_t NumThreads, const std::function<void(uint32_t)>& PlotTask)
+{
+    std::vector<PlotResult> Results;
+    std::vector<std::thread> Workers;
+    std::atomic<uint32_t> NextTaskIndex;
+
+    Results.resize(NumTasks);
+    NextTaskIndex = 0u;
+    NumThreads = std::max(1u, std::min(NumThreads, NumTasks));
+    for (uint32_t ThreadIndex = 1u; ThreadIndex < NumThreads; ThreadIndex++)
+    {
+        Workers.emplace_back(PlotWorker, std::ref(Results), std::cref(PlotTask), std::ref(NextTaskIndex));
+    }
+    PlotWorker(Results, PlotTask, NextTaskIndex);
+    for (std::thread& Worker : Workers)
+    {
+        Worker.join();
+    }
+
+    return Results;
+}
+
+// Each job builds its own router so nothing is shared between the workers.
+std::vector<PlotResult> PlotBatch(const std::vector<PlotJob>& Jobs, uint32_t NumThreads)
+{
+    return RunPlotTasks(Jobs.size(), NumThreads, [&Jobs](uint32_t JobIndex)
+    {
+        PlotActivityDiagramFile(Jobs[JobIndex], 1u);
+    });
+}
+
+// Diagram "A2" of a model plotted to "Out.txt" is written to "Out_A2.txt". Diagrams without a
+// number, or whose number could lead out of the output's directory, use their position in the
+// model instead.
+std::string ModelDiagramFilePath(const std::string& OutputFilePath, const ActivityDiagram& Diagram, uint32_t DiagramIndex)
+{
+    const NodeNumberSection& DiagramNumberSection = std::get<NodeNumberSection>(Diagram.Frame.BottomBar.NodeNumberSection);
+    std::string DiagramName;
+    size_t ExtensionIndex;
+    size_t DirectoryIndex;
+
+    DiagramName = DiagramNumberSection.Content;
+    if (DiagramName.empty() || (DiagramName.find_first_of("/\\") != std::string::npos) ||
+        (DiagramName.find("..") != std::string::npos))
+    {
+        DiagramName = std::to_string(DiagramIndex);
+    }
+    ExtensionIndex = OutputFilePath.find_last_of('.');
+    DirectoryIndex = OutputFilePath.find_last_of('/');
+    if ((ExtensionIndex == std::string::npos) || ((DirectoryIndex != std::string::npos) && (ExtensionIndex < DirectoryIndex)))
+    {
+        return OutputFilePath + "_" + DiagramName;
+    }
+
+    return OutputFilePath.substr(0u, ExtensionIndex) + "_" + DiagramName + OutputFilePath.substr(ExtensionIndex);
+}
+
+// Diagrams waiting to be plotted, the reader blocks while the queue is full so only a bounded
+// number of loaded diagrams exist at once however large the model file is.
+struct ModelDiagramQueue
+{
+    std::mutex QueueMutex;
+    std::condition_variable NotEmptyCondition;
+    std::condition_variable NotFullCondition;
+    std::deque<std::pair<uint32_t, ActivityDiagram>> Diagrams;
+    uint32_t Capacity;
+    bool Closed;
+};
+
+void PlotQueuedDiagrams(ModelDiagramQueue& Queue, const PlotJob& Job, const std::vector<std::string>& OutputFilePaths,
+    std::vector<PlotResult>& Results, std::mutex& ResultsMutex)
+{
+    while (true)
+    {
+        std::pair<uint32_t, ActivityDiagram> QueuedDiagram;
+        PlotJob DiagramJob;
+        PlotResult Result;
+
+        {
+            std::unique_lock<std::mutex> QueueLock(Queue.QueueMutex);
+
+            Queue.NotEmptyCondition.wait(QueueLock, [&Queue]()
+            {
+                return (Queue.Diagrams.empty() == false) || (Queue.Closed == true);
+            });
+            if (Queue.Diagrams.empty() == true)
+            {
+                return;
+            }
+            QueuedDiagram = std::move(Queue.Diagrams.front());
+            Queue.Diagrams.pop_front();
+        }
+        Queue.NotFullCondition.notify_one();
+        {
+            std::lock_guard<std::mutex> ResultsLock(ResultsMutex);
+
+            DiagramJob = Job;
+            DiagramJob.OutputFilePath = OutputFilePaths[QueuedDiagram.first];
+        }
+        try
+        {
+            PlotActivityDiagram(QueuedDiagram.second, DiagramJob);
+            Result.Succeeded = true;
+        }
+        catch (const std::exception& Exception)
+        {
+            Result.Succeeded = false;
+            Result.ErrorMessage = Exception.what();
+        }
+        {
+            std::lock_guard<std::mutex> ResultsLock(ResultsMutex);
+
+            Results[QueuedDiagram.first] = Result;
+        }
+    }
+}
+
+void CloseModelDiagramQueue(ModelDiagramQueue& Queue, std::vector<std::thread>& Workers)
+{
+    {
+        std::lock_guard<std::mutex> QueueLock(Queue.QueueMutex);
+
+        Queue.Closed = true;
+    }
+    Queue.NotEmptyCondition.notify_all();
+    for (std::thread& Worker : Workers)
+    {
+        Worker.join();
+    }
+}
+
+// Streams the model file, its diagrams are loaded one at a time on this thread and plotted by
+// the workers while the next one is read. The workers already fill the threads, so each diagram
+// loads on this thread alone.
+std::vector<PlotResult> PlotModelFile(const PlotJob& Job, uint32_t NumThreads, std::vector<std::string>& OutputFilePaths)
+{
+    ModelStream Stream;
+    ModelDiagramQueue Queue;
+    std::vector<PlotResult> Results;
+    std::mutex ResultsMutex;
+    std::vector<std::thread> Workers;
+    ActivityDiagram NextDiagram;
+    uint32_t DiagramIndex;
+
+    OpenModelStream(Stream, Job.InputFilePath);
+    OutputFilePaths.clear();
+    Queue.Capacity = std::max(1u, NumThreads);
+    Queue.Closed = false;
+    for (uint32_t ThreadIndex = 0u; ThreadIndex < Queue.Capacity; ThreadIndex++)
+    {
+        Workers.emplace_back(PlotQueuedDiagrams, std::ref(Queue), std::cref(Job), std::cref(OutputFilePaths),
+            std::ref(Results), std::ref(ResultsMutex));
+    }
+    try
+    {
+        for (DiagramIndex = 0u; ReadModelStreamDiagram(Stream, NextDiagram, 1u) == true; DiagramIndex++)
+        {
+            std::string OutputFilePath;
+            bool DuplicateFilePath;
+
+            OutputFilePath = ModelDiagramFilePath(Job.OutputFilePath, NextDiagram, DiagramIndex);
+            {
+                std::lock_guard<std::mutex> ResultsLock(ResultsMutex);
+
+                DuplicateFilePath = std::find(OutputFilePaths.begin(), OutputFilePaths.end(), OutputFilePath) != OutputFilePaths.end();
+                OutputFilePaths.push_back(OutputFilePath);
+                Results.push_back(PlotResult());
+                if (DuplicateFilePath == true)
+                {
+                    Results.back().Succeeded = false;
+                    Results.back().ErrorMessage = "Two model diagrams would both be written to " + OutputFilePath;
+                }
+            }
+            if (DuplicateFilePath == false)
+            {
+                std::unique_lock<std::mutex> QueueLock(Queue.QueueMutex);
+
+                Queue.NotFullCondition.wait(QueueLock, [&Queue]()
+                {
+                    return Queue.Diagrams.size() < Queue.Capacity;
+                });
+                Queue.Diagrams.emplace_back(DiagramIndex, std::move(NextDiagram));
+                QueueLock.unlock();
+                Queue.NotEmptyCondition.notify_one();
+            }
+        }
+    }
+    catch (...)
+    {
+        CloseModelDiagramQueue(Queue, Workers);
+        throw;
+    }
+    CloseModelDiagramQueue(Queue, Workers);
+
+    return Results;
+}
+
+}
@@ -0,0 +1,41 @@
+#ifndef PLOTTING_H
+#define PLOTTING_H
+
+namespace IDEF
+{
+
+struct PlotJob
+{
+    std::string InputFilePath;
+    std::string OutputFilePath;
+    uint32_t DiagramWidth;
+    uint32_t DiagramHeight;
+    uint32_t BoxWidth;
+    uint32_t BoxHeight;
+    uint32_t BoxXGap;
+    uint32_t BoxYGap;
+    bool UseCache;
+    bool AutoFit;
+    BoxLayout Layout;
+};
+
+struct PlotResult
+{
+    bool Succeeded;
+    std::string ErrorMessage;
+};
+
+void WriteDiagram(const DiagramRaster& Diagram, const std::string& OutputFilePath);
+DiagramRaster RenderLayedOutActivityDiagram(const ActivityDiagram& LayedOutDiagram);
+DiagramRaster RenderActivityDiagram(ActivityDiagram& LoadedDiagram, const PlotJob& Job);
+void PlotActivityDiagram(ActivityDiagram& LoadedDiagram, const PlotJob& Job);
+void PlotActivityDiagramFile(const PlotJob& Job, uint32_t NumThreads);
+std::vector<PlotJob> LoadPlotJobs(std::istream& ManifestStream);
+std::vector<PlotResult> RunPlotTasks(uint32_t NumTasks, uint32_t NumThreads, const std::function<void(uint32_t)>& PlotTask);
+std::vector<PlotResult> PlotBatch(const std::vector<PlotJob>& Jobs, uint32_t NumThreads);
+std::string ModelDiagramFilePath(const std::string& OutputFilePath, const ActivityDiagram& Diagram, uint32_t DiagramIndex);
+std::vector<PlotResult> PlotModelFile(const PlotJob& Job, uint32_t NumThreads, std::vector<std::string>& OutputFilePaths);
+
+}
+
+#endif
@@ -0,0 +1,458 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <variant>
+#include <libavoid/libavoid.h>
+#include <map>
+#include <pugixml.hpp>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <thread>
+#include <utility>
+#include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "Loading.h"
+#include "Layouting.h"
+#include "Drawing.h"
+#include "Plotting.h"
+#include "Editing.h"
+#include "Serving.h"
+
+namespace IDEF
+{
+
+// Requests announcing more XML than this are answered as malformed before anything is allocated.
+const size_t MaxRequestXMLBytes = 64u << 20u;
+
+// A request is a header line followed by exactly the announced number of XML bytes:
+// {PLOT or EDIT} {RequestID} {DiagramWidth} {DiagramHeight} {BoxWidth} {BoxHeight} {BoxXGap} {BoxYGap} {XMLByteCount}
+bool ReadRenderRequest(FILE* RequestFile, RenderRequest& Request)
+{
+    std::string HeaderLine;
+    std::istringstream HeaderStream;
+    std::string Command;
+    size_t XMLByteCount;
+    int ReadChar;
+
+    HeaderLine.clear();
+    while (HeaderLine.empty())
+    {
+        for (ReadChar = fgetc(RequestFile); (ReadChar != EOF) && (ReadChar != '\n'); ReadChar = fgetc(RequestFile))
+        {
+            if (ReadChar != '\r')
+            {
+                HeaderLine.push_back((char)ReadChar);
+            }
+        }
+        if ((ReadChar == EOF) && HeaderLine.empty())
+        {
+            return false;
+        }
+    }
+    HeaderStream.str(HeaderLine);
+    HeaderStream >> Command >> Request.RequestID;
+    HeaderStream >> Request.Job.DiagramWidth >> Request.Job.DiagramHeight;
+    HeaderStream >> Request.Job.BoxWidth >> Request.Job.BoxHeight;
+    HeaderStream >> Request.Job.BoxXGap >> Request.Job.BoxYGap;
+    HeaderStream >> XMLByteCount;
+    Request.Job.UseCache = false;
+    Request.Job.AutoFit = false;
+    Request.Job.Layout = DiagonalBoxLayout;
+    Request.Edit = (Command == "EDIT");
+    if (HeaderStream.fail() || ((Command != "PLOT") && (Command != "EDIT")))
+    {
+        throw std::runtime_error("Malformed request header: " + HeaderLine);
+    }
+    if (XMLByteCount > MaxRequestXMLBytes)
+    {
+        throw std::runtime_error("Request " + Request.RequestID + " announces " + std::to_string(XMLByteCount) +
+            " XML bytes, more than the " + std::to_string(MaxRequestXMLBytes) + " a request may hold.");
+    }
+    Request.DiagramXML.resize(XMLByteCount);
+    if (fread(Request.DiagramXML.data(), 1u, XMLByteCount, RequestFile) != XMLByteCount)
+    {
+        throw std::runtime_error("Request " + Request.RequestID + " ended before its XML did.");
+    }
+
+    return true;
+}
+
+// A response mirrors the request framing, the body is the rendered diagram or the error message:
+// {OK or ERROR} {RequestID} {QueueMicroseconds} {RenderMicroseconds} {BodyByteCount}
+// A client that went away fails the write, the channel is then marked closed and later responses
+// to it are dropped.
+void WriteRenderResponse(ResponseChannel& Channel, const std::string& Status, const std::string& RequestID,
+    uint64_t QueueMicroseconds, uint64_t RenderMicroseconds, const std::string& Body)
+{
+    std::string Header;
+
+    Header = Status + " " + RequestID + " " + std::to_string(QueueMicroseconds) + " ";
+    Header += std::to_string(RenderMicroseconds) + " " + std::to_string(Body.size()) + "\n";
+    std::lock_guard<std::mutex> WriteLock(Channel.WriteMutex);
+    if (Channel.Closed == true)
+    {
+        return;
+    }
+    if ((fwrite(Header.data(), 1u, Header.size(), Channel.ResponseFile) != Header.size()) ||
+        (fwrite(Body.data(), 1u, Body.size(), Channel.ResponseFile) != Body.size()) ||
+        (fflush(Channel.ResponseFile) != 0))
+    {
+        Channel.Closed = true;
+    }
+}
+
+// Writing to a client that disconnected raises SIGPIPE, which would end the whole server, so it is
+// ignored and the failed write closes only that client's channel.
+void IgnoreBrokenPipes()
+{
+#if defined(__unix__) || defined(__APPLE__)
+    signal(SIGPIPE, SIG_IGN);
+#endif
+}
+
+void RenderQueuedRequest(QueuedRequest& Queued)
+{
+    std::chrono::steady_clock::time_point StartTime;
+    std::chrono::steady_clock::time_point EndTime;
+    uint64_t QueueMicroseconds;
+    uint64_t RenderMicroseconds;
+    std::string Status;
+    std::string Body;
+
+    StartTime = std::chrono::steady_clock::now();
+    try
+    {
+        ActivityDiagram LoadedDiagram;
+        DiagramRaster Diagram;
+
+        LoadedDiagram = LoadActivityDiagramText(Queued.Request.DiagramXML, 1u);
+        Diagram = RenderActivityDiagram(LoadedDiagram, Queued.Request.Job);
+        Body = std::move(Diagram.Cells);
+        Status = "OK";
+    }
+    catch (const std::exception& Exception)
+    {
+        Body = Exception.what();
+        Status = "ERROR";
+    }
+    EndTime = std::chrono::steady_clock::now();
+    QueueMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>(StartTime - Queued.ReceivedTime).count();
+    RenderMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>(EndTime - StartTime).count();
+    WriteRenderResponse(*Queued.Channel, Status, Queued.Request.RequestID, QueueMicroseconds, RenderMicroseconds, Body);
+}
+
+void RenderWorker(RenderQueue& Queue)
+{
+    while (true)
+    {
+        QueuedRequest Queued;
+
+        {
+            std::unique_lock<std::mutex> QueueLock(Queue.QueueMutex);
+
+            Queue.NotEmptyCondition.wait(QueueLock, [&Queue]() { return Queue.Closed || !Queue.Requests.empty(); });
+            if (Queue.Requests.empty())
+            {
+                return;
+            }
+            Queued = std::move(Queue.Requests.front());
+            Queue.Requests.pop_front();
+        }
+        Queue.NotFullCondition.notify_one();
+        RenderQueuedRequest(Queued);
+    }
+}
+
+// The queue holds at most one waiting request per worker, so a client sending faster than the
+// workers render is held back while reading instead of growing the queue.
+void StartRenderWorkers(RenderQueue& Queue, uint32_t NumThreads, std::vector<std::thread>& Workers)
+{
+    Queue.Capacity = std::max(1u, NumThreads);
+    Queue.Closed = false;
+    for (uint32_t ThreadIndex = 0u; ThreadIndex < NumThreads; ThreadIndex++)
+    {
+        Workers.emplace_back(RenderWorker, std::ref(Queue));
+    }
+}
+
+// Workers finish every request already queued before they exit.
+void StopRenderWorkers(RenderQueue& Queue, std::vector<std::thread>& Workers)
+{
+    {
+        std::lock_guard<std::mutex> QueueLock(Queue.QueueMutex);
+
+        Queue.Closed = true;
+    }
+    Queue.NotEmptyCondition.notify_all();
+    Queue.NotFullCondition.notify_all();
+    for (std::thread& Worker : Workers)
+    {
+        Worker.join();
+    }
+    Workers.clear();
+}
+
+// Edits of one connection share a retained router, so they are rendered in order on the reading
+// thread. Changing the diagram or box dimensions starts a new session, as does a failed update
+// since the router may have been left half updated.
+void RenderEditRequest(EditSession& Session, bool& SessionOpen, const RenderRequest& Request,
+    const std::shared_ptr<ResponseChannel>& Channel)
+{
+    std::chrono::steady_clock::time_point StartTime;
+    std::chrono::steady_clock::time_point EndTime;
+    uint64_t RenderMicroseconds;
+    std::string Status;
+    std::string Body;
+    const PlotJob& Job = Request.Job;
+
+    StartTime = std::chrono::steady_clock::now();
+    if ((SessionOpen == true) && ((Session.Job.DiagramWidth != Job.DiagramWidth) ||
+        (Session.Job.DiagramHeight != Job.DiagramHeight) || (Session.Job.BoxWidth != Job.BoxWidth) ||
+        (Session.Job.BoxHeight != Job.BoxHeight) || (Session.Job.BoxXGap != Job.BoxXGap) ||
+        (Session.Job.BoxYGap != Job.BoxYGap)))
+    {
+        CloseEditSession(Session);
+        SessionOpen = false;
+    }
+    try
+    {
+        ActivityDiagram LoadedDiagram;
+        DiagramRaster Diagram;
+        EditStatistics Statistics;
+
+        LoadedDiagram = LoadActivityDiagramText(Request.DiagramXML, 1u);
+        if (SessionOpen == false)
+        {
+            OpenEditSession(Session, Job);
+            SessionOpen = true;
+        }
+        Diagram = UpdateEditSession(Session, LoadedDiagram, Statistics);
+        Body = std::move(Diagram.Cells);
+        Status = "OK";
+    }
+    catch (const std::exception& Exception)
+    {
+        if (SessionOpen == true)
+        {
+            CloseEditSession(Session);
+            SessionOpen = false;
+        }
+        Body = Exception.what();
+        Status = "ERROR";
+    }
+    EndTime = std::chrono::steady_clock::now();
+    RenderMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>(EndTime - StartTime).count();
+    WriteRenderResponse(*Channel, Status, Request.RequestID, 0u, RenderMicroseconds, Body);
+}
+
+// Reads requests until the file ends or the client stops taking responses, a malformed request
+// is answered once and ends the stream since its framing can no longer be trusted.
+void ServeRequestFile(FILE* RequestFile, RenderQueue& Queue, const std::shared_ptr<ResponseChannel>& Channel)
+{
+    EditSession Session;
+    bool SessionOpen;
+
+    SessionOpen = false;
+    while (true)
+    {
+        QueuedRequest Queued;
+
+        {
+            std::lock_guard<std::mutex> WriteLock(Channel->WriteMutex);
+
+            if (Channel->Closed == true)
+            {
+                break;
+            }
+        }
+
+        try
+        {
+            if (ReadRenderRequest(RequestFile, Queued.Request) == false)
+            {
+                break;
+            }
+        }
+        catch (const std::exception& Exception)
+        {
+            WriteRenderResponse(*Channel, "ERROR", "-", 0u, 0u, Exception.what());
+            break;
+        }
+        if (Queued.Request.Edit == true)
+        {
+            RenderEditRequest(Session, SessionOpen, Queued.Request, Channel);
+            continue;
+        }
+        Queued.ReceivedTime = std::chrono::steady_clock::now();
+        Queued.Channel = Channel;
+        {
+            std::unique_lock<std::mutex> QueueLock(Queue.QueueMutex);
+
+            Queue.NotFullCondition.wait(QueueLock, [&Queue]()
+            {
+                return (Queue.Requests.size() < Queue.Capacity) || (Queue.Closed == true);
+            });
+            if (Queue.Closed == true)
+            {
+                QueueLock.unlock();
+                WriteRenderResponse(*Channel, "ERROR", Queued.Request.RequestID, 0u, 0u, "The server is shutting down.");
+                break;
+            }
+            Queue.Requests.push_back(std::move(Queued));
+        }
+        Queue.NotEmptyCondition.notify_one();
+    }
+    if (SessionOpen == true)
+    {
+        CloseEditSession(Session);
+    }
+}
+
+void ServeStandardStreams(uint32_t NumThreads)
+{
+    RenderQueue Queue;
+    std::vector<std::thread> Workers;
+    std::shared_ptr<ResponseChannel> Channel;
+
+    IgnoreBrokenPipes();
+    Channel = std::make_shared<ResponseChannel>();
+    Channel->ResponseFile = stdout;
+    Channel->Closed = false;
+    StartRenderWorkers(Queue, NumThreads, Workers);
+    ServeRequestFile(stdin, Queue, Channel);
+    StopRenderWorkers(Queue, Workers);
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+
+void ServeSocketConnection(int ConnectionSocket, std::shared_ptr<RenderQueue> Queue)
+{
+    FILE* RequestFile;
+    FILE* ResponseFile;
+    int ResponseSocket;
+    std::shared_ptr<ResponseChannel> Channel;
+
+    RequestFile = fdopen(ConnectionSocket, "r");
+    ResponseSocket = dup(ConnectionSocket);
+    ResponseFile = (ResponseSocket >= 0) ? fdopen(ResponseSocket, "w") : nullptr;
+    if ((RequestFile == nullptr) || (ResponseFile == nullptr))
+    {
+        // Whichever side was opened owns its descriptor and closes it with the stream.
+        if (RequestFile != nullptr)
+        {
+            fclose(RequestFile);
+        }
+        else
+        {
+            close(ConnectionSocket);
+        }
+        if (ResponseFile != nullptr)
+        {
+            fclose(ResponseFile);
+        }
+        else if (ResponseSocket >= 0)
+        {
+            close(ResponseSocket);
+        }
+        return;
+    }
+    // The response side stays open until the last queued request of this connection is answered.
+    Channel = std::shared_ptr<ResponseChannel>(new ResponseChannel(), [](ResponseChannel* ClosedChannel)
+    {
+        fclose(ClosedChannel->ResponseFile);
+        delete ClosedChannel;
+    });
+    Channel->ResponseFile = ResponseFile;
+    Channel->Closed = false;
+    ServeRequestFile(RequestFile, *Queue, Channel);
+    fclose(RequestFile);
+}
+
+// Connection threads are detached and share ownership of the queue, so one still reading when the
+// listener fails cannot outlive it.
+void ServeUnixSocket(const std::string& SocketPath, uint32_t NumThreads)
+{
+    std::shared_ptr<RenderQueue> Queue;
+    std::vector<std::thread> Workers;
+    sockaddr_un SocketAddress;
+    struct stat PathStatus;
+    int ListenSocket;
+
+    if (SocketPath.size() >= sizeof(SocketAddress.sun_path))
+    {
+        throw std::runtime_error("Socket path is too long: " + SocketPath);
+    }
+    // Only a socket left by an earlier server is replaced, never another kind of file.
+    if (lstat(SocketPath.c_str(), &PathStatus) == 0)
+    {
+        if (S_ISSOCK(PathStatus.st_mode) == false)
+        {
+            throw std::runtime_error("Refusing to replace " + SocketPath + ", it exists and is not a socket.");
+        }
+        unlink(SocketPath.c_str());
+    }
+    IgnoreBrokenPipes();
+    ListenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (ListenSocket < 0)
+    {
+        throw std::runtime_error("Could not create the server socket.");
+    }
+    memset(&SocketAddress, 0, sizeof(SocketAddress));
+    SocketAddress.sun_family = AF_UNIX;
+    strcpy(SocketAddress.sun_path, SocketPath.c_str());
+    if ((bind(ListenSocket, (sockaddr*)&SocketAddress, sizeof(SocketAddress)) != 0) || (listen(ListenSocket, 64) != 0))
+    {
+        close(ListenSocket);
+        throw std::runtime_error("Could not listen on " + SocketPath);
+    }
+    Queue = std::make_shared<RenderQueue>();
+    StartRenderWorkers(*Queue, NumThreads, Workers);
+    while (true)
+    {
+        int ConnectionSocket;
+
+        ConnectionSocket = accept(ListenSocket, nullptr, nullptr);
+        if (ConnectionSocket >= 0)
+        {
+            std::thread(ServeSocketConnection, ConnectionSocket, Queue).detach();
+        }
+        else if (errno != EINTR)
+        {
+            break;
+        }
+    }
+    close(ListenSocket);
+    StopRenderWorkers(*Queue, Workers);
+}
+
+#else
+
+void ServeUnixSocket(const std::string& SocketPath, uint32_t NumThreads)
+{
+    throw std::runtime_error("Unix domain sockets are not available on this platform, serve stdin with -s - instead.");
+}
+
+#endif
+
+}
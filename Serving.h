@@ -0,0 +1,53 @@
+#ifndef SERVING_H
+#define SERVING_H
+
+namespace IDEF
+{
+
+struct RenderRequest
+{
+    std::string RequestID;
+    PlotJob Job;
+    std::string DiagramXML;
+    bool Edit;
+};
+
+struct ResponseChannel
+{
+    std::mutex WriteMutex;
+    FILE* ResponseFile;
+    bool Closed;
+};
+
+struct QueuedRequest
+{
+    RenderRequest Request;
+    std::chrono::steady_clock::time_point ReceivedTime;
+    std::shared_ptr<ResponseChannel> Channel;
+};
+
+struct RenderQueue
+{
+    std::mutex QueueMutex;
+    std::condition_variable NotEmptyCondition;
+    std::condition_variable NotFullCondition;
+    std::deque<QueuedRequest> Requests;
+    uint32_t Capacity;
+    bool Closed;
+};
+
+bool ReadRenderRequest(FILE* RequestFile, RenderRequest& Request);
+void WriteRenderResponse(ResponseChannel& Channel, const std::string& Status, const std::string& RequestID,
+    uint64_t QueueMicroseconds, uint64_t RenderMicroseconds, const std::string& Body);
+void IgnoreBrokenPipes();
+void StartRenderWorkers(RenderQueue& Queue, uint32_t NumThreads, std::vector<std::thread>& Workers);
+void StopRenderWorkers(RenderQueue& Queue, std::vector<std::thread>& Workers);
+void RenderEditRequest(EditSession& Session, bool& SessionOpen, const RenderRequest& Request,
+    const std::shared_ptr<ResponseChannel>& Channel);
+void ServeRequestFile(FILE* RequestFile, RenderQueue& Queue, const std::shared_ptr<ResponseChannel>& Channel);
+void ServeStandardStreams(uint32_t NumThreads);
+void ServeUnixSocket(const std::string& SocketPath, uint32_t NumThreads);
+
+}
+
+#endif
@@ -1,41 +1,181 @@
 #include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <condition_variable>
+#include <cstdio>
 #include <cstring>
+#include <deque>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
 #include <variant>
 #include <libavoid/libavoid.h>
 #include <map>
 #include <pugixml.hpp>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <thread>
 #include <vector>
 
 #include "Loading.h"
 #include "Placing.h"
 #include "Layouting.h"
 #include "Drawing.h"
+#include "Plotting.h"
+#include "Fitting.h"
+#include "Editing.h"
+#include "Serving.h"
+
+int PlotManifest(const char* ManifestFilePath, uint32_t NumThreads, bool UseCache, IDEF::BoxLayout Layout)
+{
+    std::vector<IDEF::PlotJob> Jobs;
+    std::vector<IDEF::PlotResult> Results;
+    std::ifstream ManifestFileStream;
+    uint32_t NumJobs;
+    uint32_t NumFailed;
+
+    try
+    {
+        if (strcmp(ManifestFilePath, "-") == 0)
+        {
+            Jobs = IDEF::LoadPlotJobs(std::cin);
+        }
+        else
+        {
+            ManifestFileStream.open(ManifestFilePath);
+            if (ManifestFileStream.is_open() == false)
+            {
+                std::cerr << "Could not open the manifest '" << ManifestFilePath << "'." << std::endl;
+                return 1;
+            }
+            Jobs = IDEF::LoadPlotJobs(ManifestFileStream);
+        }
+    }
+    catch (const std::exception& Exception)
+    {
+        std::cerr << "Failed reading the manifest '" << ManifestFilePath << "': " << Exception.what() << std::endl;
+        return 1;
+    }
+    for (IDEF::PlotJob& Job : Jobs)
+    {
+        Job.UseCache = UseCache;
+        Job.Layout = Layout;
+    }
+    std::cout << "Plotting " << Jobs.size() << " IDEF diagrams on " << NumThreads << " threads." << std::endl;
+    Results = IDEF::PlotBatch(Jobs, NumThreads);
+    NumJobs = Jobs.size();
+    NumFailed = 0u;
+    for (uint32_t JobIndex = 0u; JobIndex < NumJobs; JobIndex++)
+    {
+        if (Results[JobIndex].Succeeded == false)
+        {
+            std::cerr << "Failed plotting '" << Jobs[JobIndex].InputFilePath << "': " << Results[JobIndex].ErrorMessage << std::endl;
+            NumFailed++;
+        }
+    }
+    std::cout << "Done plotting. " << (NumJobs - NumFailed) << " of " << NumJobs << " diagrams written." << std::endl;
+
+    return (NumFailed == 0u) ? 0 : 1;
+}
+
+int PlotModel(const IDEF::PlotJob& Job, uint32_t NumThreads)
+{
+    std::vector<IDEF::PlotResult> Results;
+    std::vector<std::string> OutputFilePaths;
+    uint32_t NumDiagrams;
+    uint32_t NumFailed;
+
+    std::cout << "Plotting an IDEF model on " << NumThreads << " threads." << std::endl;
+    try
+    {
+        Results = IDEF::PlotModelFile(Job, NumThreads, OutputFilePaths);
+    }
+    catch (const std::exception& Exception)
+    {
+        std::cerr << "Failed plotting '" << Job.InputFilePath << "': " << Exception.what() << std::endl;
+        return 1;
+    }
+    NumDiagrams = Results.size();
+    NumFailed = 0u;
+    for (uint32_t DiagramIndex = 0u; DiagramIndex < NumDiagrams; DiagramIndex++)
+    {
+        if (Results[DiagramIndex].Succeeded == false)
+        {
+            std::cerr << "Failed plotting '" << OutputFilePaths[DiagramIndex] << "': " << Results[DiagramIndex].ErrorMessage << std::endl;
+            NumFailed++;
+        }
+    }
+    std::cout << "Done plotting. " << (NumDiagrams - NumFailed) << " of " << NumDiagrams << " diagrams written." << std::endl;
+
+    return (NumFailed == 0u) ? 0 : 1;
+}
+
+int PlotFittedDiagram(const IDEF::PlotJob& Job, uint32_t NumThreads)
+{
+    IDEF::PlotJob FittedJob;
+
+    try
+    {
+        FittedJob = IDEF::PlotFittedActivityDiagramFile(Job, NumThreads);
+    }
+    catch (const std::exception& Exception)
+    {
+        std::cerr << "Failed plotting '" << Job.InputFilePath << "': " << Exception.what() << std::endl;
+        return 1;
+    }
+    std::cout << "Done plotting. Output '" << FittedJob.OutputFilePath << "' with parameters " << FittedJob.DiagramWidth << " " <<
+        FittedJob.DiagramHeight << " " << FittedJob.BoxWidth << " " << FittedJob.BoxHeight << " " << FittedJob.BoxXGap << " " <<
+        FittedJob.BoxYGap << "." << std::endl;
+
+    return 0;
+}
+
+uint32_t ParseThreadCount(int argc, char **argv, int ArgumentIndex)
+{
+    uint32_t NumThreads;
+
+    NumThreads = std::thread::hardware_concurrency();
+    if (argc > ArgumentIndex)
+    {
+        NumThreads = std::atoi(argv[ArgumentIndex]);
+    }
+    if (NumThreads == 0u)
+    {
+        NumThreads = 1u;
+    }
+
+    return NumThreads;
+}
 
 int main(int argc, char **argv)
 {
-    char* InputFilePath;
-    char* OutputFilePath;
-    uint32_t DiagramWidth;
-    uint32_t DiagramHeight;
-    uint32_t BoxWidth;
-    uint32_t BoxHeight;
-    uint32_t BoxXGap;
-    uint32_t BoxYGap;
-    IDEF::ActivityDiagram LoadedDiagram;
-    std::fstream OutputFileStream;
-    std::map<IDEF::Stub, Avoid::ConnEnd> BoxStubsMap;
-    std::map<IDEF::Stub, Avoid::ConnEnd> BoundaryStubsMap;       
-    std::vector<Avoid::Rectangle> Obstacles;
-    Avoid::Router *Router;
-    std::vector<std::string> Diagram;
-    uint32_t RowNumber;
-
-    if (strcmp(argv[1u], "-h") == 0)
+    IDEF::PlotJob Job;
+    uint32_t NumThreads;
+    IDEF::BoxLayout Layout;
+    bool UseCache;
+
+    UseCache = false;
+    Layout = IDEF::DiagonalBoxLayout;
+    while ((argc > 1) && ((strcmp(argv[1u], "-c") == 0) || (strcmp(argv[1u], "-g") == 0)))
+    {
+        if (strcmp(argv[1u], "-c") == 0)
+        {
+            UseCache = true;
+        }
+        else
+        {
+            Layout = IDEF::GridBoxLayout;
+        }
+        argc--;
+        argv++;
+    }
+    Job.Layout = Layout;
+    if ((argc < 2) || (strcmp(argv[1u], "-h") == 0))
     {
         std::cout << "Parameter 1: Input file's path." << std::endl;
         std::cout << "Parameter 2: Output file's path." << std::endl;
@@ -45,37 +185,111 @@ int main(int argc, char **argv)
         std::cout << "Parameter 6: Box height." << std::endl;
         std::cout << "Parameter 7: Box horizontal spacing." << std::endl;
         std::cout << "Parameter 8: Box vertical spacing." << std::endl;
+        std::cout << "Batch mode: -b {ManifestFilePath or - for stdin} [{ThreadCount}]" << std::endl;
+        std::cout << "Each manifest line holds parameters 1 to 8, or 1 and 2 to fit the sizes, lines starting with '#' are skipped." << std::endl;
+        std::cout << "Auto-fit mode: -a {Parameters 1 and 2} [{ThreadCount}] picks parameters 3 to 8 from the diagram." << std::endl;
+        std::cout << "Model mode: -m {Parameters 1 to 8} [{ThreadCount}] plots every <Diagram> of a <Model> file." << std::endl;
+        std::cout << "Each diagram is written next to the output path with its node number appended." << std::endl;
+        std::cout << "Cache: -c before the single or batch parameters keeps .idefcache files next to each input," << std::endl;
+        std::cout << "re-plotting an unchanged input with the same sizes then skips its XML parsing and layout." << std::endl;
+        std::cout << "Grid layout: -g before the single, batch, auto-fit or model parameters places the boxes on a grid" << std::endl;
+        std::cout << "in columns instead of a diagonal, so large diagrams need far less width and height." << std::endl;
+        std::cout << "Server mode: -s {SocketPath or - for stdin} [{ThreadCount}] renders framed requests until closed." << std::endl;
+    }
+    else if (strcmp(argv[1u], "-b") == 0)
+    {
+        if (argc < 3)
+        {
+            std::cerr << "Batch mode needs a manifest file path (use -h for more info)." << std::endl;
+            return 1;
+        }
+        NumThreads = ParseThreadCount(argc, argv, 3);
+        return PlotManifest(argv[2u], NumThreads, UseCache, Layout);
+    }
+    else if (strcmp(argv[1u], "-a") == 0)
+    {
+        if (argc < 4)
+        {
+            std::cerr << "Auto-fit mode needs parameters 1 and 2 after -a (use -h for more info)." << std::endl;
+            return 1;
+        }
+        Job.InputFilePath = argv[2u];
+        Job.OutputFilePath = argv[3u];
+        Job.UseCache = false;
+        Job.AutoFit = true;
+        NumThreads = ParseThreadCount(argc, argv, 4);
+        std::cout << "Fitting an IDEF diagram on " << NumThreads << " threads." << std::endl;
+        return PlotFittedDiagram(Job, NumThreads);
+    }
+    else if (strcmp(argv[1u], "-m") == 0)
+    {
+        if (argc < 10)
+        {
+            std::cerr << "Model mode needs parameters 1 to 8 after -m (use -h for more info)." << std::endl;
+            return 1;
+        }
+        Job.InputFilePath = argv[2u];
+        Job.OutputFilePath = argv[3u];
+        Job.DiagramWidth = std::atoi(argv[4u]);
+        Job.DiagramHeight = std::atoi(argv[5u]);
+        Job.BoxWidth = std::atoi(argv[6u]);
+        Job.BoxHeight = std::atoi(argv[7u]);
+        Job.BoxXGap = std::atoi(argv[8u]);
+        Job.BoxYGap = std::atoi(argv[9u]);
+        Job.UseCache = false;
+        Job.AutoFit = false;
+        NumThreads = ParseThreadCount(argc, argv, 10);
+        return PlotModel(Job, NumThreads);
+    }
+    else if (strcmp(argv[1u], "-s") == 0)
+    {
+        if (argc < 3)
+        {
+            std::cerr << "Server mode needs a socket path or - (use -h for more info)." << std::endl;
+            return 1;
+        }
+        NumThreads = ParseThreadCount(argc, argv, 3);
+        std::cerr << "Serving IDEF diagrams on " << NumThreads << " threads." << std::endl;
+        try
+        {
+            if (strcmp(argv[2u], "-") == 0)
+            {
+                IDEF::ServeStandardStreams(NumThreads);
+            }
+            else
+            {
+                IDEF::ServeUnixSocket(argv[2u], NumThreads);
+            }
+        }
+        catch (const std::exception& Exception)
+        {
+            std::cerr << "Failed serving '" << argv[2u] << "': " << Exception.what() << std::endl;
+            return 1;
+        }
     }
     else
     {
         std::cout << "Plotting an IDEF diagram (use -h for more info)." << std::endl;
-        InputFilePath = argv[1u];
-        OutputFilePath = argv[2u];
-        DiagramWidth = std::atoi(argv[3u]);
-        DiagramHeight = std::atoi(argv[4u]);
-        BoxWidth = std::atoi(argv[5u]);
-        BoxHeight = std::atoi(argv[6u]);
-        BoxXGap = std::atoi(argv[7u]);
-        BoxYGap = std::atoi(argv[8u]);
-        LoadedDiagram = IDEF::LoadActivityDiagram(InputFilePath);
-        IDEF::LayoutActivityDiagram(LoadedDiagram, DiagramWidth, DiagramHeight, BoxWidth, BoxHeight, BoxXGap, BoxYGap);
-        IDEF::PlaceObstacles(LoadedDiagram, Obstacles);
-        BoxStubsMap = IDEF::PlaceBoxStubConnEnds(LoadedDiagram);
-        BoundaryStubsMap = IDEF::PlaceBoundaryStubConnEnds(LoadedDiagram);
-        Router = IDEF::ConstructRouter(BoxStubsMap,BoundaryStubsMap, Obstacles);
-        Diagram = IDEF::DrawDiagram(LoadedDiagram, Router);
-        RowNumber = 0u;
-        OutputFileStream.open(OutputFilePath, std::ios_base::out);
-        for (const std::string &Line : Diagram)
+        Job.InputFilePath = argv[1u];
+        Job.OutputFilePath = argv[2u];
+        Job.DiagramWidth = std::atoi(argv[3u]);
+        Job.DiagramHeight = std::atoi(argv[4u]);
+        Job.BoxWidth = std::atoi(argv[5u]);
+        Job.BoxHeight = std::atoi(argv[6u]);
+        Job.BoxXGap = std::atoi(argv[7u]);
+        Job.BoxYGap = std::atoi(argv[8u]);
+        Job.UseCache = UseCache;
+        Job.AutoFit = false;
+        try
+        {
+            IDEF::PlotActivityDiagramFile(Job, std::max(std::thread::hardware_concurrency(), 1u));
+        }
+        catch (const std::exception& Exception)
         {
-            OutputFileStream << Line;
-            OutputFileStream << '\n';
-            RowNumber = RowNumber + 1u;
+            std::cerr << "Failed plotting '" << Job.InputFilePath << "': " << Exception.what() << std::endl;
+            return 1;
         }
-        OutputFileStream.close();
-        Diagram.clear(); 
-        delete Router;
-        std::cout << "Done plotting. Output '" << OutputFilePath << "'." << std::endl; 
+        std::cout << "Done plotting. Output '" << Job.OutputFilePath << "'." << std::endl;
     }
 
     return 0;